@@ -11,7 +11,11 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "Alpha.h"
+#include "BufferPool.h"
+#include "HostWindow.h"
 #include "ImageUtil.h"
+#include "ParallelFor.h"
+#include "TilePlanner.h"
 #include "Utilities.h"
 
 namespace
@@ -142,6 +146,7 @@ namespace
         int32 tileHeight,
         uint8* outData,
         int32 outDataStride,
+        int32 outColumnStep,
         const uint8* maskData,
         int32 maskDataStride)
     {
@@ -157,7 +162,7 @@ namespace
                     *pixel = 255;
                 }
 
-                pixel++;
+                pixel += outColumnStep;
                 if (mask != nullptr)
                 {
                     mask++;
@@ -171,6 +176,7 @@ namespace
         int32 tileHeight,
         uint8* outData,
         int32 outDataStride,
+        int32 outColumnStep,
         const uint8* maskData,
         int32 maskDataStride)
     {
@@ -186,7 +192,7 @@ namespace
                     *pixel = 32768;
                 }
 
-                pixel++;
+                pixel += outColumnStep;
                 if (mask != nullptr)
                 {
                     mask++;
@@ -200,6 +206,7 @@ namespace
         int32 tileHeight,
         uint8* outData,
         int32 outDataStride,
+        int32 outColumnStep,
         const uint8* maskData,
         int32 maskDataStride)
     {
@@ -215,7 +222,7 @@ namespace
                     *pixel = 1.0f;
                 }
 
-                pixel++;
+                pixel += outColumnStep;
                 if (mask != nullptr)
                 {
                     mask++;
@@ -223,16 +230,46 @@ namespace
             }
         }
     }
+
+    void PremultiplyAlphaTile(
+        const uint8* const alphaData,
+        int32 alphaRowBytes,
+        int32 tileWidth,
+        int32 tileHeight,
+        uint8* outData,
+        int32 outRowBytes,
+        const uint8* maskData,
+        int32 maskRowBytes,
+        int32 hostBitDepth)
+    {
+        switch (hostBitDepth)
+        {
+        case 8:
+            PremultiplyAlphaEightBitsPerChannel(alphaData, alphaRowBytes, tileWidth, tileHeight, outData, outRowBytes, maskData, maskRowBytes);
+            break;
+        case 16:
+            PremultiplyAlphaSixteenBitsPerChannel(alphaData, alphaRowBytes, tileWidth, tileHeight, outData, outRowBytes, maskData, maskRowBytes);
+            break;
+        case 32:
+            PremultiplyAlphaThirtyTwoBitsPerChannel(alphaData, alphaRowBytes, tileWidth, tileHeight, outData, outRowBytes, maskData, maskRowBytes);
+            break;
+        default:
+            throw ::std::runtime_error("Unsupported image depth.");
+        }
+    }
 }
 
 void PremultiplyAlpha(
     FileHandle* fileHandle,
-    uint8* tileBuffer,
+    const Gmic8bfImageTileTable& tileTable,
+    int32 alphaPlane,
+    const MaskOccupancyMap& maskOccupancyMap,
     int32 tileWidth,
     int32 tileHeight,
     FilterRecord* filterRecord,
-    const VPoint& imageSize,
-    int32 bitsPerChannel)
+    const VRect& bounds,
+    int32 imageBitsPerChannel,
+    int32 hostBitDepth)
 {
     int16 numberOfImagePlanes;
     switch (filterRecord->imageMode)
@@ -251,174 +288,215 @@ void PremultiplyAlpha(
         throw ::std::runtime_error("Unsupported image mode.");
     }
 
-    if (filterRecord->haveMask)
-    {
-        filterRecord->maskRate = int2fixed(1);
-    }
+    const bool convertBitDepth = imageBitsPerChannel != hostBitDepth;
 
-    for (int32 y = 0; y < imageSize.v; y += tileHeight)
-    {
-        const int32 top = y;
-        const int32 bottom = ::std::min(y + tileHeight, imageSize.v);
+    const int32 imageBytesPerChannel = imageBitsPerChannel / 8;
+    const int32 hostBytesPerChannel = hostBitDepth / 8;
 
-        const int32 rowCount = bottom - top;
+    // Each plane is requested separately, the alpha tiles of a window are read once
+    // and used for all of the planes.
+    const TileGeometry windowGeometry = PlanHostWindowGeometry(
+        filterRecord,
+        bounds.right - bounds.left,
+        bounds.bottom - bounds.top,
+        tileWidth,
+        tileHeight,
+        hostBytesPerChannel,
+        imageBytesPerChannel + (convertBitDepth ? hostBytesPerChannel : 0),
+        __FUNCTION__);
 
-        for (int32 x = 0; x < imageSize.h; x += tileWidth)
-        {
-            const int32 left = x;
-            const int32 right = ::std::min(x + tileWidth, imageSize.h);
+    const size_t windowSlotCount = static_cast<size_t>((windowGeometry.width + tileWidth - 1) / tileWidth) *
+                                   static_cast<size_t>((windowGeometry.height + tileHeight - 1) / tileHeight);
+    const size_t tileSampleCapacity = static_cast<size_t>(tileWidth) * static_cast<size_t>(tileHeight);
 
-            const int32 columnCount = right - left;
+    PooledBuffer alphaWindowBuffer = AcquirePooledBuffer(windowSlotCount * tileSampleCapacity * static_cast<size_t>(imageBytesPerChannel));
+    PooledBuffer conversionBuffer;
 
-            const int32 tileBufferRowBytes = columnCount;
-            const size_t tileDataSize = static_cast<size_t>(rowCount) * static_cast<size_t>(tileBufferRowBytes);
+    uint8* const alphaWindow = static_cast<uint8*>(alphaWindowBuffer.data());
+    uint8* hostAlphaWindow = alphaWindow;
 
-            ReadFile(fileHandle, tileBuffer, tileDataSize);
+    if (convertBitDepth)
+    {
+        conversionBuffer = AcquirePooledBuffer(windowSlotCount * tileSampleCapacity * static_cast<size_t>(hostBytesPerChannel));
+        hostAlphaWindow = static_cast<uint8*>(conversionBuffer.data());
+    }
 
-            for (int16 i = 0; i < numberOfImagePlanes; i++)
+    ::std::vector<HostWindowTile> windowTiles;
+    ::std::vector<HostWindowRowBand> rowBands;
+
+    for (int32 windowTop = bounds.top; windowTop < bounds.bottom; windowTop += windowGeometry.height)
+    {
+        for (int32 windowLeft = bounds.left; windowLeft < bounds.right; windowLeft += windowGeometry.width)
+        {
+            VRect window{};
+            window.top = windowTop;
+            window.left = windowLeft;
+            window.bottom = ::std::min(windowTop + windowGeometry.height, bounds.bottom);
+            window.right = ::std::min(windowLeft + windowGeometry.width, bounds.right);
+
+            if (GetHostWindowTiles(window, tileWidth, tileHeight, maskOccupancyMap, windowTiles) == TileMaskOccupancy::Unselected)
             {
-                filterRecord->outLoPlane = filterRecord->outHiPlane = i;
+                continue;
+            }
 
-                SetOutputRect(filterRecord, top, left, bottom, right);
+            size_t remainingTileCount = 0;
 
-                if (filterRecord->haveMask)
-                {
-                    SetMaskRect(filterRecord, top, left, bottom, right);
-                }
+            for (const HostWindowTile& tile : windowTiles)
+            {
+                const int32 tileIndex = tileTable.GetTileIndex(
+                    alphaPlane,
+                    window.left - bounds.left + tile.left,
+                    window.top - bounds.top + tile.top);
 
-                OSErrException::ThrowIfError(filterRecord->advanceState());
+                const size_t tileSampleCount = static_cast<size_t>(tile.rowCount) * static_cast<size_t>(tile.columnCount);
+                uint8* const alphaTile = alphaWindow + (static_cast<size_t>(tile.slot) * tileSampleCapacity * static_cast<size_t>(imageBytesPerChannel));
 
-                const uint8* maskData = filterRecord->haveMask ? static_cast<const uint8*>(filterRecord->maskData) : nullptr;
+                tileTable.ReadTile(fileHandle, tileIndex, alphaTile, tileSampleCount);
 
-                switch (bitsPerChannel)
+                // Premultiplying the color planes by an opaque alpha tile does not change them,
+                // so these tiles are removed from the window.
+                if (!IsOpaqueAlphaData(alphaTile, tileSampleCount, imageBitsPerChannel))
                 {
-                case 8:
-                    PremultiplyAlphaEightBitsPerChannel(
-                        tileBuffer,
-                        tileBufferRowBytes,
-                        columnCount,
-                        rowCount,
-                        static_cast<uint8*>(filterRecord->outData),
-                        filterRecord->outRowBytes,
-                        maskData,
-                        filterRecord->maskRowBytes);
-                    break;
-                case 16:
-                    PremultiplyAlphaSixteenBitsPerChannel(
-                        tileBuffer,
-                        tileBufferRowBytes,
-                        columnCount,
-                        rowCount,
-                        static_cast<uint8*>(filterRecord->outData),
-                        filterRecord->outRowBytes,
-                        maskData,
-                        filterRecord->maskRowBytes);
-                    break;
-                case 32:
-                    PremultiplyAlphaThirtyTwoBitsPerChannel(
-                        tileBuffer,
-                        tileBufferRowBytes,
-                        columnCount,
-                        rowCount,
-                        static_cast<uint8*>(filterRecord->outData),
-                        filterRecord->outRowBytes,
-                        maskData,
-                        filterRecord->maskRowBytes);
-                    break;
-                default:
-                    throw ::std::runtime_error("Unsupported image depth.");
+                    windowTiles[remainingTileCount++] = tile;
                 }
             }
-        }
-    }
-}
-
-void SetAlphaChannelToOpaque(FilterRecord* filterRecord, const VPoint& imageSize, int32 bitsPerChannel)
-{
-    int16 alphaChannelPlane;
-    switch (filterRecord->imageMode)
-    {
-    case plugInModeGrayScale:
-    case plugInModeGray16:
-    case plugInModeGray32:
-        alphaChannelPlane = 1;
-        break;
-    case plugInModeRGBColor:
-    case plugInModeRGB48:
-    case plugInModeRGB96:
-        alphaChannelPlane = 3;
-        break;
-    default:
-        throw ::std::runtime_error("Unsupported image mode.");
-    }
-
-    filterRecord->outLoPlane = filterRecord->outHiPlane = alphaChannelPlane;
-
-    const int32 tileWidth = ::std::min(GetTileWidth(filterRecord->outTileWidth), imageSize.h);
-    const int32 tileHeight = ::std::min(GetTileHeight(filterRecord->outTileHeight), imageSize.v);
-
-    if (filterRecord->haveMask)
-    {
-        filterRecord->maskRate = int2fixed(1);
-    }
-
-    for (int32 y = 0; y < imageSize.v; y += tileHeight)
-    {
-        const int32 top = y;
-        const int32 bottom = ::std::min(y + tileHeight, imageSize.v);
 
-        const int32 rowCount = bottom - top;
+            windowTiles.resize(remainingTileCount);
 
-        for (int32 x = 0; x < imageSize.h; x += tileWidth)
-        {
-            const int32 left = x;
-            const int32 right = ::std::min(x + tileWidth, imageSize.h);
-
-            const int32 columnCount = right - left;
-
-            SetOutputRect(filterRecord, top, left, bottom, right);
+            const TileMaskOccupancy windowMaskOccupancy = GetHostWindowMaskOccupancy(windowTiles);
 
-            if (filterRecord->haveMask)
+            if (windowMaskOccupancy == TileMaskOccupancy::Unselected)
             {
-                SetMaskRect(filterRecord, top, left, bottom, right);
+                // All of the selected tiles in the window are opaque.
+                continue;
             }
 
-            OSErrException::ThrowIfError(filterRecord->advanceState());
+            GetHostWindowRowBands(windowTiles, rowBands);
 
-            const uint8* maskData = filterRecord->haveMask ? static_cast<const uint8*>(filterRecord->maskData) : nullptr;
+            if (convertBitDepth)
+            {
+                ParallelFor(
+                    static_cast<int32>(rowBands.size()),
+                    1,
+                    [&](int32 begin, int32 end)
+                    {
+                        for (int32 bandIndex = begin; bandIndex < end; bandIndex++)
+                        {
+                            const HostWindowRowBand& band = rowBands[bandIndex];
+                            const HostWindowTile& tile = windowTiles[band.tile];
+
+                            const size_t firstSample = (static_cast<size_t>(tile.slot) * tileSampleCapacity) +
+                                                       (static_cast<size_t>(band.firstRow) * static_cast<size_t>(tile.columnCount));
+                            const size_t bandSampleCount = static_cast<size_t>(band.rowCount) * static_cast<size_t>(tile.columnCount);
+
+                            ConvertChannelBitDepth(
+                                alphaWindow + (firstSample * static_cast<size_t>(imageBytesPerChannel)),
+                                imageBitsPerChannel,
+                                hostAlphaWindow + (firstSample * static_cast<size_t>(hostBytesPerChannel)),
+                                hostBitDepth,
+                                bandSampleCount);
+                        }
+                    });
+            }
 
-            switch (bitsPerChannel)
+            for (int16 i = 0; i < numberOfImagePlanes; i++)
             {
-            case 8:
-                SetAlphaChannelToOpaqueEightBitsPerChannel(
-                    columnCount,
-                    rowCount,
-                    static_cast<uint8*>(filterRecord->outData),
-                    filterRecord->outRowBytes,
-                    maskData,
-                    filterRecord->maskRowBytes);
-                break;
-            case 16:
-                SetAlphaChannelToOpaqueSixteenBitsPerChannel(
-                    columnCount,
-                    rowCount,
-                    static_cast<uint8*>(filterRecord->outData),
-                    filterRecord->outRowBytes,
-                    maskData,
-                    filterRecord->maskRowBytes);
-                break;
-            case 32:
-                SetAlphaChannelToOpaqueThirtyTwoBitsPerChannel(
-                    columnCount,
-                    rowCount,
-                    static_cast<uint8*>(filterRecord->outData),
-                    filterRecord->outRowBytes,
-                    maskData,
-                    filterRecord->maskRowBytes);
-                break;
-            default:
-                throw ::std::runtime_error("Unsupported image depth.");
+                filterRecord->outLoPlane = filterRecord->outHiPlane = i;
+                filterRecord->outPlaneBytes = hostBytesPerChannel;
+                filterRecord->outColumnBytes = hostBytesPerChannel;
+
+                SetOutputRect(filterRecord, window.top, window.left, window.bottom, window.right);
+
+                SetOutputTileMaskRect(filterRecord, windowMaskOccupancy, window.top, window.left, window.bottom, window.right);
+
+                OSErrException::ThrowIfError(TimedAdvanceState(filterRecord));
+
+                uint8* const outData = static_cast<uint8*>(filterRecord->outData);
+                const int32 outRowBytes = filterRecord->outRowBytes;
+                const uint8* const windowMaskData = GetOutputTileMaskData(filterRecord, windowMaskOccupancy);
+                const int32 maskRowBytes = filterRecord->maskRowBytes;
+
+                ParallelFor(
+                    static_cast<int32>(rowBands.size()),
+                    1,
+                    [&](int32 begin, int32 end)
+                    {
+                        for (int32 bandIndex = begin; bandIndex < end; bandIndex++)
+                        {
+                            const HostWindowRowBand& band = rowBands[bandIndex];
+                            const HostWindowTile& tile = windowTiles[band.tile];
+
+                            const size_t firstSample = (static_cast<size_t>(tile.slot) * tileSampleCapacity) +
+                                                       (static_cast<size_t>(band.firstRow) * static_cast<size_t>(tile.columnCount));
+                            const int32 outTop = tile.top + band.firstRow;
+
+                            const uint8* bandMaskData = nullptr;
+
+                            if (windowMaskData != nullptr && tile.maskOccupancy == TileMaskOccupancy::PartiallySelected)
+                            {
+                                bandMaskData = windowMaskData + (static_cast<size_t>(outTop) * static_cast<size_t>(maskRowBytes)) + static_cast<size_t>(tile.left);
+                            }
+
+                            PremultiplyAlphaTile(
+                                hostAlphaWindow + (firstSample * static_cast<size_t>(hostBytesPerChannel)),
+                                tile.columnCount * hostBytesPerChannel,
+                                tile.columnCount,
+                                band.rowCount,
+                                outData + (static_cast<size_t>(outTop) * static_cast<size_t>(outRowBytes)) + (static_cast<size_t>(tile.left) * static_cast<size_t>(hostBytesPerChannel)),
+                                outRowBytes,
+                                bandMaskData,
+                                maskRowBytes,
+                                hostBitDepth);
+                        }
+                    });
             }
         }
     }
 }
+
+void SetAlphaTileToOpaque(
+    int32 tileWidth,
+    int32 tileHeight,
+    void* outData,
+    int32 outRowBytes,
+    int32 outColumnStep,
+    const uint8* maskData,
+    int32 maskRowBytes,
+    int32 bitsPerChannel)
+{
+    switch (bitsPerChannel)
+    {
+    case 8:
+        SetAlphaChannelToOpaqueEightBitsPerChannel(
+            tileWidth,
+            tileHeight,
+            static_cast<uint8*>(outData),
+            outRowBytes,
+            outColumnStep,
+            maskData,
+            maskRowBytes);
+        break;
+    case 16:
+        SetAlphaChannelToOpaqueSixteenBitsPerChannel(
+            tileWidth,
+            tileHeight,
+            static_cast<uint8*>(outData),
+            outRowBytes,
+            outColumnStep,
+            maskData,
+            maskRowBytes);
+        break;
+    case 32:
+        SetAlphaChannelToOpaqueThirtyTwoBitsPerChannel(
+            tileWidth,
+            tileHeight,
+            static_cast<uint8*>(outData),
+            outRowBytes,
+            outColumnStep,
+            maskData,
+            maskRowBytes);
+        break;
+    default:
+        throw ::std::runtime_error("Unsupported image depth.");
+    }
+}
@@ -15,17 +15,31 @@
 
 #include "GmicPlugin.h"
 #include "FileIO.h"
+#include "Gmic8bfImageTileTable.h"
+#include "MaskOccupancyMap.h"
 
 void PremultiplyAlpha(
     FileHandle* fileHandle,
-    uint8* tileBuffer,
+    const Gmic8bfImageTileTable& tileTable,
+    int32 alphaPlane,
+    const MaskOccupancyMap& maskOccupancyMap,
     int32 tileWidth,
     int32 tileHeight,
     FilterRecord* filterRecord,
-    const VPoint& imageSize,
-    int32 bitsPerChannel);
-
-void SetAlphaChannelToOpaque(FilterRecord* filterRecord, const VPoint& imageSize, int32 bitsPerChannel);
+    const VRect& bounds,
+    int32 imageBitsPerChannel,
+    int32 hostBitDepth);
 
+// Sets the alpha channel of a host output tile to opaque, outData points to the first alpha
+// sample and outColumnStep is the number of samples between pixels when the planes are interleaved.
+void SetAlphaTileToOpaque(
+    int32 tileWidth,
+    int32 tileHeight,
+    void* outData,
+    int32 outRowBytes,
+    int32 outColumnStep,
+    const uint8* maskData,
+    int32 maskRowBytes,
+    int32 bitsPerChannel);
 
 #endif // !ALPHA_H
@@ -0,0 +1,780 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "BackgroundImageWriter.h"
+#include "FileIO.h"
+#include "FileUtil.h"
+#include "boost/endian.hpp"
+#include <boost/filesystem/fstream.hpp>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __PIWin__
+#include "BackgroundImageWriterWin.h"
+#else
+#error "Missing a BackgroundImageWriter header for this platform."
+#endif
+
+namespace
+{
+    // The maximum number of images that can be waiting to be saved, this limits the
+    // disk space used by the input files when a filter produces a large number of images.
+    constexpr size_t MaxQueuedImageSaves = 8;
+
+    // The maximum number of error messages that are kept until they are shown.
+    constexpr size_t MaxSavedErrorMessages = 10;
+
+    // The maximum number of failed saves that are kept to be retried, any other failed
+    // saves are abandoned.
+    constexpr size_t MaxRetainedFailedSaves = 8;
+
+    constexpr int32 PendingSaveFileVersion = 1;
+
+    // The file that is held open by the session that owns a pending save directory.
+    constexpr const char* SessionLockFileName = "session.lock";
+
+    struct PendingSaveFileHeader
+    {
+        PendingSaveFileHeader() : version(PendingSaveFileVersion), reserved()
+        {
+            // G8PS = GMIC 8BF pending save
+            signature[0] = 'G';
+            signature[1] = '8';
+            signature[2] = 'P';
+            signature[3] = 'S';
+        }
+
+        char signature[4];
+        boost::endian::little_int32_t version;
+        char reserved[8];
+    };
+
+    struct BackgroundImageSave
+    {
+        OutputImageWriterOptions options;
+        OutputImageFileType fileType;
+        boost::filesystem::path inputFilePath;
+        boost::filesystem::path outputFilePath;
+        boost::filesystem::path tempFilePath;
+        bool isRetry;
+    };
+
+    boost::filesystem::path GetErrorLogPath()
+    {
+        return GetBackgroundSaveErrorDirectory() / "BackgroundSaveErrors.log";
+    }
+
+    // The pending save file holds the information that is needed to resume a save
+    // in a later session, it is stored next to the input file.
+    boost::filesystem::path GetPendingSaveFilePath(const boost::filesystem::path& inputFilePath)
+    {
+        boost::filesystem::path path = inputFilePath;
+
+        return path.replace_extension(".g8ps");
+    }
+
+    void ReadFilePath(FileHandle* fileHandle, boost::filesystem::path& value)
+    {
+        boost::endian::little_uint32_t stringLength = 0;
+
+        ReadFile(fileHandle, &stringLength, sizeof(stringLength));
+
+        if (stringLength == 0)
+        {
+            value = boost::filesystem::path();
+        }
+        else
+        {
+            constexpr size_t pathCharSize = sizeof(boost::filesystem::path::value_type);
+
+            // Check that the required byte buffer size can fit in a size_t.
+            if (stringLength > (::std::numeric_limits<size_t>::max() / pathCharSize))
+            {
+                throw ::std::runtime_error("The string cannot be written to the file because it is too long.");
+            }
+
+            ::std::vector<boost::filesystem::path::value_type> stringChars(stringLength);
+
+            const size_t stringLengthInBytes = stringLength * pathCharSize;
+
+            ReadFile(fileHandle, &stringChars[0], stringLengthInBytes);
+
+            value.assign(stringChars.begin(), stringChars.end());
+        }
+    }
+
+    void WriteFilePath(FileHandle* fileHandle, const boost::filesystem::path& value)
+    {
+        constexpr size_t pathCharSize = sizeof(boost::filesystem::path::value_type);
+
+        // Check that the required byte buffer size can fit in a size_t.
+        if (value.size() > (::std::numeric_limits<size_t>::max() / pathCharSize))
+        {
+            throw ::std::runtime_error("The string cannot be written to the file because it is too long.");
+        }
+
+        boost::endian::little_uint32_t stringLength = static_cast<uint32_t>(value.size());
+
+        WriteFile(fileHandle, &stringLength, sizeof(stringLength));
+
+        if (value.size() > 0)
+        {
+            const size_t stringLengthInBytes = value.size() * pathCharSize;
+
+            WriteFile(fileHandle, value.c_str(), stringLengthInBytes);
+        }
+    }
+
+    void ReadPendingSaveFile(const boost::filesystem::path& path, BackgroundImageSave& save)
+    {
+        ::std::unique_ptr<FileHandle> file = OpenFile(path, FileOpenMode::Read);
+
+        PendingSaveFileHeader header{};
+
+        ReadFile(file.get(), &header, sizeof(header));
+
+        if (strncmp(header.signature, "G8PS", 4) != 0)
+        {
+            throw ::std::runtime_error("The pending save file has an incorrect signature.");
+        }
+
+        if (header.version != PendingSaveFileVersion)
+        {
+            throw ::std::runtime_error("The pending save file has an unknown version.");
+        }
+
+        boost::endian::little_int32_t fileType = 0;
+        boost::endian::little_uint64_t hostBufferSpace = 0;
+        boost::endian::little_int32_t hostTileHeight = 0;
+        boost::endian::little_int32_t isRetry = 0;
+
+        ReadFile(file.get(), &fileType, sizeof(fileType));
+        ReadFile(file.get(), &hostBufferSpace, sizeof(hostBufferSpace));
+        ReadFile(file.get(), &hostTileHeight, sizeof(hostTileHeight));
+        ReadFile(file.get(), &isRetry, sizeof(isRetry));
+
+        if (fileType < static_cast<int32>(OutputImageFileType::Png) ||
+            fileType > static_cast<int32>(OutputImageFileType::Qoi))
+        {
+            throw ::std::runtime_error("The pending save file has an unknown output file type.");
+        }
+
+        save.options.hostBufferSpace = hostBufferSpace;
+        save.options.hostTileHeight = hostTileHeight;
+        save.fileType = static_cast<OutputImageFileType>(static_cast<int32>(fileType));
+        save.isRetry = isRetry != 0;
+
+        ReadFilePath(file.get(), save.outputFilePath);
+        ReadFilePath(file.get(), save.tempFilePath);
+
+        save.inputFilePath = path;
+        save.inputFilePath.replace_extension(".g8i");
+    }
+
+    void WritePendingSaveFile(const BackgroundImageSave& save)
+    {
+        ::std::unique_ptr<FileHandle> file = OpenFile(GetPendingSaveFilePath(save.inputFilePath), FileOpenMode::Write);
+
+        PendingSaveFileHeader header;
+
+        WriteFile(file.get(), &header, sizeof(header));
+
+        const boost::endian::little_int32_t fileType = static_cast<int32>(save.fileType);
+        const boost::endian::little_uint64_t hostBufferSpace = save.options.hostBufferSpace;
+        const boost::endian::little_int32_t hostTileHeight = save.options.hostTileHeight;
+        const boost::endian::little_int32_t isRetry = save.isRetry ? 1 : 0;
+
+        WriteFile(file.get(), &fileType, sizeof(fileType));
+        WriteFile(file.get(), &hostBufferSpace, sizeof(hostBufferSpace));
+        WriteFile(file.get(), &hostTileHeight, sizeof(hostTileHeight));
+        WriteFile(file.get(), &isRetry, sizeof(isRetry));
+        WriteFilePath(file.get(), save.outputFilePath);
+        WriteFilePath(file.get(), save.tempFilePath);
+    }
+
+    // Moves a file into a pending save directory, the directories can be on different volumes.
+    void MovePendingSaveFile(const boost::filesystem::path& sourcePath, const boost::filesystem::path& destinationPath)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::rename(sourcePath, destinationPath, ec);
+
+        if (ec)
+        {
+            boost::filesystem::copy_file(sourcePath, destinationPath);
+            boost::filesystem::remove(sourcePath, ec);
+        }
+    }
+
+    void RemovePendingSaveFiles(const BackgroundImageSave& save) noexcept
+    {
+        try
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove(save.tempFilePath, ec);
+            boost::filesystem::remove(save.inputFilePath, ec);
+            boost::filesystem::remove(GetPendingSaveFilePath(save.inputFilePath), ec);
+        }
+        catch (...)
+        {
+            // Ignore any errors, the files are removed with the pending save directory.
+        }
+    }
+
+    void SaveImage(const BackgroundImageSave& save)
+    {
+        // The image is written to a temporary file next to the output file and then renamed,
+        // so a save that fails part way through never leaves a truncated image at the output path.
+        try
+        {
+            ConvertGmic8bfImageToOutputFile(save.options, save.fileType, save.inputFilePath, save.tempFilePath);
+
+            boost::filesystem::rename(save.tempFilePath, save.outputFilePath);
+        }
+        catch (...)
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove(save.tempFilePath, ec);
+
+            throw;
+        }
+
+        RemovePendingSaveFiles(save);
+    }
+
+    void AppendToErrorLog(const ::std::string& message)
+    {
+        char timestamp[32]{};
+
+        const ::std::time_t now = ::std::time(nullptr);
+        const ::std::tm* localTime = ::std::localtime(&now);
+
+        if (localTime)
+        {
+            ::std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localTime);
+        }
+
+        boost::filesystem::ofstream stream(GetErrorLogPath(), ::std::ios::out | ::std::ios::app);
+
+        stream << timestamp << ' ' << message << '\n';
+    }
+
+    class BackgroundImageWriter
+    {
+    public:
+        static BackgroundImageWriter& GetInstance()
+        {
+            static BackgroundImageWriter instance;
+
+            return instance;
+        }
+
+        // Gets the pending save directory of this session, the directory is locked until the host
+        // exits so that the other running sessions do not resume its saves.
+        boost::filesystem::path GetSessionDirectory()
+        {
+            ::std::lock_guard<::std::mutex> lock(mutex);
+
+            if (!sessionLock)
+            {
+                boost::filesystem::path path = GetBackgroundSaveDirectory();
+                path /= boost::filesystem::unique_path();
+
+                boost::filesystem::create_directory(path);
+
+                sessionLock = OpenFile(path / SessionLockFileName, FileOpenMode::Write);
+                sessionDirectory = path;
+            }
+
+            return sessionDirectory;
+        }
+
+        void Enqueue(BackgroundImageSave&& save)
+        {
+            ::std::unique_lock<::std::mutex> lock(mutex);
+
+            queueNotFull.wait(lock, [this] { return queue.size() < MaxQueuedImageSaves; });
+
+            // The saves that failed earlier in this session are retried once with the next image.
+            while (!failedSaves.empty())
+            {
+                queue.push_back(::std::move(failedSaves.back()));
+                failedSaves.pop_back();
+            }
+
+            queue.push_back(::std::move(save));
+
+            StartWorker(lock);
+        }
+
+        // Queues the saves that were interrupted when the host exited during an earlier session.
+        // The pending save directories of the sessions that are still running are locked, so
+        // their saves are skipped.
+        void ResumePendingSaves()
+        {
+            {
+                ::std::lock_guard<::std::mutex> lock(mutex);
+
+                if (pendingSavesResumed)
+                {
+                    return;
+                }
+
+                pendingSavesResumed = true;
+            }
+
+            const boost::filesystem::path currentSessionDirectory = GetSessionDirectory();
+
+            ::std::vector<BackgroundImageSave> resumedSaves;
+
+            boost::system::error_code ec;
+
+            for (boost::filesystem::directory_iterator it(GetBackgroundSaveDirectory(), ec), end; !ec && it != end; it.increment(ec))
+            {
+                boost::system::error_code statusError;
+
+                if (it->path() != currentSessionDirectory && boost::filesystem::is_directory(it->path(), statusError))
+                {
+                    ClaimPendingSaves(it->path(), currentSessionDirectory, resumedSaves);
+                }
+            }
+
+            if (!resumedSaves.empty())
+            {
+                ::std::unique_lock<::std::mutex> lock(mutex);
+
+                for (BackgroundImageSave& save : resumedSaves)
+                {
+                    queue.push_back(::std::move(save));
+                }
+
+                StartWorker(lock);
+            }
+        }
+
+        ::std::string TakeErrorMessages()
+        {
+            ::std::lock_guard<::std::mutex> lock(mutex);
+
+            ::std::string message;
+
+            for (const ::std::string& item : errorMessages)
+            {
+                if (!message.empty())
+                {
+                    message += "\n";
+                }
+
+                message += item;
+            }
+
+            errorMessages.clear();
+
+            if (!message.empty())
+            {
+                try
+                {
+                    message += "\n\nThe errors are logged in ";
+                    message += GetErrorLogPath().string();
+                    message += ".";
+                }
+                catch (...)
+                {
+                    // Ignore any errors, the error messages are still shown.
+                }
+            }
+
+            return message;
+        }
+
+    private:
+
+        BackgroundImageWriter()
+            : mutex(), queueNotFull(), queue(), failedSaves(), errorMessages(), sessionDirectory(), sessionLock(),
+              workerRunning(false), pendingSavesResumed(false)
+        {
+        }
+
+        static void StaticThreadProc()
+        {
+            GetInstance().ThreadProc();
+        }
+
+        // Starts the worker thread if it is not already running. If the worker thread could not
+        // be started the queued images are saved on the calling thread.
+        void StartWorker(::std::unique_lock<::std::mutex>& lock)
+        {
+            if (workerRunning)
+            {
+                return;
+            }
+
+            try
+            {
+                StartBackgroundImageWriterThreadNative(&BackgroundImageWriter::StaticThreadProc);
+                workerRunning = true;
+            }
+            catch (...)
+            {
+                // The queue is empty when the worker thread exits, so it only holds
+                // the saves that were added by the caller.
+                ::std::deque<BackgroundImageSave> saves = ::std::move(queue);
+                queue.clear();
+
+                lock.unlock();
+                queueNotFull.notify_all();
+
+                for (BackgroundImageSave& save : saves)
+                {
+                    ProcessSave(::std::move(save));
+                }
+            }
+        }
+
+        void ThreadProc() noexcept
+        {
+            for (;;)
+            {
+                BackgroundImageSave save;
+
+                {
+                    ::std::lock_guard<::std::mutex> lock(mutex);
+
+                    if (queue.empty())
+                    {
+                        // The thread will be restarted when the next image is queued.
+                        workerRunning = false;
+                        return;
+                    }
+
+                    save = ::std::move(queue.front());
+                    queue.pop_front();
+                }
+
+                queueNotFull.notify_all();
+
+                ProcessSave(::std::move(save));
+            }
+        }
+
+        void ProcessSave(BackgroundImageSave&& save) noexcept
+        {
+            try
+            {
+                SaveImage(save);
+                DebugOut("Saved %s in the background.", save.outputFilePath.string().c_str());
+            }
+            catch (const ::std::bad_alloc&)
+            {
+                HandleFailedSave(::std::move(save), "Insufficient memory to save the image.");
+            }
+            catch (const ::std::exception& e)
+            {
+                HandleFailedSave(::std::move(save), e.what());
+            }
+            catch (...)
+            {
+                HandleFailedSave(::std::move(save), "An unspecified error occurred when saving the image.");
+            }
+        }
+
+        // Keeps the files of a failed save so that it can be retried, and records the error
+        // in the error log. The errors are only shown to the user when the next filter starts.
+        void HandleFailedSave(BackgroundImageSave&& save, const char* message) noexcept
+        {
+            try
+            {
+                ::std::string errorMessage = "Unable to save ";
+                errorMessage += save.outputFilePath.filename().string();
+                errorMessage += ": ";
+                errorMessage += message;
+
+                ::std::string logMessage = "Unable to save ";
+                logMessage += save.outputFilePath.string();
+                logMessage += ": ";
+                logMessage += message;
+
+                bool retrySave = false;
+
+                if (!save.isRetry)
+                {
+                    ::std::lock_guard<::std::mutex> lock(mutex);
+
+                    retrySave = failedSaves.size() < MaxRetainedFailedSaves;
+                }
+
+                if (retrySave)
+                {
+                    save.isRetry = true;
+
+                    try
+                    {
+                        WritePendingSaveFile(save);
+                    }
+                    catch (...)
+                    {
+                        // Ignore any errors, the existing pending save file is still valid.
+                    }
+
+                    logMessage += " The save will be retried with the next output image, the input file is ";
+                    logMessage += save.inputFilePath.string();
+                }
+                else
+                {
+                    RemovePendingSaveFiles(save);
+
+                    logMessage += " The save has been abandoned.";
+                }
+
+                if (retrySave)
+                {
+                    ::std::lock_guard<::std::mutex> lock(mutex);
+
+                    failedSaves.push_back(::std::move(save));
+                }
+
+                RecordError(::std::move(errorMessage), logMessage);
+            }
+            catch (...)
+            {
+                // Ignore any errors, the image has not been saved.
+            }
+        }
+
+        // Moves the pending saves of a session that has exited into the current session directory.
+        // The saves that cannot be resumed are abandoned and reported.
+        void ClaimPendingSaves(
+            const boost::filesystem::path& directory,
+            const boost::filesystem::path& currentSessionDirectory,
+            ::std::vector<BackgroundImageSave>& resumedSaves) noexcept
+        {
+            try
+            {
+                boost::system::error_code ec;
+
+                if (!boost::filesystem::exists(directory / SessionLockFileName, ec))
+                {
+                    // The session that owns the directory has not locked it yet.
+                    return;
+                }
+
+                ::std::unique_ptr<FileHandle> directoryLock;
+
+                try
+                {
+                    directoryLock = OpenFile(directory / SessionLockFileName, FileOpenMode::Write);
+                }
+                catch (...)
+                {
+                    // The session that owns the directory is still running.
+                    return;
+                }
+
+                for (boost::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+                {
+                    const boost::filesystem::path& path = it->path();
+                    boost::system::error_code statusError;
+
+                    if (path.extension() == ".g8ps")
+                    {
+                        ResumePendingSave(path, currentSessionDirectory, resumedSaves);
+                    }
+                    else if (path.extension() == ".g8i" &&
+                             boost::filesystem::exists(path, statusError) &&
+                             !boost::filesystem::exists(GetPendingSaveFilePath(path), statusError))
+                    {
+                        // The host exited before the pending save file was written.
+                        RecordError(
+                            "An output image that was waiting to be saved has been lost.",
+                            "The background save of " + path.string() + " has been abandoned, it does not have a pending save file.");
+                    }
+                }
+
+                directoryLock.reset();
+
+                boost::filesystem::remove_all(directory, ec);
+            }
+            catch (...)
+            {
+                // Ignore any errors, the directory is checked again by the next session.
+            }
+        }
+
+        void ResumePendingSave(
+            const boost::filesystem::path& pendingSaveFilePath,
+            const boost::filesystem::path& currentSessionDirectory,
+            ::std::vector<BackgroundImageSave>& resumedSaves) noexcept
+        {
+            BackgroundImageSave save{};
+
+            try
+            {
+                ReadPendingSaveFile(pendingSaveFilePath, save);
+
+                // Remove the partial output of the save that was interrupted.
+                boost::system::error_code ec;
+                boost::filesystem::remove(save.tempFilePath, ec);
+
+                const boost::filesystem::path inputFilePath = GetTemporaryFileName(currentSessionDirectory, ".g8i");
+
+                MovePendingSaveFile(save.inputFilePath, inputFilePath);
+
+                save.inputFilePath = inputFilePath;
+                save.tempFilePath = GetTemporaryFileName(
+                    save.outputFilePath.parent_path(),
+                    GetOutputImageFileExtension(save.fileType));
+
+                WritePendingSaveFile(save);
+
+                AppendToErrorLog("Resuming the background save of " + save.outputFilePath.string() + ", it was interrupted when the host exited.");
+
+                resumedSaves.push_back(::std::move(save));
+            }
+            catch (const ::std::exception& e)
+            {
+                AbandonPendingSave(save, pendingSaveFilePath, e.what());
+            }
+            catch (...)
+            {
+                AbandonPendingSave(save, pendingSaveFilePath, "An unspecified error occurred when resuming the save.");
+            }
+        }
+
+        void AbandonPendingSave(
+            const BackgroundImageSave& save,
+            const boost::filesystem::path& pendingSaveFilePath,
+            const char* message) noexcept
+        {
+            try
+            {
+                ::std::string errorMessage;
+                ::std::string logMessage;
+
+                if (save.outputFilePath.empty())
+                {
+                    errorMessage = "An output image that was waiting to be saved has been lost: ";
+                    logMessage = "The background save in " + pendingSaveFilePath.string() + " has been abandoned: ";
+                }
+                else
+                {
+                    errorMessage = "Unable to save " + save.outputFilePath.filename().string() + ": ";
+                    logMessage = "The background save of " + save.outputFilePath.string() + " has been abandoned: ";
+                }
+
+                errorMessage += message;
+                logMessage += message;
+
+                RemovePendingSaveFiles(save);
+
+                RecordError(::std::move(errorMessage), logMessage);
+            }
+            catch (...)
+            {
+                // Ignore any errors, the files are removed with the pending save directory.
+            }
+        }
+
+        // Keeps the error message until it is shown to the user, and writes it to the error log.
+        void RecordError(::std::string&& errorMessage, const ::std::string& logMessage) noexcept
+        {
+            try
+            {
+                {
+                    ::std::lock_guard<::std::mutex> lock(mutex);
+
+                    if (errorMessages.size() < MaxSavedErrorMessages)
+                    {
+                        errorMessages.push_back(::std::move(errorMessage));
+                    }
+                }
+
+                AppendToErrorLog(logMessage);
+            }
+            catch (...)
+            {
+                // Ignore any errors, the image has not been saved.
+            }
+        }
+
+        ::std::mutex mutex;
+        ::std::condition_variable queueNotFull;
+        ::std::deque<BackgroundImageSave> queue;
+        ::std::vector<BackgroundImageSave> failedSaves;
+        ::std::vector<::std::string> errorMessages;
+        boost::filesystem::path sessionDirectory;
+        ::std::unique_ptr<FileHandle> sessionLock;
+        bool workerRunning;
+        bool pendingSavesResumed;
+    };
+}
+
+void QueueBackgroundImageSave(
+    const OutputImageWriterOptions& options,
+    OutputImageFileType fileType,
+    const boost::filesystem::path& inputFilePath,
+    const boost::filesystem::path& outputFilePath)
+{
+    BackgroundImageWriter& writer = BackgroundImageWriter::GetInstance();
+
+    BackgroundImageSave save{};
+    save.options = options;
+    save.fileType = fileType;
+    save.inputFilePath = GetTemporaryFileName(writer.GetSessionDirectory(), ".g8i");
+    save.outputFilePath = outputFilePath;
+    save.tempFilePath = GetTemporaryFileName(outputFilePath.parent_path(), GetOutputImageFileExtension(fileType));
+    save.isRetry = false;
+
+    // The input file is moved out of the G'MIC-Qt output directory so that it
+    // cannot be overwritten or read again by the next filter invocation.
+    MovePendingSaveFile(inputFilePath, save.inputFilePath);
+
+    try
+    {
+        WritePendingSaveFile(save);
+    }
+    catch (...)
+    {
+        RemovePendingSaveFiles(save);
+        throw;
+    }
+
+    writer.Enqueue(::std::move(save));
+}
+
+void ResumeBackgroundImageSaves() noexcept
+{
+    try
+    {
+        BackgroundImageWriter::GetInstance().ResumePendingSaves();
+    }
+    catch (...)
+    {
+        // Ignore any errors, the saves are resumed by the next session.
+    }
+}
+
+void ShowBackgroundImageSaveErrors(const FilterRecordPtr filterRecord)
+{
+    const ::std::string message = BackgroundImageWriter::GetInstance().TakeErrorMessages();
+
+    if (!message.empty())
+    {
+        // The error is reported to the user but it does not stop the current filter invocation.
+        ShowErrorMessage(message.c_str(), filterRecord, writErr);
+    }
+}
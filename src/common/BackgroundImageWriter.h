@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef BACKGROUNDIMAGEWRITER_H
+#define BACKGROUNDIMAGEWRITER_H
+
+#include "GmicPlugin.h"
+#include "OutputImageWriter.h"
+#include <boost/filesystem.hpp>
+
+// Queues a G'MIC-Qt output image to be saved after the filter has returned to the host.
+// The input file is moved to a pending save directory that is owned by the background writer,
+// and it is deleted after the image has been saved. If the save fails the input file is kept
+// and the save is retried once when the next image is queued.
+// If the queue is full this function waits until one of the queued images has been saved.
+void QueueBackgroundImageSave(
+    const OutputImageWriterOptions& options,
+    OutputImageFileType fileType,
+    const boost::filesystem::path& inputFilePath,
+    const boost::filesystem::path& outputFilePath);
+
+// Queues the saves that were interrupted when the host exited during an earlier session.
+void ResumeBackgroundImageSaves() noexcept;
+
+// Shows the errors from any background saves that failed since this function was last called.
+// The errors are also written to a log file in the plug-in cache directory.
+void ShowBackgroundImageSaveErrors(const FilterRecordPtr filterRecord);
+
+#endif // !BACKGROUNDIMAGEWRITER_H
@@ -0,0 +1,377 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "BufferPool.h"
+#include "MemoryUsage.h"
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <memory>
+#include <new>
+#include <thread>
+
+#if __PIWin__
+#include "MemoryWin.h"
+#endif // __PIWin__
+
+enum class BufferPoolBlockSource
+{
+    HostBuffer = 0,
+    Heap,
+    LargePage
+};
+
+struct BufferPoolBlock
+{
+    BufferPoolBlockSource source;
+    BufferID bufferID;
+    void* allocation;
+    void* data;
+    size_t capacity;
+    size_t allocationSize;
+};
+
+namespace
+{
+    constexpr size_t CacheLineSize = 64;
+
+    // Buffers up to 1 MB use power of two size classes, larger buffers are rounded
+    // up to the next multiple of 1 MB.
+    constexpr size_t MinimumSizeClass = 4096;
+    constexpr size_t LargeSizeClassGranularity = 1024 * 1024;
+
+    // The maximum number of bytes that the pool keeps for reuse.
+    constexpr size_t MaximumIdleBytes = 64 * 1024 * 1024;
+
+    size_t GetSizeClass(size_t size)
+    {
+        if (size <= LargeSizeClassGranularity)
+        {
+            size_t sizeClass = MinimumSizeClass;
+
+            while (sizeClass < size)
+            {
+                sizeClass *= 2;
+            }
+
+            return sizeClass;
+        }
+        else
+        {
+            if (size > (::std::numeric_limits<size_t>::max() - LargeSizeClassGranularity))
+            {
+                throw ::std::bad_alloc();
+            }
+
+            return ((size + LargeSizeClassGranularity - 1) / LargeSizeClassGranularity) * LargeSizeClassGranularity;
+        }
+    }
+
+    MemoryUsageCategory GetMemoryUsageCategory(BufferPoolBlockSource source) noexcept
+    {
+        return source == BufferPoolBlockSource::HostBuffer ? MemoryUsageCategory::HostBuffer : MemoryUsageCategory::Heap;
+    }
+
+    BufferPoolBlock* AllocateHostBufferBlock(const FilterRecord* filterRecord, size_t capacity)
+    {
+        if (filterRecord == nullptr ||
+            capacity > static_cast<size_t>(::std::numeric_limits<int32>::max()) - (CacheLineSize - 1))
+        {
+            return nullptr;
+        }
+
+        // The BufferSuite does not provide an alignment guarantee, so the buffer
+        // is over-allocated and the data pointer is aligned to the cache line size.
+        const int32 allocationSize = static_cast<int32>(capacity + (CacheLineSize - 1));
+
+        ::std::unique_ptr<BufferPoolBlock> block = ::std::make_unique<BufferPoolBlock>();
+        BufferID bufferID = nullptr;
+
+        if (filterRecord->bufferProcs->allocateProc(allocationSize, &bufferID) != noErr)
+        {
+            return nullptr;
+        }
+
+        Ptr allocation = filterRecord->bufferProcs->lockProc(bufferID, false);
+
+        if (allocation == nullptr)
+        {
+            filterRecord->bufferProcs->freeProc(bufferID);
+            return nullptr;
+        }
+
+        const uintptr_t address = reinterpret_cast<uintptr_t>(allocation);
+        const uintptr_t alignedAddress = (address + (CacheLineSize - 1)) & ~static_cast<uintptr_t>(CacheLineSize - 1);
+
+        block->source = BufferPoolBlockSource::HostBuffer;
+        block->bufferID = bufferID;
+        block->allocation = allocation;
+        block->data = reinterpret_cast<void*>(alignedAddress);
+        block->capacity = capacity;
+        block->allocationSize = static_cast<size_t>(allocationSize);
+
+        RecordMemoryAllocation(MemoryUsageCategory::HostBuffer, block->allocationSize);
+
+        return block.release();
+    }
+
+    BufferPoolBlock* AllocateHeapBlock(size_t capacity)
+    {
+        ::std::unique_ptr<BufferPoolBlock> block = ::std::make_unique<BufferPoolBlock>();
+
+        block->bufferID = nullptr;
+        block->capacity = capacity;
+
+#if __PIWin__
+        size_t largePageAllocationSize = 0;
+        void* largePageMemory = AllocateLargePageMemory(capacity, largePageAllocationSize);
+
+        if (largePageMemory != nullptr)
+        {
+            block->source = BufferPoolBlockSource::LargePage;
+            block->allocation = largePageMemory;
+            block->data = largePageMemory;
+            block->allocationSize = largePageAllocationSize;
+        }
+        else
+#endif // __PIWin__
+        {
+            void* memory = ::operator new(capacity, ::std::align_val_t(CacheLineSize), ::std::nothrow);
+
+            if (memory == nullptr)
+            {
+                throw ::std::bad_alloc();
+            }
+
+            block->source = BufferPoolBlockSource::Heap;
+            block->allocation = memory;
+            block->data = memory;
+            block->allocationSize = capacity;
+        }
+
+        RecordMemoryAllocation(MemoryUsageCategory::Heap, block->allocationSize);
+
+        return block.release();
+    }
+
+    void FreeBlock(const FilterRecord* filterRecord, BufferPoolBlock* block) noexcept
+    {
+        switch (block->source)
+        {
+        case BufferPoolBlockSource::HostBuffer:
+            filterRecord->bufferProcs->unlockProc(block->bufferID);
+            filterRecord->bufferProcs->freeProc(block->bufferID);
+            break;
+        case BufferPoolBlockSource::Heap:
+            ::operator delete(block->allocation, ::std::align_val_t(CacheLineSize));
+            break;
+#if __PIWin__
+        case BufferPoolBlockSource::LargePage:
+            FreeLargePageMemory(block->allocation);
+            break;
+#endif // __PIWin__
+        default:
+            break;
+        }
+
+        RecordMemoryFree(GetMemoryUsageCategory(block->source), block->allocationSize);
+
+        delete block;
+    }
+}
+
+class BufferPool : private boost::noncopyable
+{
+public:
+    explicit BufferPool(FilterRecordPtr filterRecord)
+        : filterRecord(filterRecord), ownerThreadId(::std::this_thread::get_id()), idleBlocks(),
+          idleBytes(0), allocationCount(0), reuseCount(0)
+    {
+    }
+
+    ~BufferPool()
+    {
+        DebugOut("%s: %u allocations, %u reused buffers", __FUNCTION__, allocationCount, reuseCount);
+
+        for (auto& item : idleBlocks)
+        {
+            FreeBlock(filterRecord, item.second);
+        }
+    }
+
+    bool IsOwnerThread() const noexcept
+    {
+        return ::std::this_thread::get_id() == ownerThreadId;
+    }
+
+    PooledBuffer Acquire(size_t size)
+    {
+        const size_t sizeClass = GetSizeClass(size);
+
+        auto it = idleBlocks.find(sizeClass);
+
+        if (it != idleBlocks.end())
+        {
+            BufferPoolBlock* block = it->second;
+
+            idleBlocks.erase(it);
+            idleBytes -= block->capacity;
+            reuseCount++;
+
+            return PooledBuffer(this, block, size);
+        }
+
+        BufferPoolBlock* block = AllocateHostBufferBlock(filterRecord, sizeClass);
+
+        if (block == nullptr)
+        {
+            block = AllocateHeapBlock(sizeClass);
+        }
+
+        allocationCount++;
+
+        return PooledBuffer(this, block, size);
+    }
+
+    static PooledBuffer AcquireUnpooled(size_t size)
+    {
+        return PooledBuffer(nullptr, AllocateHeapBlock(GetSizeClass(size)), size);
+    }
+
+    void Return(BufferPoolBlock* block) noexcept
+    {
+        if ((idleBytes + block->capacity) <= MaximumIdleBytes)
+        {
+            try
+            {
+                idleBlocks.emplace(block->capacity, block);
+                idleBytes += block->capacity;
+                return;
+            }
+            catch (...)
+            {
+                // Free the block if it cannot be added to the pool.
+            }
+        }
+
+        FreeBlock(filterRecord, block);
+    }
+
+private:
+    const FilterRecord* filterRecord;
+    const ::std::thread::id ownerThreadId;
+    ::std::multimap<size_t, BufferPoolBlock*> idleBlocks;
+    size_t idleBytes;
+    uint32 allocationCount;
+    uint32 reuseCount;
+};
+
+namespace
+{
+    BufferPool* activeBufferPool = nullptr;
+}
+
+PooledBuffer::PooledBuffer() noexcept
+    : pool(nullptr), block(nullptr), bufferSize(0)
+{
+}
+
+PooledBuffer::PooledBuffer(BufferPool* pool, BufferPoolBlock* block, size_t size) noexcept
+    : pool(pool), block(block), bufferSize(size)
+{
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+    : pool(other.pool), block(other.block), bufferSize(other.bufferSize)
+{
+    other.pool = nullptr;
+    other.block = nullptr;
+    other.bufferSize = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+
+        pool = other.pool;
+        block = other.block;
+        bufferSize = other.bufferSize;
+
+        other.pool = nullptr;
+        other.block = nullptr;
+        other.bufferSize = 0;
+    }
+
+    return *this;
+}
+
+PooledBuffer::~PooledBuffer()
+{
+    Release();
+}
+
+void* PooledBuffer::data() const noexcept
+{
+    return block != nullptr ? block->data : nullptr;
+}
+
+size_t PooledBuffer::size() const noexcept
+{
+    return bufferSize;
+}
+
+void PooledBuffer::Release() noexcept
+{
+    if (block != nullptr)
+    {
+        if (pool != nullptr)
+        {
+            pool->Return(block);
+        }
+        else
+        {
+            FreeBlock(nullptr, block);
+        }
+
+        pool = nullptr;
+        block = nullptr;
+        bufferSize = 0;
+    }
+}
+
+BufferPoolSession::BufferPoolSession(FilterRecordPtr filterRecord)
+    : pool(new BufferPool(filterRecord))
+{
+    activeBufferPool = pool;
+}
+
+BufferPoolSession::~BufferPoolSession()
+{
+    if (activeBufferPool == pool)
+    {
+        activeBufferPool = nullptr;
+    }
+
+    delete pool;
+}
+
+PooledBuffer AcquirePooledBuffer(size_t size)
+{
+    if (activeBufferPool != nullptr && activeBufferPool->IsOwnerThread())
+    {
+        return activeBufferPool->Acquire(size);
+    }
+
+    return BufferPool::AcquireUnpooled(size);
+}
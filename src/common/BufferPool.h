@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include "Common.h"
+#include <boost/core/noncopyable.hpp>
+
+class BufferPool;
+struct BufferPoolBlock;
+
+// A cache-line aligned buffer that is returned to the session pool when destroyed.
+class PooledBuffer : private boost::noncopyable
+{
+public:
+    PooledBuffer() noexcept;
+
+    PooledBuffer(PooledBuffer&& other) noexcept;
+
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+
+    ~PooledBuffer();
+
+    void* data() const noexcept;
+
+    size_t size() const noexcept;
+
+private:
+    friend class BufferPool;
+
+    PooledBuffer(BufferPool* pool, BufferPoolBlock* block, size_t size) noexcept;
+
+    void Release() noexcept;
+
+    BufferPool* pool;
+    BufferPoolBlock* block;
+    size_t bufferSize;
+};
+
+// Keeps the buffers that are released during a filter invocation so that
+// they can be reused by the following layers, planes and output conversions.
+// The buffers are allocated from the host BufferSuite with a heap fallback.
+class BufferPoolSession : private boost::noncopyable
+{
+public:
+    explicit BufferPoolSession(FilterRecordPtr filterRecord);
+
+    ~BufferPoolSession();
+
+private:
+    BufferPool* pool;
+};
+
+// Gets a buffer from the session pool when called on the thread that created the
+// session, otherwise the buffer is allocated from the heap and freed when it is destroyed.
+PooledBuffer AcquirePooledBuffer(size_t size);
+
+#endif // !BUFFERPOOL_H
@@ -0,0 +1,374 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "DibReader.h"
+#include "BufferPool.h"
+#include "FileIO.h"
+#include "FileUtil.h"
+#include "Gmic8bfImageWriter.h"
+#include "TilePlanner.h"
+#include <boost/endian.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DIBREADER_USE_SSE2 1
+#else
+#define DIBREADER_USE_SSE2 0
+#endif
+
+namespace
+{
+    // The compression values from the Windows BITMAPINFOHEADER structure.
+    constexpr uint32 DibCompressionRgb = 0;
+    constexpr uint32 DibCompressionBitfields = 3;
+
+    // The size of the BITMAPINFOHEADER structure, and the sizes of the later
+    // header versions that include the color masks.
+    constexpr uint32 DibInfoHeaderSize = 40;
+    constexpr uint32 DibV2InfoHeaderSize = 52;
+    constexpr uint32 DibV3InfoHeaderSize = 56;
+
+    struct DibInfoHeader
+    {
+        boost::endian::little_uint32_t size;
+        boost::endian::little_int32_t width;
+        boost::endian::little_int32_t height;
+        boost::endian::little_uint16_t planes;
+        boost::endian::little_uint16_t bitCount;
+        boost::endian::little_uint32_t compression;
+        boost::endian::little_uint32_t sizeImage;
+        boost::endian::little_int32_t xPelsPerMeter;
+        boost::endian::little_int32_t yPelsPerMeter;
+        boost::endian::little_uint32_t colorsUsed;
+        boost::endian::little_uint32_t colorsImportant;
+    };
+
+    static_assert(sizeof(DibInfoHeader) == DibInfoHeaderSize, "The DibInfoHeader structure size is incorrect.");
+
+    struct DibLayout
+    {
+        const uint8* pixels;
+        uint64 stride;
+        int32 width;
+        int32 height;
+        bool topDown;
+        int32 sourceBytesPerPixel;
+        int32 numberOfChannels;
+        // The byte offset of each channel in a source pixel.
+        int32 redOffset;
+        int32 greenOffset;
+        int32 blueOffset;
+        int32 alphaOffset;
+    };
+
+    uint32 ReadMask(const uint8* data)
+    {
+        boost::endian::little_uint32_t value;
+
+        ::std::memcpy(&value, data, sizeof(value));
+
+        return value;
+    }
+
+    // Gets the byte offset of a color mask, the converter only supports masks
+    // that select a whole byte of the pixel.
+    bool TryGetMaskByteOffset(uint32 mask, int32 bytesPerPixel, int32& offset)
+    {
+        for (int32 i = 0; i < bytesPerPixel; i++)
+        {
+            if (mask == (static_cast<uint32>(0xff) << (i * 8)))
+            {
+                offset = i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool TryGetDibLayout(const uint8* dib, size_t dibLength, DibLayout& layout)
+    {
+        if (dibLength < sizeof(DibInfoHeader))
+        {
+            return false;
+        }
+
+        DibInfoHeader header;
+
+        ::std::memcpy(&header, dib, sizeof(header));
+
+        const uint32 headerSize = header.size;
+        const int32 bitCount = header.bitCount;
+        const uint32 compression = header.compression;
+
+        if (headerSize < DibInfoHeaderSize ||
+            headerSize > dibLength ||
+            header.width <= 0 ||
+            header.height == 0 ||
+            header.height == ::std::numeric_limits<int32>::min() ||
+            (bitCount != 24 && bitCount != 32) ||
+            (compression != DibCompressionRgb && compression != DibCompressionBitfields))
+        {
+            return false;
+        }
+
+        const int32 bytesPerPixel = bitCount / 8;
+        uint64 pixelOffset = headerSize;
+
+        uint32 redMask = 0x00ff0000;
+        uint32 greenMask = 0x0000ff00;
+        uint32 blueMask = 0x000000ff;
+        uint32 alphaMask = 0;
+
+        if (compression == DibCompressionBitfields)
+        {
+            if (bitCount != 32)
+            {
+                return false;
+            }
+
+            if (headerSize == DibInfoHeaderSize)
+            {
+                // The red, green and blue masks follow a BITMAPINFOHEADER.
+                if (dibLength < DibV2InfoHeaderSize)
+                {
+                    return false;
+                }
+
+                pixelOffset += 3 * sizeof(uint32);
+            }
+            else if (headerSize >= DibV3InfoHeaderSize)
+            {
+                alphaMask = ReadMask(dib + 52);
+            }
+
+            redMask = ReadMask(dib + 40);
+            greenMask = ReadMask(dib + 44);
+            blueMask = ReadMask(dib + 48);
+        }
+
+        layout.alphaOffset = 0;
+
+        if (!TryGetMaskByteOffset(redMask, bytesPerPixel, layout.redOffset) ||
+            !TryGetMaskByteOffset(greenMask, bytesPerPixel, layout.greenOffset) ||
+            !TryGetMaskByteOffset(blueMask, bytesPerPixel, layout.blueOffset) ||
+            (alphaMask != 0 && !TryGetMaskByteOffset(alphaMask, bytesPerPixel, layout.alphaOffset)))
+        {
+            return false;
+        }
+
+        // The color table is not used by 24-bit and 32-bit images, but it may still be present.
+        pixelOffset += static_cast<uint64>(header.colorsUsed) * 4;
+
+        const int64 signedHeight = header.height;
+
+        layout.width = header.width;
+        layout.height = static_cast<int32>(signedHeight < 0 ? -signedHeight : signedHeight);
+        layout.topDown = signedHeight < 0;
+        layout.sourceBytesPerPixel = bytesPerPixel;
+        layout.numberOfChannels = alphaMask != 0 ? 4 : 3;
+        layout.stride = ((static_cast<uint64>(layout.width) * bitCount + 31) & ~static_cast<uint64>(31)) / 8;
+
+        const uint64 requiredLength = pixelOffset + (layout.stride * static_cast<uint64>(layout.height));
+
+        if (requiredLength > dibLength)
+        {
+            return false;
+        }
+
+        layout.pixels = dib + pixelOffset;
+
+        return true;
+    }
+
+    void ConvertBgraRowToRgba(const uint8* source, uint8* destination, int32 width)
+    {
+        int32 x = 0;
+
+#if DIBREADER_USE_SSE2
+        const __m128i greenAlphaMask = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+        const __m128i lowByteMask = _mm_set1_epi32(0x000000ff);
+
+        for (; x <= (width - 4); x += 4)
+        {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + (static_cast<size_t>(x) * 4)));
+
+            // Swap the red and blue bytes of each pixel, the green and alpha bytes are unchanged.
+            const __m128i greenAlpha = _mm_and_si128(pixels, greenAlphaMask);
+            const __m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 16), lowByteMask);
+            const __m128i blue = _mm_slli_epi32(_mm_and_si128(pixels, lowByteMask), 16);
+
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i*>(destination + (static_cast<size_t>(x) * 4)),
+                _mm_or_si128(greenAlpha, _mm_or_si128(red, blue)));
+        }
+#endif // DIBREADER_USE_SSE2
+
+        for (; x < width; x++)
+        {
+            const uint8* src = source + (static_cast<size_t>(x) * 4);
+            uint8* dst = destination + (static_cast<size_t>(x) * 4);
+
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = src[3];
+        }
+    }
+
+    void ConvertDibRow(const uint8* source, uint8* destination, const DibLayout& layout)
+    {
+        const int32 width = layout.width;
+        const int32 sourceBytesPerPixel = layout.sourceBytesPerPixel;
+        const int32 redOffset = layout.redOffset;
+        const int32 greenOffset = layout.greenOffset;
+        const int32 blueOffset = layout.blueOffset;
+
+        if (layout.numberOfChannels == 4)
+        {
+            const int32 alphaOffset = layout.alphaOffset;
+
+            if (redOffset == 2 && greenOffset == 1 && blueOffset == 0 && alphaOffset == 3)
+            {
+                ConvertBgraRowToRgba(source, destination, width);
+            }
+            else
+            {
+                for (int32 x = 0; x < width; x++)
+                {
+                    destination[0] = source[redOffset];
+                    destination[1] = source[greenOffset];
+                    destination[2] = source[blueOffset];
+                    destination[3] = source[alphaOffset];
+
+                    source += 4;
+                    destination += 4;
+                }
+            }
+        }
+        else
+        {
+            // This loop should be automatically vectorized by the compiler.
+            for (int32 x = 0; x < width; x++)
+            {
+                destination[0] = source[redOffset];
+                destination[1] = source[greenOffset];
+                destination[2] = source[blueOffset];
+
+                source += sourceBytesPerPixel;
+                destination += 3;
+            }
+        }
+    }
+
+    struct DibStripWriter
+    {
+        const DibLayout* layout;
+        int32 stripHeight;
+
+        static void WriteCallback(
+            FileHandle* file,
+            int32 imageWidth,
+            int32 imageHeight,
+            int32 numberOfChannels,
+            int32 bitsPerChannel,
+            void* callbackState)
+        {
+            (void)bitsPerChannel;
+
+            if (file == nullptr || callbackState == nullptr)
+            {
+                throw ::std::runtime_error("A required pointer was null.");
+            }
+
+            const DibStripWriter* instance = static_cast<const DibStripWriter*>(callbackState);
+            const DibLayout& layout = *instance->layout;
+            const int32 stripHeight = instance->stripHeight;
+
+            const size_t outputStride = static_cast<size_t>(imageWidth) * static_cast<size_t>(numberOfChannels);
+
+            PooledBuffer stripBuffer = AcquirePooledBuffer(outputStride * static_cast<size_t>(stripHeight));
+            uint8* const stripScan0 = static_cast<uint8*>(stripBuffer.data());
+
+            for (int32 y = 0; y < imageHeight; y += stripHeight)
+            {
+                const int32 rowCount = ::std::min(stripHeight, imageHeight - y);
+
+                for (int32 i = 0; i < rowCount; i++)
+                {
+                    const int32 row = y + i;
+                    // Bottom-up bitmaps store the last image row first.
+                    const int32 sourceRow = layout.topDown ? row : imageHeight - 1 - row;
+
+                    const uint8* source = layout.pixels + (static_cast<uint64>(sourceRow) * layout.stride);
+                    uint8* destination = stripScan0 + (static_cast<size_t>(i) * outputStride);
+
+                    ConvertDibRow(source, destination, layout);
+                }
+
+                WriteFile(file, stripScan0, static_cast<size_t>(rowCount) * outputStride);
+            }
+        }
+    };
+}
+
+bool TryConvertDibToGmicInputFormat(
+    const void* dib,
+    size_t dibLength,
+    ::std::unique_ptr<InputLayerInfo>& output)
+{
+    if (dib == nullptr)
+    {
+        return false;
+    }
+
+    DibLayout layout{};
+
+    if (!TryGetDibLayout(static_cast<const uint8*>(dib), dibLength, layout))
+    {
+        return false;
+    }
+
+    const TileGeometry stripGeometry = PlanBufferStripGeometry(
+        layout.width,
+        layout.height,
+        layout.numberOfChannels,
+        __FUNCTION__);
+
+    DibStripWriter writer{ &layout, stripGeometry.height };
+
+    const boost::filesystem::path path = GetTemporaryFileName(GetInputDirectory(), ".g8i");
+
+    WritePixelsFromCallback(
+        layout.width,
+        layout.height,
+        layout.numberOfChannels,
+        8,
+        /* planar */ false,
+        stripGeometry.width,
+        stripGeometry.height,
+        &DibStripWriter::WriteCallback,
+        &writer,
+        path);
+
+    output.reset(new InputLayerInfo(
+        path,
+        layout.width,
+        layout.height,
+        true,
+        "2nd Layer"));
+
+    return true;
+}
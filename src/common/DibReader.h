@@ -0,0 +1,29 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef DIBREADER_H
+#define DIBREADER_H
+
+#include "Common.h"
+#include "InputLayerInfo.h"
+#include <memory>
+
+// Converts a packed device-independent bitmap (a BITMAPINFOHEADER or later header
+// followed by the pixel data) to a Gmic8bfImage, reading the pixels in place.
+// Only uncompressed 24-bit and 32-bit images are supported, returns false if the
+// bitmap uses a format that must be handled by the platform decoder.
+bool TryConvertDibToGmicInputFormat(
+    const void* dib,
+    size_t dibLength,
+    ::std::unique_ptr<InputLayerInfo>& output);
+
+#endif // !DIBREADER_H
@@ -11,10 +11,12 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "ExrWriter.h"
+#include "BufferPool.h"
 #include "FileIO.h"
 #include "Gmic8bfImageHeader.h"
-#include "ScopedBufferSuite.h"
 #include "Utilities.h"
+#include <algorithm>
+#include <thread>
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -25,6 +27,7 @@
 #include <OpenEXR/ImfFrameBuffer.h>
 #include <OpenEXR/ImfHeader.h>
 #include "OpenEXR/ImfOutputFile.h"
+#include <OpenEXR/ImfThreading.h>
 
 using namespace OPENEXR_IMF_INTERNAL_NAMESPACE;
 
@@ -72,9 +75,37 @@ namespace
         std::unique_ptr<FileHandle> file;
     };
 
+    // Sets the size of the OpenEXR global thread pool for the lifetime of this object.
+    // The pool threads are stopped when the conversion is complete, this prevents them from
+    // outliving the plug-in module.
+    class ScopedExrThreadCount
+    {
+    public:
+
+        ScopedExrThreadCount(int threadCount)
+            : previousThreadCount(globalThreadCount())
+        {
+            setGlobalThreadCount(threadCount);
+        }
+
+        ~ScopedExrThreadCount()
+        {
+            setGlobalThreadCount(previousThreadCount);
+        }
+
+        ScopedExrThreadCount(const ScopedExrThreadCount&) = delete;
+        ScopedExrThreadCount& operator=(const ScopedExrThreadCount&) = delete;
+
+    private:
+
+        const int previousThreadCount;
+    };
+
+    // Writes the EXR file from the memory-mapped Gmic8bfImage when inputMapping is not null,
+    // otherwise the image is read from inputFile one row at a time.
     void WriteOpenExrFile(
-        const FilterRecordPtr filterRecord,
         FileHandle* inputFile,
+        const FileMapping* inputMapping,
         const Gmic8bfImageHeader& inputFileHeader,
         const boost::filesystem::path& outputFilePath)
     {
@@ -98,7 +129,31 @@ namespace
             throw std::bad_alloc();
         }
 
-        ScopedBufferSuiteBuffer scopedBuffer(filterRecord, inputRowBytes);
+        PooledBuffer pooledBuffer;
+        char* frameBufferScan0;
+        size_t frameBufferStride;
+
+        if (inputMapping != nullptr)
+        {
+            const uint64 imageDataSize = static_cast<uint64>(inputRowBytes) * static_cast<uint64>(height);
+
+            if (inputMapping->GetSize() < sizeof(Gmic8bfImageHeader) + imageDataSize)
+            {
+                throw std::runtime_error("The Gmic8bfImage file is smaller than the image size.");
+            }
+
+            // OpenEXR only reads from the frame buffer when writing a file, so the frame buffer
+            // can point directly at the read-only image data.
+            frameBufferScan0 = const_cast<char*>(static_cast<const char*>(inputMapping->GetData())) + sizeof(Gmic8bfImageHeader);
+            frameBufferStride = static_cast<size_t>(inputRowBytes);
+        }
+        else
+        {
+            pooledBuffer = AcquirePooledBuffer(static_cast<size_t>(inputRowBytes));
+            frameBufferScan0 = static_cast<char*>(pooledBuffer.data());
+            // Each row is loaded at the start of the buffer before it is written.
+            frameBufferStride = 0;
+        }
 
         Imf::Header header(width, height);
 
@@ -126,33 +181,36 @@ namespace
             throw std::runtime_error("Unsupported Gmic8bfImage channel count.");
         }
 
+        // The line blocks are only compressed in parallel when the whole image is written with a single call.
+        const int threadCount = inputMapping != nullptr ? static_cast<int>(::std::max(1U, ::std::thread::hardware_concurrency())) : 0;
+
+        ScopedExrThreadCount scopedThreadCount(threadCount);
+
         OpenExrOutputStream outputStream(outputFilePath);
 
-        Imf::OutputFile file(outputStream, header);
+        Imf::OutputFile file(outputStream, header, threadCount);
 
         Imf::FrameBuffer frameBuffer;
 
-        char* frameBufferScan0 = static_cast<char*>(scopedBuffer.lock());
-
         switch (numberOfChannels)
         {
         case 1:
-            frameBuffer.insert("Y", Slice(PixelType::FLOAT, frameBufferScan0, sizeof(float)));
+            frameBuffer.insert("Y", Slice(PixelType::FLOAT, frameBufferScan0, sizeof(float), frameBufferStride));
             break;
         case 2:
-            frameBuffer.insert("Y", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 0, sizeof(float) * 2));
-            frameBuffer.insert("A", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 1, sizeof(float) * 2));
+            frameBuffer.insert("Y", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 0, sizeof(float) * 2, frameBufferStride));
+            frameBuffer.insert("A", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 1, sizeof(float) * 2, frameBufferStride));
             break;
         case 3:
-            frameBuffer.insert("R", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 0, sizeof(float) * 3));
-            frameBuffer.insert("G", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 1, sizeof(float) * 3));
-            frameBuffer.insert("B", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 2, sizeof(float) * 3));
+            frameBuffer.insert("R", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 0, sizeof(float) * 3, frameBufferStride));
+            frameBuffer.insert("G", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 1, sizeof(float) * 3, frameBufferStride));
+            frameBuffer.insert("B", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 2, sizeof(float) * 3, frameBufferStride));
             break;
         case 4:
-            frameBuffer.insert("R", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 0, sizeof(float) * 4));
-            frameBuffer.insert("G", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 1, sizeof(float) * 4));
-            frameBuffer.insert("B", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 2, sizeof(float) * 4));
-            frameBuffer.insert("A", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 3, sizeof(float) * 4));
+            frameBuffer.insert("R", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 0, sizeof(float) * 4, frameBufferStride));
+            frameBuffer.insert("G", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 1, sizeof(float) * 4, frameBufferStride));
+            frameBuffer.insert("B", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 2, sizeof(float) * 4, frameBufferStride));
+            frameBuffer.insert("A", Slice(PixelType::FLOAT, frameBufferScan0 + sizeof(float) * 3, sizeof(float) * 4, frameBufferStride));
             break;
         default:
             throw std::runtime_error("Unsupported Gmic8bfImage channel count.");
@@ -160,24 +218,42 @@ namespace
 
         file.setFrameBuffer(frameBuffer);
 
-        for (int32 y = 0; y < height; y++)
+        // Because the Gmic8bfImage is using the same interleaved float32 format as the OpeEXR frame buffer, we can write the
+        // image data directly to the output EXR file.
+        if (inputMapping != nullptr)
+        {
+            file.writePixels(height);
+        }
+        else
         {
-            // Because the Gmic8bfImage is using the same interleaved float32 format as the OpeEXR frame buffer, we can write the
-            // image data directly to the output EXR file.
-            ReadFile(inputFile, frameBufferScan0, inputRowBytes);
+            for (int32 y = 0; y < height; y++)
+            {
+                ReadFile(inputFile, frameBufferScan0, inputRowBytes);
 
-            file.writePixels();
+                file.writePixels();
+            }
         }
     }
 }
 
 void ConvertGmic8bfImageToExr(
-    const FilterRecordPtr filterRecord,
     const boost::filesystem::path& inputFilePath,
     const boost::filesystem::path& outputFilePath)
 {
     std::unique_ptr<FileHandle> inputFile = OpenFile(inputFilePath, FileOpenMode::Read);
     Gmic8bfImageHeader inputFileHeader(inputFile.get());
 
-    WriteOpenExrFile(filterRecord, inputFile.get(), inputFileHeader, outputFilePath);
+    std::unique_ptr<FileMapping> inputMapping;
+
+    try
+    {
+        inputMapping = MapFileForReading(inputFilePath);
+    }
+    catch (const std::exception&)
+    {
+        // The image is read in rows if it cannot be mapped into the process address space.
+        inputMapping.reset();
+    }
+
+    WriteOpenExrFile(inputFile.get(), inputMapping.get(), inputFileHeader, outputFilePath);
 }
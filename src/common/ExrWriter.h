@@ -17,7 +17,6 @@
 #include <boost/filesystem.hpp>
 
 void ConvertGmic8bfImageToExr(
-    const FilterRecordPtr filterRecord,
     const boost::filesystem::path& inputFilePath,
     const boost::filesystem::path& outputFilePath);
 
@@ -43,3 +43,8 @@ void WriteFile(FileHandle* fileHandle, const void* data, size_t dataSize)
 {
     WriteFileNative(fileHandle, data, dataSize);
 }
+
+::std::unique_ptr<FileMapping> MapFileForReading(const boost::filesystem::path& path)
+{
+    return MapFileForReadingNative(path);
+}
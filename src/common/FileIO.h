@@ -44,6 +44,32 @@ protected:
     FileHandle operator=(FileHandle&&) = delete;
 };
 
+// A read-only view of an entire file that is mapped into the process address space.
+class FileMapping
+{
+public:
+
+    virtual ~FileMapping() noexcept(false)
+    {
+    }
+
+    virtual const void* GetData() const noexcept = 0;
+
+    virtual uint64 GetSize() const noexcept = 0;
+
+protected:
+
+    FileMapping()
+    {
+    }
+
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    FileMapping(FileMapping&&) = delete;
+    FileMapping operator=(FileMapping&&) = delete;
+};
+
 ::std::unique_ptr<FileHandle> OpenFile(const boost::filesystem::path& path, FileOpenMode mode, int64 preallocationSize = 0);
 
 void ReadFile(FileHandle* fileHandle, void* data, size_t dataSize);
@@ -54,4 +80,8 @@ void SetFilePosition(FileHandle* fileHandle, int64 posOffset);
 
 void WriteFile(FileHandle* fileHandle, const void* data, size_t dataSize);
 
+// Maps the file into memory for reading, this can fail for large files when the process
+// does not have enough contiguous address space.
+::std::unique_ptr<FileMapping> MapFileForReading(const boost::filesystem::path& path);
+
 #endif // !FILEIO_H
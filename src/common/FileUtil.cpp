@@ -99,6 +99,26 @@ boost::filesystem::path GetOutputDirectory()
     return path;
 }
 
+boost::filesystem::path GetBackgroundSaveDirectory()
+{
+    boost::filesystem::path path = GetPluginCacheDirectoryNative();
+    path /= "PendingSaves";
+
+    boost::filesystem::create_directories(path);
+
+    return path;
+}
+
+boost::filesystem::path GetBackgroundSaveErrorDirectory()
+{
+    boost::filesystem::path path = GetPluginCacheDirectoryNative();
+    path /= "FailedSaves";
+
+    boost::filesystem::create_directories(path);
+
+    return path;
+}
+
 boost::filesystem::path GetIOSettingsPath()
 {
     boost::filesystem::path path = GetSettingsDirectory();
@@ -108,6 +128,15 @@ boost::filesystem::path GetIOSettingsPath()
     return path;
 }
 
+boost::filesystem::path GetImageCacheDirectory()
+{
+    boost::filesystem::path path = GetPluginCacheDirectoryNative();
+
+    boost::filesystem::create_directories(path);
+
+    return path;
+}
+
 boost::filesystem::path GetTemporaryFileName(const boost::filesystem::path& dir, const char* const fileExtension)
 {
     boost::filesystem::path path;
@@ -22,8 +22,17 @@ boost::filesystem::path GetInputDirectory();
 
 boost::filesystem::path GetOutputDirectory();
 
+// Gets the directory that holds the output images which are waiting to be saved by the background writer.
+// Unlike the session directory it is not removed when the host exits, so the next session can resume the saves.
+boost::filesystem::path GetBackgroundSaveDirectory();
+
+// Gets the directory that holds the error log of the background saves.
+boost::filesystem::path GetBackgroundSaveErrorDirectory();
+
 boost::filesystem::path GetIOSettingsPath();
 
+boost::filesystem::path GetImageCacheDirectory();
+
 boost::filesystem::path GetTemporaryFileName(const boost::filesystem::path& dir, const char* const fileExtension);
 
 #endif // !FILEUTIL_H
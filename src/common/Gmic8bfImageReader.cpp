@@ -12,14 +12,27 @@
 
 #include "Gmic8bfImageReader.h"
 #include "Gmic8bfImageHeader.h"
+#include "Gmic8bfImageTileTable.h"
 #include "FileIO.h"
 #include "Alpha.h"
+#include "BufferPool.h"
+#include "HostWindow.h"
 #include "ImageUtil.h"
-#include "ScopedBufferSuite.h"
+#include "MaskOccupancyMap.h"
+#include "ParallelFor.h"
+#include "TilePlanner.h"
+#include "TilePrefetcher.h"
 #include "Utilities.h"
 #include <algorithm>
 #include <new>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GMIC8BFIMAGEREADER_USE_SSE2 1
+#else
+#define GMIC8BFIMAGEREADER_USE_SSE2 0
+#endif
+
 namespace
 {
     void CopyTileDataToHostEightBitsPerChannel(
@@ -29,6 +42,7 @@ namespace
         int32 tileHeight,
         uint8* outData,
         int32 outRowBytes,
+        int32 outColumnStep,
         const uint8* maskData,
         int32 maskRowBytes)
     {
@@ -47,7 +61,7 @@ namespace
                 }
 
                 srcPixel++;
-                dstPixel++;
+                dstPixel += outColumnStep;
                 if (mask != nullptr)
                 {
                     mask++;
@@ -63,6 +77,7 @@ namespace
         int32 tileHeight,
         uint8* outData,
         int32 outRowBytes,
+        int32 outColumnStep,
         const uint8* maskData,
         int32 maskRowBytes)
     {
@@ -83,7 +98,7 @@ namespace
                 }
 
                 srcPixel++;
-                dstPixel++;
+                dstPixel += outColumnStep;
                 if (mask != nullptr)
                 {
                     mask++;
@@ -99,6 +114,7 @@ namespace
         int32 tileHeight,
         uint8* outData,
         int32 outRowBytes,
+        int32 outColumnStep,
         const uint8* maskData,
         int32 maskRowBytes)
     {
@@ -117,7 +133,7 @@ namespace
                 }
 
                 srcPixel++;
-                dstPixel++;
+                dstPixel += outColumnStep;
                 if (mask != nullptr)
                 {
                     mask++;
@@ -126,314 +142,1183 @@ namespace
         }
     }
 
-    void CopyImageToActiveLayerCore(FilterRecordPtr filterRecord, FileHandle* fileHandle, const int32& hostBitDepth)
+    // Sets the planes that are requested from the host, multiple planes are interleaved.
+    void SetOutputPlaneRange(
+        FilterRecordPtr filterRecord,
+        int16 loPlane,
+        int16 hiPlane,
+        int32 hostBytesPerChannel)
     {
-        Gmic8bfImageHeader header(fileHandle);
+        filterRecord->outLoPlane = loPlane;
+        filterRecord->outHiPlane = hiPlane;
+        filterRecord->outPlaneBytes = hostBytesPerChannel;
+        filterRecord->outColumnBytes = hostBytesPerChannel * (hiPlane - loPlane + 1);
+    }
 
-        const int32 width = header.GetWidth();
-        const int32 height = header.GetHeight();
-        const int32 numberOfChannels = header.GetNumberOfChannels();
-        const int32 bitsPerChannel = header.GetBitsPerChannel();
-        const bool hasAlphaChannel = header.HasAlphaChannel();
-        const bool canEditLayerTransparency = filterRecord->outLayerPlanes != 0 && filterRecord->outTransparencyMask != 0;
-        const int32 numberOfOutputPlanes = GetImagePlaneCount(
-            filterRecord->imageMode,
-            filterRecord->outLayerPlanes,
-            hasAlphaChannel ? filterRecord->outTransparencyMask : 0);
+    // The BroadcastGrayTileDataToHost functions write a gray plane to all three
+    // channels of an interleaved RGB output buffer. The unmasked RGB and RGBA rows
+    // use SSE2 when it is available, the fourth channel of an RGBA pixel is preserved.
+
+#if GMIC8BFIMAGEREADER_USE_SSE2
+    // Writes four vectors that hold 12 bytes of output data each as 48 contiguous bytes.
+    void StoreTwelveByteGroups(uint8* destination, __m128i first, __m128i second, __m128i third, __m128i fourth)
+    {
+        const __m128i validBytes = _mm_setr_epi32(-1, -1, -1, 0);
 
-        const VPoint imageSize = GetImageSize(filterRecord);
+        first = _mm_and_si128(first, validBytes);
+        second = _mm_and_si128(second, validBytes);
+        third = _mm_and_si128(third, validBytes);
+        fourth = _mm_and_si128(fourth, validBytes);
 
-        // This method will only be called with planar images that match the input document size.
-        assert(width == imageSize.h);
-        assert(height == imageSize.v);
-        assert(header.IsPlanar());
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), _mm_or_si128(first, _mm_slli_si128(second, 12)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 16), _mm_or_si128(_mm_srli_si128(second, 4), _mm_slli_si128(third, 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 32), _mm_or_si128(_mm_srli_si128(third, 8), _mm_slli_si128(fourth, 4)));
+    }
 
-        if (bitsPerChannel != hostBitDepth)
+    // Replaces the bits of the existing output data that are set in the mask.
+    __m128i BlendBits(__m128i values, __m128i existing, __m128i valueMask)
+    {
+        return _mm_or_si128(_mm_and_si128(valueMask, values), _mm_andnot_si128(valueMask, existing));
+    }
+
+    // Returns the number of pixels that were written, the caller writes the remaining pixels.
+    int32 BroadcastGrayRowEightBitsPerChannelSse2(const uint8* srcPixel, uint8* dstPixel, int32 width, int32 outColumnStep)
+    {
+        int32 x = 0;
+
+        if (outColumnStep == 3)
         {
-            char formatBuffer[256]{};
+            // Each 32-bit lane of the expanded values holds four copies of a gray value, shifting
+            // the 64-bit halves by one byte leaves two RGB pixels in their first six bytes.
+            const __m128i firstPixelPair = _mm_setr_epi32(-1, 0x0000FFFF, 0, 0);
+            const __m128i secondPixelPair = _mm_setr_epi32(0, 0, -1, 0x0000FFFF);
 
-            const int result = snprintf(
-                formatBuffer,
-                sizeof(formatBuffer),
-                "The G'MIC image bit depth (%d) does not math the host bit depth (%d).",
-                bitsPerChannel,
-                hostBitDepth);
+            const auto packPixels = [&](__m128i expanded)
+            {
+                const __m128i shifted = _mm_srli_epi64(expanded, 8);
+
+                return _mm_or_si128(
+                    _mm_and_si128(shifted, firstPixelPair),
+                    _mm_srli_si128(_mm_and_si128(shifted, secondPixelPair), 2));
+            };
 
-            if (result > 0)
+            for (; (x + 16) <= width; x += 16)
             {
-                throw std::runtime_error(formatBuffer);
+                const __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcPixel + x));
+                const __m128i lowPairs = _mm_unpacklo_epi8(gray, gray);
+                const __m128i highPairs = _mm_unpackhi_epi8(gray, gray);
+
+                StoreTwelveByteGroups(
+                    dstPixel + (static_cast<size_t>(x) * 3),
+                    packPixels(_mm_unpacklo_epi16(lowPairs, lowPairs)),
+                    packPixels(_mm_unpackhi_epi16(lowPairs, lowPairs)),
+                    packPixels(_mm_unpacklo_epi16(highPairs, highPairs)),
+                    packPixels(_mm_unpackhi_epi16(highPairs, highPairs)));
             }
-            else
+        }
+        else if (outColumnStep == 4)
+        {
+            const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+
+            for (; (x + 16) <= width; x += 16)
             {
-                throw std::runtime_error("The G'MIC image bit depth does not math the host bit depth.");
+                const __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcPixel + x));
+                const __m128i lowPairs = _mm_unpacklo_epi8(gray, gray);
+                const __m128i highPairs = _mm_unpackhi_epi8(gray, gray);
+
+                __m128i* dst = reinterpret_cast<__m128i*>(dstPixel + (static_cast<size_t>(x) * 4));
+
+                _mm_storeu_si128(dst, BlendBits(_mm_unpacklo_epi16(lowPairs, lowPairs), _mm_loadu_si128(dst), colorMask));
+                _mm_storeu_si128(dst + 1, BlendBits(_mm_unpackhi_epi16(lowPairs, lowPairs), _mm_loadu_si128(dst + 1), colorMask));
+                _mm_storeu_si128(dst + 2, BlendBits(_mm_unpacklo_epi16(highPairs, highPairs), _mm_loadu_si128(dst + 2), colorMask));
+                _mm_storeu_si128(dst + 3, BlendBits(_mm_unpackhi_epi16(highPairs, highPairs), _mm_loadu_si128(dst + 3), colorMask));
             }
         }
 
-        if (!hasAlphaChannel && canEditLayerTransparency)
+        return x;
+    }
+
+    int32 BroadcastGrayRowSixteenBitsPerChannelSse2(const uint16* srcPixel, uint16* dstPixel, int32 width, int32 outColumnStep)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        int32 x = 0;
+
+        if (outColumnStep == 3)
+        {
+            for (; (x + 8) <= width; x += 8)
+            {
+                // The average with zero converts the values to the host range, see ToHostSixteenBitValue.
+                const __m128i gray = _mm_avg_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(srcPixel + x)), zero);
+                const __m128i lowPairs = _mm_unpacklo_epi16(gray, gray);
+                const __m128i highPairs = _mm_unpackhi_epi16(gray, gray);
+
+                // Each 64-bit half of the expanded values holds four copies of a gray value,
+                // shifting the vector by one value leaves two RGB pixels in its first six values.
+                StoreTwelveByteGroups(
+                    reinterpret_cast<uint8*>(dstPixel + (static_cast<size_t>(x) * 3)),
+                    _mm_srli_si128(_mm_unpacklo_epi32(lowPairs, lowPairs), 2),
+                    _mm_srli_si128(_mm_unpackhi_epi32(lowPairs, lowPairs), 2),
+                    _mm_srli_si128(_mm_unpacklo_epi32(highPairs, highPairs), 2),
+                    _mm_srli_si128(_mm_unpackhi_epi32(highPairs, highPairs), 2));
+            }
+        }
+        else if (outColumnStep == 4)
         {
-            SetAlphaChannelToOpaque(filterRecord, imageSize, bitsPerChannel);
+            const __m128i colorMask = _mm_setr_epi32(-1, 0x0000FFFF, -1, 0x0000FFFF);
+
+            for (; (x + 8) <= width; x += 8)
+            {
+                const __m128i gray = _mm_avg_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(srcPixel + x)), zero);
+                const __m128i lowPairs = _mm_unpacklo_epi16(gray, gray);
+                const __m128i highPairs = _mm_unpackhi_epi16(gray, gray);
+
+                __m128i* dst = reinterpret_cast<__m128i*>(dstPixel + (static_cast<size_t>(x) * 4));
+
+                _mm_storeu_si128(dst, BlendBits(_mm_unpacklo_epi32(lowPairs, lowPairs), _mm_loadu_si128(dst), colorMask));
+                _mm_storeu_si128(dst + 1, BlendBits(_mm_unpackhi_epi32(lowPairs, lowPairs), _mm_loadu_si128(dst + 1), colorMask));
+                _mm_storeu_si128(dst + 2, BlendBits(_mm_unpacklo_epi32(highPairs, highPairs), _mm_loadu_si128(dst + 2), colorMask));
+                _mm_storeu_si128(dst + 3, BlendBits(_mm_unpackhi_epi32(highPairs, highPairs), _mm_loadu_si128(dst + 3), colorMask));
+            }
         }
 
-        const bool premultiplyAlpha = hasAlphaChannel && !canEditLayerTransparency;
+        return x;
+    }
 
-        const int32 tileWidth = header.GetTileWidth();
-        const int32 tileHeight = header.GetTileHeight();
+    int32 BroadcastGrayRowThirtyTwoBitsPerChannelSse2(const float* srcPixel, float* dstPixel, int32 width, int32 outColumnStep)
+    {
+        int32 x = 0;
 
-        int32 tileMaxRowBytes = 0;
+        if (outColumnStep == 3)
+        {
+            for (; (x + 4) <= width; x += 4)
+            {
+                const __m128 gray = _mm_loadu_ps(srcPixel + x);
+                float* dst = dstPixel + (static_cast<size_t>(x) * 3);
 
-        if (!TryMultiplyInt32(tileWidth, bitsPerChannel / 8, tileMaxRowBytes))
+                _mm_storeu_ps(dst, _mm_shuffle_ps(gray, gray, _MM_SHUFFLE(1, 0, 0, 0)));
+                _mm_storeu_ps(dst + 4, _mm_shuffle_ps(gray, gray, _MM_SHUFFLE(2, 2, 1, 1)));
+                _mm_storeu_ps(dst + 8, _mm_shuffle_ps(gray, gray, _MM_SHUFFLE(3, 3, 3, 2)));
+            }
+        }
+        else if (outColumnStep == 4)
         {
-            // The multiplication would have resulted in an integer overflow / underflow.
-            throw ::std::bad_alloc();
+            const __m128i colorMask = _mm_setr_epi32(-1, -1, -1, 0);
+
+            const auto storePixel = [&](float* dst, __m128 values)
+            {
+                const __m128i blended = BlendBits(
+                    _mm_castps_si128(values),
+                    _mm_castps_si128(_mm_loadu_ps(dst)),
+                    colorMask);
+
+                _mm_storeu_ps(dst, _mm_castsi128_ps(blended));
+            };
+
+            for (; (x + 4) <= width; x += 4)
+            {
+                const __m128 gray = _mm_loadu_ps(srcPixel + x);
+                float* dst = dstPixel + (static_cast<size_t>(x) * 4);
+
+                storePixel(dst, _mm_shuffle_ps(gray, gray, _MM_SHUFFLE(0, 0, 0, 0)));
+                storePixel(dst + 4, _mm_shuffle_ps(gray, gray, _MM_SHUFFLE(1, 1, 1, 1)));
+                storePixel(dst + 8, _mm_shuffle_ps(gray, gray, _MM_SHUFFLE(2, 2, 2, 2)));
+                storePixel(dst + 12, _mm_shuffle_ps(gray, gray, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
         }
 
-        int32 tileBufferSize = 0;
+        return x;
+    }
+#endif // GMIC8BFIMAGEREADER_USE_SSE2
 
-        if (!TryMultiplyInt32(tileMaxRowBytes, tileHeight, tileBufferSize))
+    // Converts a 16-bit value to the host range of [0, 32768], this gives the same
+    // result as the BuildSixteenBitToHostLUT table.
+    uint16 ToHostSixteenBitValue(uint32 value)
+    {
+        return static_cast<uint16>((value + 1) >> 1);
+    }
+
+    void BroadcastGrayTileDataToHostEightBitsPerChannel(
+        const uint8* const tileBuffer,
+        int32 tileBufferRowBytes,
+        int32 tileWidth,
+        int32 tileHeight,
+        uint8* outData,
+        int32 outRowBytes,
+        int32 outColumnStep,
+        const uint8* maskData,
+        int32 maskRowBytes)
+    {
+        for (int32 y = 0; y < tileHeight; y++)
         {
-            // The multiplication would have resulted in an integer overflow / underflow.
-            throw ::std::bad_alloc();
+            const uint8* srcPixel = tileBuffer + (static_cast<int64>(y) * tileBufferRowBytes);
+            uint8* dstRow = outData + (static_cast<int64>(y) * outRowBytes);
+            const uint8* mask = maskData != nullptr ? maskData + (static_cast<int64>(y) * maskRowBytes) : nullptr;
+
+            int32 x = 0;
+
+#if GMIC8BFIMAGEREADER_USE_SSE2
+            if (mask == nullptr)
+            {
+                x = BroadcastGrayRowEightBitsPerChannelSse2(srcPixel, dstRow, tileWidth, outColumnStep);
+            }
+#endif // GMIC8BFIMAGEREADER_USE_SSE2
+
+            for (; x < tileWidth; x++)
+            {
+                // Clip the output to the mask, if one is present.
+                if (mask == nullptr || mask[x] != 0)
+                {
+                    const uint8 value = srcPixel[x];
+                    uint8* dstPixel = dstRow + (static_cast<size_t>(x) * outColumnStep);
+
+                    dstPixel[0] = value;
+                    dstPixel[1] = value;
+                    dstPixel[2] = value;
+                }
+            }
         }
+    }
+
+    void BroadcastGrayTileDataToHostSixteenBitsPerChannel(
+        const uint8* const tileBuffer,
+        int32 tileBufferRowBytes,
+        int32 tileWidth,
+        int32 tileHeight,
+        uint8* outData,
+        int32 outRowBytes,
+        int32 outColumnStep,
+        const uint8* maskData,
+        int32 maskRowBytes)
+    {
+        for (int32 y = 0; y < tileHeight; y++)
+        {
+            const uint16* srcPixel = reinterpret_cast<const uint16*>(tileBuffer + (static_cast<int64>(y) * tileBufferRowBytes));
+            uint16* dstRow = reinterpret_cast<uint16*>(outData + (static_cast<int64>(y) * outRowBytes));
+            const uint8* mask = maskData != nullptr ? maskData + (static_cast<int64>(y) * maskRowBytes) : nullptr;
+
+            int32 x = 0;
 
-        ScopedBufferSuiteBuffer scopedBuffer(filterRecord, tileBufferSize);
+#if GMIC8BFIMAGEREADER_USE_SSE2
+            if (mask == nullptr)
+            {
+                x = BroadcastGrayRowSixteenBitsPerChannelSse2(srcPixel, dstRow, tileWidth, outColumnStep);
+            }
+#endif // GMIC8BFIMAGEREADER_USE_SSE2
 
-        uint8* tileBuffer = reinterpret_cast<uint8*>(scopedBuffer.lock());
+            for (; x < tileWidth; x++)
+            {
+                // Clip the output to the mask, if one is present.
+                if (mask == nullptr || mask[x] != 0)
+                {
+                    const uint16 value = ToHostSixteenBitValue(srcPixel[x]);
+                    uint16* dstPixel = dstRow + (static_cast<size_t>(x) * outColumnStep);
 
-        if (filterRecord->haveMask)
+                    dstPixel[0] = value;
+                    dstPixel[1] = value;
+                    dstPixel[2] = value;
+                }
+            }
+        }
+    }
+
+    void BroadcastGrayTileDataToHostThirtyTwoBitsPerChannel(
+        const uint8* const tileBuffer,
+        int32 tileBufferRowBytes,
+        int32 tileWidth,
+        int32 tileHeight,
+        uint8* outData,
+        int32 outRowBytes,
+        int32 outColumnStep,
+        const uint8* maskData,
+        int32 maskRowBytes)
+    {
+        for (int32 y = 0; y < tileHeight; y++)
+        {
+            const float* srcPixel = reinterpret_cast<const float*>(tileBuffer + (static_cast<int64>(y) * tileBufferRowBytes));
+            float* dstRow = reinterpret_cast<float*>(outData + (static_cast<int64>(y) * outRowBytes));
+            const uint8* mask = maskData != nullptr ? maskData + (static_cast<int64>(y) * maskRowBytes) : nullptr;
+
+            int32 x = 0;
+
+#if GMIC8BFIMAGEREADER_USE_SSE2
+            if (mask == nullptr)
+            {
+                x = BroadcastGrayRowThirtyTwoBitsPerChannelSse2(srcPixel, dstRow, tileWidth, outColumnStep);
+            }
+#endif // GMIC8BFIMAGEREADER_USE_SSE2
+
+            for (; x < tileWidth; x++)
+            {
+                // Clip the output to the mask, if one is present.
+                if (mask == nullptr || mask[x] != 0)
+                {
+                    const float value = srcPixel[x];
+                    float* dstPixel = dstRow + (static_cast<size_t>(x) * outColumnStep);
+
+                    dstPixel[0] = value;
+                    dstPixel[1] = value;
+                    dstPixel[2] = value;
+                }
+            }
+        }
+    }
+
+    bool IsGrayScaleImageMode(int16 imageMode)
+    {
+        switch (imageMode)
         {
-            filterRecord->maskRate = int2fixed(1);
+        case plugInModeGrayScale:
+        case plugInModeGray16:
+        case plugInModeGray32:
+            return true;
+        default:
+            return false;
         }
+    }
+
+    // The LuminanceTileDataToHost functions convert the red, green and blue planes of a color
+    // image to a gray plane with the Rec. 709 weights, which match the sRGB primaries that
+    // G'MIC-Qt uses. The integer formats use the weights in 16.16 fixed point, the weights
+    // add up to 65536 so the sum of a [0, 65535] value cannot overflow.
+    // The unmasked gray and gray + alpha rows use SSE2 when it is available.
+
+    constexpr uint32 Rec709RedFixedPointWeight = 13933;
+    constexpr uint32 Rec709GreenFixedPointWeight = 46871;
+    constexpr uint32 Rec709BlueFixedPointWeight = 4732;
+
+    constexpr float Rec709RedWeight = 0.2126f;
+    constexpr float Rec709GreenWeight = 0.7152f;
+    constexpr float Rec709BlueWeight = 0.0722f;
+
+    uint32 FixedPointLuminance(uint32 red, uint32 green, uint32 blue)
+    {
+        const uint32 sum = (red * Rec709RedFixedPointWeight) + (green * Rec709GreenFixedPointWeight) + (blue * Rec709BlueFixedPointWeight);
+
+        return (sum + 32768) >> 16;
+    }
+
+    float FloatLuminance(float red, float green, float blue)
+    {
+        return (red * Rec709RedWeight) + (green * Rec709GreenWeight) + (blue * Rec709BlueWeight);
+    }
+
+#if GMIC8BFIMAGEREADER_USE_SSE2
+    // Computes FixedPointLuminance for eight 16-bit values, the results are returned as 32-bit values.
+    void FixedPointLuminanceSse2(__m128i red, __m128i green, __m128i blue, __m128i& low, __m128i& high)
+    {
+        const __m128i redWeight = _mm_set1_epi16(static_cast<short>(Rec709RedFixedPointWeight));
+        const __m128i greenWeight = _mm_set1_epi16(static_cast<short>(Rec709GreenFixedPointWeight));
+        const __m128i blueWeight = _mm_set1_epi16(static_cast<short>(Rec709BlueFixedPointWeight));
+        const __m128i rounding = _mm_set1_epi32(32768);
+
+        // SSE2 does not have a 32-bit multiply, the products are built from the low
+        // and high halves of the unsigned 16-bit products.
+        const __m128i redLow = _mm_mullo_epi16(red, redWeight);
+        const __m128i redHigh = _mm_mulhi_epu16(red, redWeight);
+        const __m128i greenLow = _mm_mullo_epi16(green, greenWeight);
+        const __m128i greenHigh = _mm_mulhi_epu16(green, greenWeight);
+        const __m128i blueLow = _mm_mullo_epi16(blue, blueWeight);
+        const __m128i blueHigh = _mm_mulhi_epu16(blue, blueWeight);
+
+        low = _mm_add_epi32(
+            _mm_add_epi32(_mm_unpacklo_epi16(redLow, redHigh), _mm_unpacklo_epi16(greenLow, greenHigh)),
+            _mm_add_epi32(_mm_unpacklo_epi16(blueLow, blueHigh), rounding));
+        high = _mm_add_epi32(
+            _mm_add_epi32(_mm_unpackhi_epi16(redLow, redHigh), _mm_unpackhi_epi16(greenLow, greenHigh)),
+            _mm_add_epi32(_mm_unpackhi_epi16(blueLow, blueHigh), rounding));
+
+        low = _mm_srli_epi32(low, 16);
+        high = _mm_srli_epi32(high, 16);
+    }
+
+    // Returns the number of pixels that were written, the caller writes the remaining pixels.
+    int32 LuminanceRowEightBitsPerChannelSse2(
+        const uint8* red,
+        const uint8* green,
+        const uint8* blue,
+        uint8* dstPixel,
+        int32 width,
+        int32 outColumnStep)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i grayMask = _mm_set1_epi16(0x00FF);
+        int32 x = 0;
+
+        if (outColumnStep == 1 || outColumnStep == 2)
+        {
+            for (; (x + 8) <= width; x += 8)
+            {
+                __m128i low;
+                __m128i high;
+
+                FixedPointLuminanceSse2(
+                    _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(red + x)), zero),
+                    _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(green + x)), zero),
+                    _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(blue + x)), zero),
+                    low,
+                    high);
+
+                // The values are in the range of [0, 255], so the packs do not saturate.
+                const __m128i grayWords = _mm_packs_epi32(low, high);
+
+                if (outColumnStep == 1)
+                {
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(dstPixel + x), _mm_packus_epi16(grayWords, grayWords));
+                }
+                else
+                {
+                    __m128i* dst = reinterpret_cast<__m128i*>(dstPixel + (static_cast<size_t>(x) * 2));
+
+                    _mm_storeu_si128(dst, BlendBits(grayWords, _mm_loadu_si128(dst), grayMask));
+                }
+            }
+        }
+
+        return x;
+    }
+
+    int32 LuminanceRowSixteenBitsPerChannelSse2(
+        const uint16* red,
+        const uint16* green,
+        const uint16* blue,
+        uint16* dstPixel,
+        int32 width,
+        int32 outColumnStep)
+    {
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i bias = _mm_set1_epi32(32768);
+        const __m128i signBit = _mm_set1_epi16(static_cast<short>(0x8000));
+        const __m128i grayMask = _mm_set1_epi32(0x0000FFFF);
+        int32 x = 0;
+
+        if (outColumnStep == 1 || outColumnStep == 2)
+        {
+            for (; (x + 8) <= width; x += 8)
+            {
+                __m128i low;
+                __m128i high;
+
+                FixedPointLuminanceSse2(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(red + x)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(green + x)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(blue + x)),
+                    low,
+                    high);
+
+                // Convert the values to the host range, see ToHostSixteenBitValue.
+                low = _mm_srli_epi32(_mm_add_epi32(low, one), 1);
+                high = _mm_srli_epi32(_mm_add_epi32(high, one), 1);
+
+                if (outColumnStep == 1)
+                {
+                    // SSE2 only has a signed saturating pack, so the values are biased into the signed range and back.
+                    const __m128i grayWords = _mm_xor_si128(
+                        _mm_packs_epi32(_mm_sub_epi32(low, bias), _mm_sub_epi32(high, bias)),
+                        signBit);
+
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dstPixel + x), grayWords);
+                }
+                else
+                {
+                    __m128i* dst = reinterpret_cast<__m128i*>(dstPixel + (static_cast<size_t>(x) * 2));
+
+                    _mm_storeu_si128(dst, BlendBits(low, _mm_loadu_si128(dst), grayMask));
+                    _mm_storeu_si128(dst + 1, BlendBits(high, _mm_loadu_si128(dst + 1), grayMask));
+                }
+            }
+        }
+
+        return x;
+    }
+
+    int32 LuminanceRowThirtyTwoBitsPerChannelSse2(
+        const float* red,
+        const float* green,
+        const float* blue,
+        float* dstPixel,
+        int32 width,
+        int32 outColumnStep)
+    {
+        const __m128 redWeight = _mm_set1_ps(Rec709RedWeight);
+        const __m128 greenWeight = _mm_set1_ps(Rec709GreenWeight);
+        const __m128 blueWeight = _mm_set1_ps(Rec709BlueWeight);
+        const __m128i grayMask = _mm_setr_epi32(-1, 0, -1, 0);
+        int32 x = 0;
+
+        if (outColumnStep == 1 || outColumnStep == 2)
+        {
+            for (; (x + 4) <= width; x += 4)
+            {
+                const __m128 gray = _mm_add_ps(
+                    _mm_add_ps(
+                        _mm_mul_ps(_mm_loadu_ps(red + x), redWeight),
+                        _mm_mul_ps(_mm_loadu_ps(green + x), greenWeight)),
+                    _mm_mul_ps(_mm_loadu_ps(blue + x), blueWeight));
+
+                if (outColumnStep == 1)
+                {
+                    _mm_storeu_ps(dstPixel + x, gray);
+                }
+                else
+                {
+                    float* dst = dstPixel + (static_cast<size_t>(x) * 2);
+
+                    const __m128i low = BlendBits(
+                        _mm_castps_si128(_mm_unpacklo_ps(gray, gray)),
+                        _mm_castps_si128(_mm_loadu_ps(dst)),
+                        grayMask);
+                    const __m128i high = BlendBits(
+                        _mm_castps_si128(_mm_unpackhi_ps(gray, gray)),
+                        _mm_castps_si128(_mm_loadu_ps(dst + 4)),
+                        grayMask);
+
+                    _mm_storeu_ps(dst, _mm_castsi128_ps(low));
+                    _mm_storeu_ps(dst + 4, _mm_castsi128_ps(high));
+                }
+            }
+        }
+
+        return x;
+    }
+#endif // GMIC8BFIMAGEREADER_USE_SSE2
+
+    void LuminanceTileDataToHostEightBitsPerChannel(
+        const uint8* const redPlane,
+        const uint8* const greenPlane,
+        const uint8* const bluePlane,
+        int32 planeRowBytes,
+        int32 tileWidth,
+        int32 tileHeight,
+        uint8* outData,
+        int32 outRowBytes,
+        int32 outColumnStep,
+        const uint8* maskData,
+        int32 maskRowBytes)
+    {
+        for (int32 y = 0; y < tileHeight; y++)
+        {
+            const int64 planeRowOffset = static_cast<int64>(y) * planeRowBytes;
+
+            const uint8* red = redPlane + planeRowOffset;
+            const uint8* green = greenPlane + planeRowOffset;
+            const uint8* blue = bluePlane + planeRowOffset;
+            uint8* dstRow = outData + (static_cast<int64>(y) * outRowBytes);
+            const uint8* mask = maskData != nullptr ? maskData + (static_cast<int64>(y) * maskRowBytes) : nullptr;
+
+            int32 x = 0;
+
+#if GMIC8BFIMAGEREADER_USE_SSE2
+            if (mask == nullptr)
+            {
+                x = LuminanceRowEightBitsPerChannelSse2(red, green, blue, dstRow, tileWidth, outColumnStep);
+            }
+#endif // GMIC8BFIMAGEREADER_USE_SSE2
+
+            for (; x < tileWidth; x++)
+            {
+                // Clip the output to the mask, if one is present.
+                if (mask == nullptr || mask[x] != 0)
+                {
+                    dstRow[static_cast<size_t>(x) * outColumnStep] = static_cast<uint8>(FixedPointLuminance(red[x], green[x], blue[x]));
+                }
+            }
+        }
+    }
+
+    void LuminanceTileDataToHostSixteenBitsPerChannel(
+        const uint8* const redPlane,
+        const uint8* const greenPlane,
+        const uint8* const bluePlane,
+        int32 planeRowBytes,
+        int32 tileWidth,
+        int32 tileHeight,
+        uint8* outData,
+        int32 outRowBytes,
+        int32 outColumnStep,
+        const uint8* maskData,
+        int32 maskRowBytes)
+    {
+        for (int32 y = 0; y < tileHeight; y++)
+        {
+            const int64 planeRowOffset = static_cast<int64>(y) * planeRowBytes;
+
+            const uint16* red = reinterpret_cast<const uint16*>(redPlane + planeRowOffset);
+            const uint16* green = reinterpret_cast<const uint16*>(greenPlane + planeRowOffset);
+            const uint16* blue = reinterpret_cast<const uint16*>(bluePlane + planeRowOffset);
+            uint16* dstRow = reinterpret_cast<uint16*>(outData + (static_cast<int64>(y) * outRowBytes));
+            const uint8* mask = maskData != nullptr ? maskData + (static_cast<int64>(y) * maskRowBytes) : nullptr;
+
+            int32 x = 0;
+
+#if GMIC8BFIMAGEREADER_USE_SSE2
+            if (mask == nullptr)
+            {
+                x = LuminanceRowSixteenBitsPerChannelSse2(red, green, blue, dstRow, tileWidth, outColumnStep);
+            }
+#endif // GMIC8BFIMAGEREADER_USE_SSE2
+
+            for (; x < tileWidth; x++)
+            {
+                // Clip the output to the mask, if one is present.
+                if (mask == nullptr || mask[x] != 0)
+                {
+                    dstRow[static_cast<size_t>(x) * outColumnStep] = ToHostSixteenBitValue(FixedPointLuminance(red[x], green[x], blue[x]));
+                }
+            }
+        }
+    }
+
+    void LuminanceTileDataToHostThirtyTwoBitsPerChannel(
+        const uint8* const redPlane,
+        const uint8* const greenPlane,
+        const uint8* const bluePlane,
+        int32 planeRowBytes,
+        int32 tileWidth,
+        int32 tileHeight,
+        uint8* outData,
+        int32 outRowBytes,
+        int32 outColumnStep,
+        const uint8* maskData,
+        int32 maskRowBytes)
+    {
+        for (int32 y = 0; y < tileHeight; y++)
+        {
+            const int64 planeRowOffset = static_cast<int64>(y) * planeRowBytes;
+
+            const float* red = reinterpret_cast<const float*>(redPlane + planeRowOffset);
+            const float* green = reinterpret_cast<const float*>(greenPlane + planeRowOffset);
+            const float* blue = reinterpret_cast<const float*>(bluePlane + planeRowOffset);
+            float* dstRow = reinterpret_cast<float*>(outData + (static_cast<int64>(y) * outRowBytes));
+            const uint8* mask = maskData != nullptr ? maskData + (static_cast<int64>(y) * maskRowBytes) : nullptr;
+
+            int32 x = 0;
+
+#if GMIC8BFIMAGEREADER_USE_SSE2
+            if (mask == nullptr)
+            {
+                x = LuminanceRowThirtyTwoBitsPerChannelSse2(red, green, blue, dstRow, tileWidth, outColumnStep);
+            }
+#endif // GMIC8BFIMAGEREADER_USE_SSE2
+
+            for (; x < tileWidth; x++)
+            {
+                // Clip the output to the mask, if one is present.
+                if (mask == nullptr || mask[x] != 0)
+                {
+                    dstRow[static_cast<size_t>(x) * outColumnStep] = FloatLuminance(red[x], green[x], blue[x]);
+                }
+            }
+        }
+    }
+
+    void CopyTileDataToHost(
+        const uint8* const tileBuffer,
+        int32 tileBufferRowBytes,
+        int32 tileWidth,
+        int32 tileHeight,
+        uint8* outData,
+        int32 outRowBytes,
+        int32 outColumnStep,
+        const uint8* maskData,
+        int32 maskRowBytes,
+        int32 hostBitDepth)
+    {
+        switch (hostBitDepth)
+        {
+        case 8:
+            CopyTileDataToHostEightBitsPerChannel(tileBuffer, tileBufferRowBytes, tileWidth, tileHeight, outData, outRowBytes, outColumnStep, maskData, maskRowBytes);
+            break;
+        case 16:
+            CopyTileDataToHostSixteenBitsPerChannel(tileBuffer, tileBufferRowBytes, tileWidth, tileHeight, outData, outRowBytes, outColumnStep, maskData, maskRowBytes);
+            break;
+        case 32:
+            CopyTileDataToHostThirtyTwoBitsPerChannel(tileBuffer, tileBufferRowBytes, tileWidth, tileHeight, outData, outRowBytes, outColumnStep, maskData, maskRowBytes);
+            break;
+        default:
+            throw ::std::runtime_error("Unsupported image depth.");
+        }
+    }
+
+    void BroadcastGrayTileDataToHost(
+        const uint8* const tileBuffer,
+        int32 tileBufferRowBytes,
+        int32 tileWidth,
+        int32 tileHeight,
+        uint8* outData,
+        int32 outRowBytes,
+        int32 outColumnStep,
+        const uint8* maskData,
+        int32 maskRowBytes,
+        int32 hostBitDepth)
+    {
+        switch (hostBitDepth)
+        {
+        case 8:
+            BroadcastGrayTileDataToHostEightBitsPerChannel(tileBuffer, tileBufferRowBytes, tileWidth, tileHeight, outData, outRowBytes, outColumnStep, maskData, maskRowBytes);
+            break;
+        case 16:
+            BroadcastGrayTileDataToHostSixteenBitsPerChannel(tileBuffer, tileBufferRowBytes, tileWidth, tileHeight, outData, outRowBytes, outColumnStep, maskData, maskRowBytes);
+            break;
+        case 32:
+            BroadcastGrayTileDataToHostThirtyTwoBitsPerChannel(tileBuffer, tileBufferRowBytes, tileWidth, tileHeight, outData, outRowBytes, outColumnStep, maskData, maskRowBytes);
+            break;
+        default:
+            throw ::std::runtime_error("Unsupported image depth.");
+        }
+    }
+
+    void LuminanceTileDataToHost(
+        const uint8* const redPlane,
+        const uint8* const greenPlane,
+        const uint8* const bluePlane,
+        int32 planeRowBytes,
+        int32 tileWidth,
+        int32 tileHeight,
+        uint8* outData,
+        int32 outRowBytes,
+        int32 outColumnStep,
+        const uint8* maskData,
+        int32 maskRowBytes,
+        int32 hostBitDepth)
+    {
+        switch (hostBitDepth)
+        {
+        case 8:
+            LuminanceTileDataToHostEightBitsPerChannel(redPlane, greenPlane, bluePlane, planeRowBytes, tileWidth, tileHeight, outData, outRowBytes, outColumnStep, maskData, maskRowBytes);
+            break;
+        case 16:
+            LuminanceTileDataToHostSixteenBitsPerChannel(redPlane, greenPlane, bluePlane, planeRowBytes, tileWidth, tileHeight, outData, outRowBytes, outColumnStep, maskData, maskRowBytes);
+            break;
+        case 32:
+            LuminanceTileDataToHostThirtyTwoBitsPerChannel(redPlane, greenPlane, bluePlane, planeRowBytes, tileWidth, tileHeight, outData, outRowBytes, outColumnStep, maskData, maskRowBytes);
+            break;
+        default:
+            throw ::std::runtime_error("Unsupported image depth.");
+        }
+    }
+
+    // Converts a band of rows in a window tile to the host format, when the bit depth is not
+    // converted hostTile must be the same buffer as fileTile.
+    // Returns a pointer to the first host sample of the band.
+    const uint8* ConvertWindowTileRows(
+        const uint8* fileTile,
+        uint8* hostTile,
+        size_t firstSample,
+        size_t sampleCount,
+        int32 bitsPerChannel,
+        int32 hostBitDepth)
+    {
+        uint8* hostData = hostTile + (firstSample * static_cast<size_t>(hostBitDepth / 8));
+
+        if (bitsPerChannel != hostBitDepth)
+        {
+            ConvertChannelBitDepth(
+                fileTile + (firstSample * static_cast<size_t>(bitsPerChannel / 8)),
+                bitsPerChannel,
+                hostData,
+                hostBitDepth,
+                sampleCount);
+        }
+
+        return hostData;
+    }
+
+    enum class HostPlaneConversion
+    {
+        // The plane is copied to a single host plane.
+        Copy,
+        // A gray plane is copied to the red, green and blue host planes.
+        BroadcastGray,
+        // The red, green and blue planes are converted to a gray host plane.
+        Luminance
+    };
+
+    // The host planes that an image plane is written to.
+    struct HostPlaneRequest
+    {
+        HostPlaneConversion conversion;
+        int16 loPlane;
+        int16 hiPlane;
+        bool setAlphaToOpaque;
+    };
+
+    // An image plane that is copied to one host window.
+    struct HostWindowPass
+    {
+        int32 plane;
+        VRect window;
+        TileMaskOccupancy maskOccupancy;
+        ::std::vector<HostWindowTile> tiles;
+    };
+
+    void CopyImageToActiveLayerCore(
+        FilterRecordPtr filterRecord,
+        FileHandle* fileHandle,
+        const int32& hostBitDepth,
+        const VRect& bounds)
+    {
+        Gmic8bfImageHeader header(fileHandle);
+        const Gmic8bfImageTileTable tileTable(fileHandle, header);
+
+        const int32 width = header.GetWidth();
+        const int32 height = header.GetHeight();
+        const int32 numberOfChannels = header.GetNumberOfChannels();
+        const int32 bitsPerChannel = header.GetBitsPerChannel();
+        const bool hasAlphaChannel = header.HasAlphaChannel();
+        const bool canEditLayerTransparency = filterRecord->outLayerPlanes != 0 && filterRecord->outTransparencyMask != 0;
+        const int32 numberOfOutputPlanes = GetImagePlaneCount(
+            filterRecord->imageMode,
+            filterRecord->outLayerPlanes,
+            hasAlphaChannel ? filterRecord->outTransparencyMask : 0);
+
+        // This method will only be called with planar images that match the size of the area
+        // that was sent to G'MIC-Qt, the image is written back to the same area of the document.
+        assert(width == (bounds.right - bounds.left));
+        assert(height == (bounds.bottom - bounds.top));
+        assert(header.IsPlanar());
+
+        // The G'MIC image is converted to the host bit depth when it was sent to G'MIC-Qt
+        // using a reduced precision format, or when the filter changed the bit depth.
+        const bool convertBitDepth = bitsPerChannel != hostBitDepth;
+
+        const bool premultiplyAlpha = hasAlphaChannel && !canEditLayerTransparency;
+
+        // A color image is converted to gray when it is written to a grayscale document,
+        // the green and blue planes are read together with the red plane.
+        const bool convertColorToGray = numberOfChannels >= 3 && IsGrayScaleImageMode(filterRecord->imageMode);
+        const int32 sourcePlaneCount = convertColorToGray ? 3 : 1;
+
+        // When the image does not have an alpha channel the layer transparency is set to opaque,
+        // the alpha plane is requested with the last color plane to avoid a separate pass.
+        const bool setAlphaToOpaque = !hasAlphaChannel && canEditLayerTransparency;
+        const int16 documentAlphaPlane = IsGrayScaleImageMode(filterRecord->imageMode) ? 1 : 3;
+        const int32 lastColorChannelIndex = convertColorToGray ? 0 : numberOfChannels - 1;
+
+        const int32 tileWidth = header.GetTileWidth();
+        const int32 tileHeight = header.GetTileHeight();
+
+        const int32 fileBytesPerChannel = bitsPerChannel / 8;
+        const int32 hostBytesPerChannel = hostBitDepth / 8;
+
+        // The host is asked for a window that covers several tiles, the tiles in the window
+        // are read from the file and then copied to the host in parallel.
+        // The tiles for the next window are read while the current window is copied, so
+        // there are two file buffers.
+        const TileGeometry windowGeometry = PlanHostWindowGeometry(
+            filterRecord,
+            width,
+            height,
+            tileWidth,
+            tileHeight,
+            hostBytesPerChannel * numberOfOutputPlanes,
+            sourcePlaneCount * ((fileBytesPerChannel * 2) + (convertBitDepth ? hostBytesPerChannel : 0)),
+            __FUNCTION__);
+
+        const size_t windowSlotCount = static_cast<size_t>((windowGeometry.width + tileWidth - 1) / tileWidth) *
+                                       static_cast<size_t>((windowGeometry.height + tileHeight - 1) / tileHeight);
+        const size_t tileSampleCapacity = static_cast<size_t>(tileWidth) * static_cast<size_t>(tileHeight);
+        const size_t windowPlaneSampleCount = windowSlotCount * tileSampleCapacity;
+
+        PooledBuffer fileWindowBuffers[2];
+        PooledBuffer hostWindowBuffer;
+
+        for (PooledBuffer& buffer : fileWindowBuffers)
+        {
+            buffer = AcquirePooledBuffer(windowPlaneSampleCount * static_cast<size_t>(fileBytesPerChannel * sourcePlaneCount));
+        }
+
+        if (convertBitDepth)
+        {
+            hostWindowBuffer = AcquirePooledBuffer(windowPlaneSampleCount * static_cast<size_t>(hostBytesPerChannel * sourcePlaneCount));
+        }
+
+        // The mask is checked once for each tile before any output is requested.
+        const MaskOccupancyMap maskOccupancyMap(filterRecord, bounds, tileWidth, tileHeight);
 
         const int32 alphaChannelPlaneIndex = hasAlphaChannel ? numberOfChannels - 1 : -1;
 
+        // The planes and windows are copied in the same order as the image is stored, the
+        // passes are planned first so that the tiles of the next pass are known in advance.
+        ::std::vector<HostPlaneRequest> planeRequests(static_cast<size_t>(numberOfChannels));
+        ::std::vector<HostWindowPass> passes;
+
         for (int32 i = 0; i < numberOfChannels; i++)
         {
+            if (convertColorToGray && (i == 1 || i == 2))
+            {
+                // The green and blue planes are used when the red plane is converted to gray.
+                continue;
+            }
+
             if (i == alphaChannelPlaneIndex && premultiplyAlpha)
             {
-                PremultiplyAlpha(
-                    fileHandle,
-                    tileBuffer,
-                    tileWidth,
-                    tileHeight,
-                    filterRecord,
-                    imageSize,
-                    bitsPerChannel);
+                // The alpha plane is the last plane, it is premultiplied after the other planes are copied.
+                continue;
             }
-            else
+
+            HostPlaneRequest& request = planeRequests[i];
+            request.conversion = HostPlaneConversion::Copy;
+            request.setAlphaToOpaque = setAlphaToOpaque && i == lastColorChannelIndex;
+
+            if (convertColorToGray && i == 0)
             {
-                for (int32 y = 0; y < imageSize.v; y += tileHeight)
+                request.conversion = HostPlaneConversion::Luminance;
+                request.loPlane = 0;
+                request.hiPlane = request.setAlphaToOpaque ? documentAlphaPlane : 0;
+            }
+            else if (numberOfChannels <= 2 && numberOfOutputPlanes >= 3)
+            {
+                // Convert a gray or gray + alpha image to RGB or RGB + alpha.
+                if (i == 0)
+                {
+                    // Gray plane, the red, green and blue planes are requested in a single call.
+                    request.conversion = HostPlaneConversion::BroadcastGray;
+                    request.loPlane = 0;
+                    request.hiPlane = request.setAlphaToOpaque ? documentAlphaPlane : 2;
+                }
+                else
                 {
-                    const int32 top = y;
-                    const int32 bottom = ::std::min(top + tileHeight, imageSize.v);
+                    // Alpha plane
+                    request.loPlane = request.hiPlane = 3;
+                }
+            }
+            else
+            {
+                // The alpha channel of a color image is the second plane of a grayscale document.
+                const int16 outputPlane = static_cast<int16>(convertColorToGray && i == alphaChannelPlaneIndex ? 1 : i);
 
-                    const int32 rowCount = bottom - top;
+                request.loPlane = outputPlane;
+                request.hiPlane = request.setAlphaToOpaque ? documentAlphaPlane : outputPlane;
+            }
 
-                    for (int32 x = 0; x < imageSize.h; x += tileWidth)
+            for (int32 windowTop = bounds.top; windowTop < bounds.bottom; windowTop += windowGeometry.height)
+            {
+                for (int32 windowLeft = bounds.left; windowLeft < bounds.right; windowLeft += windowGeometry.width)
+                {
+                    HostWindowPass pass{};
+                    pass.plane = i;
+                    pass.window.top = windowTop;
+                    pass.window.left = windowLeft;
+                    pass.window.bottom = ::std::min(windowTop + windowGeometry.height, bounds.bottom);
+                    pass.window.right = ::std::min(windowLeft + windowGeometry.width, bounds.right);
+                    pass.maskOccupancy = GetHostWindowTiles(
+                        pass.window,
+                        tileWidth,
+                        tileHeight,
+                        maskOccupancyMap,
+                        pass.tiles);
+
+                    // The host would discard all of the output for an unselected window.
+                    if (pass.maskOccupancy != TileMaskOccupancy::Unselected)
                     {
-                        const int32 left = x;
-                        const int32 right = ::std::min(left + tileWidth, imageSize.h);
+                        passes.push_back(::std::move(pass));
+                    }
+                }
+            }
+        }
 
-                        const int32 columnCount = right - left;
+        // Gets the file offset of a window tile in the source planes of a pass.
+        const auto getTileIndex = [&](const HostWindowPass& pass, int32 plane, const HostWindowTile& tile)
+        {
+            const int32 sourcePlane = planeRequests[pass.plane].conversion == HostPlaneConversion::Luminance ? plane : pass.plane;
 
-                        int32 tileBufferRowBytes;
+            return tileTable.GetTileIndex(
+                sourcePlane,
+                pass.window.left - bounds.left + tile.left,
+                pass.window.top - bounds.top + tile.top);
+        };
 
-                        switch (bitsPerChannel)
-                        {
-                        case 8:
-                            tileBufferRowBytes = columnCount;
-                            break;
-                        case 16:
-                            tileBufferRowBytes = columnCount * 2;
-                            break;
-                        case 32:
-                            tileBufferRowBytes = columnCount * 4;
-                            break;
-                        default:
-                            throw ::std::runtime_error("Unsupported bit depth.");
-                        }
+        const auto getSlotOffset = [&](int32 plane, const HostWindowTile& tile)
+        {
+            return ((static_cast<size_t>(plane) * windowSlotCount) + static_cast<size_t>(tile.slot)) * tileSampleCapacity;
+        };
 
-                        const size_t tileDataSize = static_cast<size_t>(rowCount) * static_cast<size_t>(tileBufferRowBytes);
+        // Reads the tiles of a pass into a file buffer.
+        const auto startTileReads = [&](TilePrefetcher& prefetcher, const HostWindowPass& pass, uint8* fileWindow)
+        {
+            ::std::vector<TilePrefetchRequest> requests;
+            requests.reserve(pass.tiles.size() * static_cast<size_t>(sourcePlaneCount));
 
-                        ReadFile(fileHandle, tileBuffer, tileDataSize);
+            for (int32 plane = 0; plane < sourcePlaneCount; plane++)
+            {
+                for (const HostWindowTile& tile : pass.tiles)
+                {
+                    TilePrefetchRequest request{};
+                    request.tileIndex = getTileIndex(pass, plane, tile);
+                    request.buffer = fileWindow + (getSlotOffset(plane, tile) * static_cast<size_t>(fileBytesPerChannel));
+                    request.sampleCount = static_cast<size_t>(tile.columnCount) * static_cast<size_t>(tile.rowCount);
 
-                        if (numberOfChannels <= 2 && numberOfOutputPlanes >= 3)
-                        {
-                            // Convert a gray or gray + alpha image to RGB or RGB + alpha.
+                    requests.push_back(request);
+                }
+            }
 
-                            if (i == 0)
-                            {
-                                // Gray plane
-
-                                for (int16 colorPlane = 0; colorPlane < 3; colorPlane++)
-                                {
-                                    filterRecord->outLoPlane = filterRecord->outHiPlane = colorPlane;
-
-                                    SetOutputRect(filterRecord, top, left, bottom, right);
-
-                                    if (filterRecord->haveMask)
-                                    {
-                                        SetMaskRect(filterRecord, top, left, bottom, right);
-                                    }
-
-                                    OSErrException::ThrowIfError(filterRecord->advanceState());
-
-                                    const uint8* maskData = filterRecord->haveMask ? static_cast<const uint8*>(filterRecord->maskData) : nullptr;
-
-                                    switch (bitsPerChannel)
-                                    {
-                                    case 8:
-                                        CopyTileDataToHostEightBitsPerChannel(
-                                            tileBuffer,
-                                            tileBufferRowBytes,
-                                            columnCount,
-                                            rowCount,
-                                            static_cast<uint8*>(filterRecord->outData),
-                                            filterRecord->outRowBytes,
-                                            maskData,
-                                            filterRecord->maskRowBytes);
-                                        break;
-                                    case 16:
-                                        CopyTileDataToHostSixteenBitsPerChannel(
-                                            tileBuffer,
-                                            tileBufferRowBytes,
-                                            columnCount,
-                                            rowCount,
-                                            static_cast<uint8*>(filterRecord->outData),
-                                            filterRecord->outRowBytes,
-                                            maskData,
-                                            filterRecord->maskRowBytes);
-                                        break;
-                                    case 32:
-                                        CopyTileDataToHostThirtyTwoBitsPerChannel(
-                                            tileBuffer,
-                                            tileBufferRowBytes,
-                                            columnCount,
-                                            rowCount,
-                                            static_cast<uint8*>(filterRecord->outData),
-                                            filterRecord->outRowBytes,
-                                            maskData,
-                                            filterRecord->maskRowBytes);
-                                        break;
-                                    default:
-                                        throw ::std::runtime_error("Unsupported image depth.");
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                // Alpha plane
-
-                                filterRecord->outLoPlane = filterRecord->outHiPlane = 3;
-
-                                SetOutputRect(filterRecord, top, left, bottom, right);
-
-                                if (filterRecord->haveMask)
-                                {
-                                    SetMaskRect(filterRecord, top, left, bottom, right);
-                                }
-
-                                OSErrException::ThrowIfError(filterRecord->advanceState());
-
-                                const uint8* maskData = filterRecord->haveMask ? static_cast<const uint8*>(filterRecord->maskData) : nullptr;
-
-                                switch (bitsPerChannel)
-                                {
-                                case 8:
-                                    CopyTileDataToHostEightBitsPerChannel(
-                                        tileBuffer,
-                                        tileBufferRowBytes,
-                                        columnCount,
-                                        rowCount,
-                                        static_cast<uint8*>(filterRecord->outData),
-                                        filterRecord->outRowBytes,
-                                        maskData,
-                                        filterRecord->maskRowBytes);
-                                    break;
-                                case 16:
-                                    CopyTileDataToHostSixteenBitsPerChannel(
-                                        tileBuffer,
-                                        tileBufferRowBytes,
-                                        columnCount,
-                                        rowCount,
-                                        static_cast<uint8*>(filterRecord->outData),
-                                        filterRecord->outRowBytes,
-                                        maskData,
-                                        filterRecord->maskRowBytes);
-                                    break;
-                                case 32:
-                                    CopyTileDataToHostThirtyTwoBitsPerChannel(
-                                        tileBuffer,
-                                        tileBufferRowBytes,
-                                        columnCount,
-                                        rowCount,
-                                        static_cast<uint8*>(filterRecord->outData),
-                                        filterRecord->outRowBytes,
-                                        maskData,
-                                        filterRecord->maskRowBytes);
-                                    break;
-                                default:
-                                    throw ::std::runtime_error("Unsupported image depth.");
-                                }
-                            }
-                        }
-                        else
+            prefetcher.Start(::std::move(requests));
+        };
+
+        {
+            // The prefetcher must stop before the file buffers are released.
+            TilePrefetcher prefetcher(fileHandle, tileTable);
+
+            if (!passes.empty())
+            {
+                startTileReads(prefetcher, passes[0], static_cast<uint8*>(fileWindowBuffers[0].data()));
+            }
+
+            ::std::vector<HostWindowRowBand> rowBands;
+
+            for (size_t passIndex = 0; passIndex < passes.size(); passIndex++)
+            {
+                const HostWindowPass& pass = passes[passIndex];
+                const HostPlaneRequest& request = planeRequests[pass.plane];
+
+                prefetcher.Wait();
+
+                if ((passIndex + 1) < passes.size())
+                {
+                    startTileReads(
+                        prefetcher,
+                        passes[passIndex + 1],
+                        static_cast<uint8*>(fileWindowBuffers[(passIndex + 1) % 2].data()));
+                }
+
+                uint8* const fileWindow = static_cast<uint8*>(fileWindowBuffers[passIndex % 2].data());
+                uint8* const hostWindow = convertBitDepth ? static_cast<uint8*>(hostWindowBuffer.data()) : fileWindow;
+
+                SetOutputPlaneRange(filterRecord, request.loPlane, request.hiPlane, hostBytesPerChannel);
+
+                SetOutputRect(filterRecord, pass.window.top, pass.window.left, pass.window.bottom, pass.window.right);
+
+                SetOutputTileMaskRect(filterRecord, pass.maskOccupancy, pass.window.top, pass.window.left, pass.window.bottom, pass.window.right);
+
+                OSErrException::ThrowIfError(TimedAdvanceState(filterRecord));
+
+                uint8* const outData = static_cast<uint8*>(filterRecord->outData);
+                const int32 outRowBytes = filterRecord->outRowBytes;
+                const int32 outColumnBytes = filterRecord->outColumnBytes;
+                const int32 outColumnStep = outColumnBytes / hostBytesPerChannel;
+                const uint8* const windowMaskData = GetOutputTileMaskData(filterRecord, pass.maskOccupancy);
+                const int32 maskRowBytes = filterRecord->maskRowBytes;
+
+                GetHostWindowRowBands(pass.tiles, rowBands);
+
+                ParallelFor(
+                    static_cast<int32>(rowBands.size()),
+                    1,
+                    [&](int32 begin, int32 end)
+                    {
+                        for (int32 bandIndex = begin; bandIndex < end; bandIndex++)
                         {
-                            filterRecord->outLoPlane = filterRecord->outHiPlane = static_cast<int16>(i);
+                            const HostWindowRowBand& band = rowBands[bandIndex];
+                            const HostWindowTile& tile = pass.tiles[band.tile];
+
+                            const size_t firstSample = static_cast<size_t>(band.firstRow) * static_cast<size_t>(tile.columnCount);
+                            const size_t bandSampleCount = static_cast<size_t>(band.rowCount) * static_cast<size_t>(tile.columnCount);
+                            const int32 hostRowBytes = tile.columnCount * hostBytesPerChannel;
 
-                            SetOutputRect(filterRecord, top, left, bottom, right);
+                            const uint8* hostPlanes[3] = {};
 
-                            if (filterRecord->haveMask)
+                            for (int32 plane = 0; plane < sourcePlaneCount; plane++)
                             {
-                                SetMaskRect(filterRecord, top, left, bottom, right);
+                                const size_t slotOffset = getSlotOffset(plane, tile);
+
+                                hostPlanes[plane] = ConvertWindowTileRows(
+                                    fileWindow + (slotOffset * static_cast<size_t>(fileBytesPerChannel)),
+                                    hostWindow + (slotOffset * static_cast<size_t>(hostBytesPerChannel)),
+                                    firstSample,
+                                    bandSampleCount,
+                                    bitsPerChannel,
+                                    hostBitDepth);
                             }
 
-                            OSErrException::ThrowIfError(filterRecord->advanceState());
+                            const int32 outTop = tile.top + band.firstRow;
 
-                            const uint8* maskData = filterRecord->haveMask ? static_cast<const uint8*>(filterRecord->maskData) : nullptr;
+                            uint8* const bandOutData = outData + (static_cast<size_t>(outTop) * static_cast<size_t>(outRowBytes)) +
+                                                       (static_cast<size_t>(tile.left) * static_cast<size_t>(outColumnBytes));
+                            const uint8* bandMaskData = nullptr;
 
-                            switch (bitsPerChannel)
+                            if (windowMaskData != nullptr && tile.maskOccupancy == TileMaskOccupancy::PartiallySelected)
                             {
-                            case 8:
-                                CopyTileDataToHostEightBitsPerChannel(
-                                    tileBuffer,
-                                    tileBufferRowBytes,
-                                    columnCount,
-                                    rowCount,
-                                    static_cast<uint8*>(filterRecord->outData),
-                                    filterRecord->outRowBytes,
-                                    maskData,
-                                    filterRecord->maskRowBytes);
-                                break;
-                            case 16:
-                                CopyTileDataToHostSixteenBitsPerChannel(
-                                    tileBuffer,
-                                    tileBufferRowBytes,
-                                    columnCount,
-                                    rowCount,
-                                    static_cast<uint8*>(filterRecord->outData),
-                                    filterRecord->outRowBytes,
-                                    maskData,
-                                    filterRecord->maskRowBytes);
+                                bandMaskData = windowMaskData + (static_cast<size_t>(outTop) * static_cast<size_t>(maskRowBytes)) + static_cast<size_t>(tile.left);
+                            }
+
+                            switch (request.conversion)
+                            {
+                            case HostPlaneConversion::Luminance:
+                                LuminanceTileDataToHost(
+                                    hostPlanes[0],
+                                    hostPlanes[1],
+                                    hostPlanes[2],
+                                    hostRowBytes,
+                                    tile.columnCount,
+                                    band.rowCount,
+                                    bandOutData,
+                                    outRowBytes,
+                                    outColumnStep,
+                                    bandMaskData,
+                                    maskRowBytes,
+                                    hostBitDepth);
                                 break;
-                            case 32:
-                                CopyTileDataToHostThirtyTwoBitsPerChannel(
-                                    tileBuffer,
-                                    tileBufferRowBytes,
-                                    columnCount,
-                                    rowCount,
-                                    static_cast<uint8*>(filterRecord->outData),
-                                    filterRecord->outRowBytes,
-                                    maskData,
-                                    filterRecord->maskRowBytes);
+                            case HostPlaneConversion::BroadcastGray:
+                                BroadcastGrayTileDataToHost(
+                                    hostPlanes[0],
+                                    hostRowBytes,
+                                    tile.columnCount,
+                                    band.rowCount,
+                                    bandOutData,
+                                    outRowBytes,
+                                    outColumnStep,
+                                    bandMaskData,
+                                    maskRowBytes,
+                                    hostBitDepth);
                                 break;
+                            case HostPlaneConversion::Copy:
                             default:
-                                throw ::std::runtime_error("Unsupported image depth.");
+                                CopyTileDataToHost(
+                                    hostPlanes[0],
+                                    hostRowBytes,
+                                    tile.columnCount,
+                                    band.rowCount,
+                                    bandOutData,
+                                    outRowBytes,
+                                    outColumnStep,
+                                    bandMaskData,
+                                    maskRowBytes,
+                                    hostBitDepth);
+                                break;
+                            }
+
+                            if (request.setAlphaToOpaque)
+                            {
+                                SetAlphaTileToOpaque(
+                                    tile.columnCount,
+                                    band.rowCount,
+                                    bandOutData + ((documentAlphaPlane - request.loPlane) * hostBytesPerChannel),
+                                    outRowBytes,
+                                    outColumnStep,
+                                    bandMaskData,
+                                    maskRowBytes,
+                                    hostBitDepth);
                             }
                         }
-                    }
-                }
+                    });
             }
         }
+
+        if (premultiplyAlpha)
+        {
+            // The prefetcher has stopped, so the file handle can be used on this thread.
+            PremultiplyAlpha(
+                fileHandle,
+                tileTable,
+                alphaChannelPlaneIndex,
+                maskOccupancyMap,
+                tileWidth,
+                tileHeight,
+                filterRecord,
+                bounds,
+                bitsPerChannel,
+                hostBitDepth);
+        }
     }
 }
 
@@ -450,9 +1335,10 @@ bool ImageSizeMatchesDocument(
 void CopyImageToActiveLayer(
     const boost::filesystem::path& path,
     FilterRecord* filterRecord,
-    const int32& hostBitDepth)
+    const int32& hostBitDepth,
+    const VRect& bounds)
 {
     ::std::unique_ptr<FileHandle> file = OpenFile(path, FileOpenMode::Read);
 
-    CopyImageToActiveLayerCore(filterRecord, file.get(), hostBitDepth);
+    CopyImageToActiveLayerCore(filterRecord, file.get(), hostBitDepth, bounds);
 }
@@ -22,6 +22,7 @@ bool ImageSizeMatchesDocument(
 void CopyImageToActiveLayer(
     const boost::filesystem::path& path,
     FilterRecord* filterRecord,
-    const int32& hostBitDepth);
+    const int32& hostBitDepth,
+    const VRect& bounds);
 
 #endif // !GMIC8BFIMAGEREADER_H
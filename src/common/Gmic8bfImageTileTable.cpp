@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "Gmic8bfImageTileTable.h"
+#include "BufferPool.h"
+#include "ImageUtil.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    int32 GetTileCount(int32 imageSize, int32 tileSize)
+    {
+        if (imageSize <= 0 || tileSize <= 0)
+        {
+            throw ::std::runtime_error("The Gmic8bfImage has an invalid tile size.");
+        }
+
+        return (imageSize + tileSize - 1) / tileSize;
+    }
+}
+
+Gmic8bfImageTileTable::Gmic8bfImageTileTable(const Gmic8bfImageHeader& header)
+    : imageWidth(header.GetWidth()),
+      imageHeight(header.GetHeight()),
+      tileWidth(header.GetTileWidth()),
+      tileHeight(header.GetTileHeight()),
+      tilesAcross(GetTileCount(header.GetWidth(), header.GetTileWidth())),
+      tilesDown(GetTileCount(header.GetHeight(), header.GetTileHeight())),
+      bitsPerChannel(header.GetBitsPerChannel()),
+      entries(static_cast<size_t>(tilesAcross) * static_cast<size_t>(tilesDown) * static_cast<size_t>(header.GetNumberOfChannels()))
+{
+    if (!header.IsPlanar())
+    {
+        throw ::std::runtime_error("The tile table requires a planar Gmic8bfImage.");
+    }
+}
+
+Gmic8bfImageTileTable::Gmic8bfImageTileTable(FileHandle* file, const Gmic8bfImageHeader& header)
+    : Gmic8bfImageTileTable(header)
+{
+    SetTileOffsets(GetFilePosition(file));
+}
+
+int32 Gmic8bfImageTileTable::GetTileIndex(int32 plane, int32 x, int32 y) const
+{
+    return (plane * tilesAcross * tilesDown) + ((y / tileHeight) * tilesAcross) + (x / tileWidth);
+}
+
+bool Gmic8bfImageTileTable::IsConstantPlane(int32 plane, uint32 value) const
+{
+    const size_t tilesPerPlane = GetTilesPerPlane();
+    const size_t first = static_cast<size_t>(plane) * tilesPerPlane;
+
+    for (size_t i = first; i < (first + tilesPerPlane); i++)
+    {
+        if (!entries[i].constant || entries[i].constantValue != value)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Gmic8bfImageTileTable::ReadTile(FileHandle* file, int32 tileIndex, void* buffer, size_t sampleCount) const
+{
+    SetFilePosition(file, entries[static_cast<size_t>(tileIndex)].dataOffset);
+    ReadFile(file, buffer, sampleCount * static_cast<size_t>(bitsPerChannel / 8));
+}
+
+void Gmic8bfImageTileTable::WriteTile(FileHandle* file, int32 tileIndex, const void* data, size_t sampleCount)
+{
+    TileEntry& entry = entries[static_cast<size_t>(tileIndex)];
+
+    if (IsConstantSampleData(data, sampleCount, bitsPerChannel, entry.constantValue))
+    {
+        entry.constant = true;
+    }
+    else
+    {
+        if (GetFilePosition(file) != entry.dataOffset)
+        {
+            SetFilePosition(file, entry.dataOffset);
+        }
+
+        entry.constant = false;
+        entry.constantValue = 0;
+
+        WriteFile(file, data, sampleCount * static_cast<size_t>(bitsPerChannel / 8));
+    }
+}
+
+void Gmic8bfImageTileTable::RemoveLastPlane()
+{
+    const size_t tilesPerPlane = GetTilesPerPlane();
+
+    if (entries.size() <= tilesPerPlane)
+    {
+        throw ::std::runtime_error("The last plane of the Gmic8bfImage cannot be removed.");
+    }
+
+    const size_t first = entries.size() - tilesPerPlane;
+
+    for (size_t i = first; i < entries.size(); i++)
+    {
+        if (!entries[i].constant)
+        {
+            throw ::std::runtime_error("The Gmic8bfImage plane has tile data that was already written.");
+        }
+    }
+
+    entries.resize(first);
+}
+
+void Gmic8bfImageTileTable::Reserve(FileHandle* file)
+{
+    SetTileOffsets(GetFilePosition(file));
+}
+
+void Gmic8bfImageTileTable::Write(FileHandle* file) const
+{
+    PooledBuffer tileBuffer;
+    bool tileBufferFilled = false;
+    uint32 tileBufferValue = 0;
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const TileEntry& entry = entries[i];
+
+        if (entry.constant)
+        {
+            const size_t sampleCount = GetTileSampleCount(i);
+
+            if (!tileBufferFilled || tileBufferValue != entry.constantValue)
+            {
+                if (tileBuffer.data() == nullptr)
+                {
+                    tileBuffer = AcquirePooledBuffer(static_cast<size_t>(tileWidth) * static_cast<size_t>(tileHeight) * static_cast<size_t>(bitsPerChannel / 8));
+                }
+
+                // The tiles in the last row and column are smaller, so the whole buffer is filled.
+                FillSampleData(tileBuffer.data(), static_cast<size_t>(tileWidth) * static_cast<size_t>(tileHeight), bitsPerChannel, entry.constantValue);
+                tileBufferFilled = true;
+                tileBufferValue = entry.constantValue;
+            }
+
+            SetFilePosition(file, entry.dataOffset);
+            WriteFile(file, tileBuffer.data(), sampleCount * static_cast<size_t>(bitsPerChannel / 8));
+        }
+    }
+}
+
+void Gmic8bfImageTileTable::SetTileOffsets(int64 dataOffset)
+{
+    // The tiles in the last row and column can be smaller than the tile size.
+    const int64 bytesPerChannel = bitsPerChannel / 8;
+    const int64 planeBytes = static_cast<int64>(imageWidth) * imageHeight * bytesPerChannel;
+    const int32 planeCount = static_cast<int32>(entries.size() / GetTilesPerPlane());
+
+    size_t index = 0;
+
+    for (int32 plane = 0; plane < planeCount; plane++)
+    {
+        for (int32 tileY = 0; tileY < tilesDown; tileY++)
+        {
+            const int32 top = tileY * tileHeight;
+            const int64 rowCount = ::std::min(tileHeight, imageHeight - top);
+            const int64 tileRowOffset = dataOffset + (plane * planeBytes) + (static_cast<int64>(top) * imageWidth * bytesPerChannel);
+
+            for (int32 tileX = 0; tileX < tilesAcross; tileX++)
+            {
+                const int64 left = static_cast<int64>(tileX) * tileWidth;
+
+                TileEntry& entry = entries[index++];
+                entry.dataOffset = tileRowOffset + (left * rowCount * bytesPerChannel);
+                entry.constant = false;
+                entry.constantValue = 0;
+            }
+        }
+    }
+}
+
+size_t Gmic8bfImageTileTable::GetTileSampleCount(size_t tileIndex) const
+{
+    const size_t planeTileIndex = tileIndex % GetTilesPerPlane();
+
+    const int32 left = static_cast<int32>(planeTileIndex % static_cast<size_t>(tilesAcross)) * tileWidth;
+    const int32 top = static_cast<int32>(planeTileIndex / static_cast<size_t>(tilesAcross)) * tileHeight;
+
+    const int32 columnCount = ::std::min(tileWidth, imageWidth - left);
+    const int32 rowCount = ::std::min(tileHeight, imageHeight - top);
+
+    return static_cast<size_t>(columnCount) * static_cast<size_t>(rowCount);
+}
+
+size_t Gmic8bfImageTileTable::GetTilesPerPlane() const
+{
+    return static_cast<size_t>(tilesAcross) * static_cast<size_t>(tilesDown);
+}
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef GMIC8BFIMAGETILETABLE_H
+#define GMIC8BFIMAGETILETABLE_H
+
+#include "Gmic8bfImageHeader.h"
+#include <vector>
+
+// The tile table of a planar Gmic8bfImage.
+//
+// The tiles of each plane are stored back to back, so the tile offsets are computed from
+// the image size. When an image is written, a tile whose samples all have the same value
+// is only recorded in the table, its data is written when the table is written. This
+// allows a fully opaque alpha plane to be removed before any of its data is in the file.
+class Gmic8bfImageTileTable
+{
+public:
+    // Creates a table for writing an image, every tile must be written with WriteTile.
+    explicit Gmic8bfImageTileTable(const Gmic8bfImageHeader& header);
+
+    // Creates a table for reading an image, the file must be positioned after the header.
+    Gmic8bfImageTileTable(FileHandle* file, const Gmic8bfImageHeader& header);
+
+    // Gets the index of the tile that contains the specified point of the image plane.
+    int32 GetTileIndex(int32 plane, int32 x, int32 y) const;
+
+    // Determines whether every tile in the plane is a constant tile with the specified value.
+    bool IsConstantPlane(int32 plane, uint32 value) const;
+
+    // Reads the tile data into the buffer, sampleCount is the number of samples in the tile.
+    void ReadTile(FileHandle* file, int32 tileIndex, void* buffer, size_t sampleCount) const;
+
+    // Writes the tile data, or records the tile as a constant tile when all of its samples
+    // have the same value. The tiles can be written in any order.
+    void WriteTile(FileHandle* file, int32 tileIndex, const void* data, size_t sampleCount);
+
+    // Removes the last plane from the image, which must only contain constant tiles so that
+    // none of its data has been written. This is used when the alpha channel is fully opaque.
+    void RemoveLastPlane();
+
+    // Sets the offset of the tile data to the current file position, which must be after the header.
+    void Reserve(FileHandle* file);
+
+    // Writes the data of the constant tiles at the offsets that were reserved for them.
+    void Write(FileHandle* file) const;
+
+private:
+    struct TileEntry
+    {
+        int64 dataOffset;
+        bool constant;
+        uint32 constantValue;
+    };
+
+    // Sets the offsets of the tiles, which are stored back to back.
+    void SetTileOffsets(int64 dataOffset);
+
+    size_t GetTileSampleCount(size_t tileIndex) const;
+
+    size_t GetTilesPerPlane() const;
+
+    int32 imageWidth;
+    int32 imageHeight;
+    int32 tileWidth;
+    int32 tileHeight;
+    int32 tilesAcross;
+    int32 tilesDown;
+    int32 bitsPerChannel;
+    ::std::vector<TileEntry> entries;
+};
+
+#endif // !GMIC8BFIMAGETILETABLE_H
@@ -11,10 +11,15 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "Gmic8bfImageWriter.h"
+#include "BufferPool.h"
 #include "Gmic8bfImageHeader.h"
-#include "ScopedBufferSuite.h"
+#include "Gmic8bfImageTileTable.h"
 #include "FileIO.h"
+#include "ImageUtil.h"
 #include "InputLayerIndex.h"
+#include "ParallelFor.h"
+#include "TilePlanner.h"
+#include <cstring>
 #include <string>
 
 namespace
@@ -28,8 +33,6 @@ namespace
 
     void ScaleSixteenBitDataToOutputRange(void* data, int32 width, int32 height, int32 rowBytes) noexcept
     {
-        DebugOut("%s, width=%d height=%d", __FUNCTION__, width, height);
-
         uint8* scan0 = static_cast<uint8*>(data);
 
         for (int32 y = 0; y < height; y++)
@@ -73,17 +76,56 @@ namespace
         }
     }
 
+    // Writes the constant tiles of the image, the alpha channel is removed from the image when it is
+    // fully opaque. An opaque alpha plane only has constant tiles, so none of its data is in the file.
+    void WriteTileTable(
+        FileHandle* file,
+        const Gmic8bfImageHeader& fileHeader,
+        Gmic8bfImageTileTable& tileTable,
+        bool hasTransparency,
+        const char* callerName)
+    {
+        const bool removeAlphaChannel = hasTransparency && tileTable.IsConstantPlane(
+            fileHeader.GetNumberOfChannels() - 1,
+            GetOpaqueAlphaSampleValue(fileHeader.GetBitsPerChannel()));
+
+        if (removeAlphaChannel)
+        {
+            // G'MIC-Qt does not need to process an alpha channel that is fully opaque.
+            tileTable.RemoveLastPlane();
+        }
+
+        tileTable.Write(file);
+
+        if (removeAlphaChannel)
+        {
+            DebugOut("%s: removed the opaque alpha channel", callerName);
+
+            Gmic8bfImageHeader opaqueHeader(
+                fileHeader.GetWidth(),
+                fileHeader.GetHeight(),
+                fileHeader.GetNumberOfChannels() - 1,
+                fileHeader.GetBitsPerChannel(),
+                fileHeader.IsPlanar(),
+                fileHeader.GetTileWidth(),
+                fileHeader.GetTileHeight());
+
+            SetFilePosition(file, 0);
+            WriteFile(file, &opaqueHeader, sizeof(opaqueHeader));
+        }
+    }
+
     void SaveActiveLayerCore(
         FilterRecordPtr filterRecord,
-        const VPoint& imageSize,
+        const VRect& bounds,
         const int32& bitsPerChannel,
         const bool& grayScale,
         const boost::filesystem::path& path)
     {
         const bool hasTransparency = filterRecord->inLayerPlanes != 0 && filterRecord->inTransparencyMask != 0;
 
-        int32 width = imageSize.h;
-        int32 height = imageSize.v;
+        int32 width = bounds.right - bounds.left;
+        int32 height = bounds.bottom - bounds.top;
         int32 numberOfChannels;
 
         if (grayScale)
@@ -99,16 +141,53 @@ namespace
 
         ::std::unique_ptr<FileHandle> file = OpenFile(path, FileOpenMode::Write, preallocationSize);
 
-        const int32 tileWidth = ::std::min(GetTileWidth(filterRecord->inTileWidth), width);
-        const int32 tileHeight = ::std::min(GetTileHeight(filterRecord->inTileHeight), height);
+        // The image is written using a lower bit depth than the host when
+        // the reduced precision export mode is enabled.
+        const int32 hostBitDepth = GetImageDepth(filterRecord);
+
+        const TileGeometry tileGeometry = PlanHostTileGeometry(
+            filterRecord,
+            width,
+            height,
+            hostBitDepth,
+            1,
+            filterRecord->inTileWidth,
+            filterRecord->inTileHeight,
+            __FUNCTION__);
+        const int32 tileWidth = tileGeometry.width;
+        const int32 tileHeight = tileGeometry.height;
 
         Gmic8bfImageHeader fileHeader(width, height, numberOfChannels, bitsPerChannel, /* planar */ true, tileWidth, tileHeight);
 
         WriteFile(file.get(), &fileHeader, sizeof(fileHeader));
 
-        const int32 bytesPerChannel = bitsPerChannel / 8;
+        Gmic8bfImageTileTable tileTable(fileHeader);
+        tileTable.Reserve(file.get());
 
-        filterRecord->inPlaneBytes = bytesPerChannel;
+        const int32 bytesPerChannel = bitsPerChannel / 8;
+        const bool convertBitDepth = bitsPerChannel != hostBitDepth;
+
+        // Each host request covers a window of several tiles when the host has enough memory,
+        // the tiles in the window are converted in parallel and then written in file order.
+        const TileGeometry windowGeometry = PlanHostWindowGeometry(
+            filterRecord,
+            width,
+            height,
+            tileWidth,
+            tileHeight,
+            hostBitDepth / 8,
+            bytesPerChannel,
+            __FUNCTION__);
+        const int32 windowTilesAcross = (windowGeometry.width + tileWidth - 1) / tileWidth;
+        const int32 windowTilesDown = (windowGeometry.height + tileHeight - 1) / tileHeight;
+        const size_t tileSlotBytes = static_cast<size_t>(tileWidth) * static_cast<size_t>(tileHeight) * static_cast<size_t>(bytesPerChannel);
+
+        // The window buffer holds a contiguous copy of each tile for the constant tile check,
+        // using the output bit depth.
+        PooledBuffer windowBuffer = AcquirePooledBuffer(tileSlotBytes * static_cast<size_t>(windowTilesAcross) * static_cast<size_t>(windowTilesDown));
+        uint8* const windowScan0 = static_cast<uint8*>(windowBuffer.data());
+
+        filterRecord->inPlaneBytes = hostBitDepth / 8;
         filterRecord->inColumnBytes = filterRecord->inPlaneBytes;
         filterRecord->inputRate = int2fixed(1);
 
@@ -116,55 +195,85 @@ namespace
         {
             filterRecord->inLoPlane = filterRecord->inHiPlane = static_cast<int16>(i);
 
-            for (int32 y = 0; y < height; y += tileHeight)
+            for (int32 windowTop = bounds.top; windowTop < bounds.bottom; windowTop += windowGeometry.height)
             {
-                const int32 top = y;
-                const int32 bottom = ::std::min(y + tileHeight, imageSize.v);
-
-                const int32 rowCount = bottom - top;
+                const int32 windowBottom = ::std::min(windowTop + windowGeometry.height, bounds.bottom);
 
-                for (int32 x = 0; x < width; x += tileWidth)
+                for (int32 windowLeft = bounds.left; windowLeft < bounds.right; windowLeft += windowGeometry.width)
                 {
-                    const int32 left = x;
-                    const int32 right = ::std::min(x + tileWidth, imageSize.h);
+                    const int32 windowRight = ::std::min(windowLeft + windowGeometry.width, bounds.right);
 
-                    const int32 columnCount = right - left;
+                    SetInputRect(filterRecord, windowTop, windowLeft, windowBottom, windowRight);
 
-                    SetInputRect(filterRecord, top, left, bottom, right);
+                    OSErrException::ThrowIfError(TimedAdvanceState(filterRecord));
 
-                    OSErrException::ThrowIfError(filterRecord->advanceState());
+                    const int32 tilesAcross = (windowRight - windowLeft + tileWidth - 1) / tileWidth;
+                    const int32 tilesDown = (windowBottom - windowTop + tileHeight - 1) / tileHeight;
 
-                    const int32 outputStride = columnCount * bytesPerChannel;
+                    uint8* const inData = static_cast<uint8*>(filterRecord->inData);
+                    const int32 inRowBytes = filterRecord->inRowBytes;
 
-                    if (bitsPerChannel == 16)
+                    // The rows of the window are processed in parallel, each row is split
+                    // between the tiles that it intersects.
+                    ParallelFor(windowBottom - windowTop, 16, [&](int32 begin, int32 end)
                     {
-                        ScaleSixteenBitDataToOutputRange(filterRecord->inData, columnCount, rowCount, filterRecord->inRowBytes);
-                    }
-
-                    if (outputStride == filterRecord->inRowBytes)
-                    {
-                        // If the host's buffer stride matches the output image stride
-                        // we can write the buffer directly.
-
-                        WriteFile(file.get(), filterRecord->inData, static_cast<size_t>(rowCount) * outputStride);
-                    }
-                    else
-                    {
-                        for (int32 j = 0; j < rowCount; j++)
+                        for (int32 y = begin; y < end; y++)
                         {
-                            const uint8* row = static_cast<const uint8*>(filterRecord->inData) + (static_cast<int64>(j) * filterRecord->inRowBytes);
-
-                            WriteFile(file.get(), row, outputStride);
+                            const int32 tileRow = y / tileHeight;
+                            const int32 tileY = y % tileHeight;
+                            uint8* const sourceRow = inData + (static_cast<int64>(y) * inRowBytes);
+
+                            for (int32 tileColumn = 0; tileColumn < tilesAcross; tileColumn++)
+                            {
+                                const int32 left = tileColumn * tileWidth;
+                                const int32 columnCount = ::std::min(tileWidth, windowRight - windowLeft - left);
+                                const int32 outputStride = columnCount * bytesPerChannel;
+
+                                uint8* const source = sourceRow + (static_cast<int64>(left) * filterRecord->inColumnBytes);
+                                uint8* const destination = windowScan0
+                                    + (tileSlotBytes * static_cast<size_t>((tileRow * tilesAcross) + tileColumn))
+                                    + (static_cast<size_t>(tileY) * static_cast<size_t>(outputStride));
+
+                                if (hostBitDepth == 16)
+                                {
+                                    ScaleSixteenBitDataToOutputRange(source, columnCount, 1, inRowBytes);
+                                }
+
+                                if (convertBitDepth)
+                                {
+                                    ConvertChannelBitDepth(source, hostBitDepth, destination, bitsPerChannel, static_cast<size_t>(columnCount));
+                                }
+                                else
+                                {
+                                    ::std::memcpy(destination, source, static_cast<size_t>(outputStride));
+                                }
+                            }
                         }
+                    });
+
+                    for (int32 tile = 0; tile < (tilesAcross * tilesDown); tile++)
+                    {
+                        const int32 left = (tile % tilesAcross) * tileWidth;
+                        const int32 top = (tile / tilesAcross) * tileHeight;
+                        const int32 columnCount = ::std::min(tileWidth, windowRight - windowLeft - left);
+                        const int32 rowCount = ::std::min(tileHeight, windowBottom - windowTop - top);
+
+                        tileTable.WriteTile(
+                            file.get(),
+                            tileTable.GetTileIndex(i, windowLeft - bounds.left + left, windowTop - bounds.top + top),
+                            windowScan0 + (tileSlotBytes * static_cast<size_t>(tile)),
+                            static_cast<size_t>(rowCount) * static_cast<size_t>(columnCount));
                     }
                 }
             }
         }
+
+        WriteTileTable(file.get(), fileHeader, tileTable, hasTransparency, __FUNCTION__);
     }
 
     void SaveDocumentLayer(
         FilterRecordPtr filterRecord,
-        const VPoint& documentSize,
+        const VRect& documentBounds,
         const int32& bitsPerChannel,
         const bool& grayScale,
         const ReadLayerDesc* layerDescriptor,
@@ -176,27 +285,27 @@ namespace
         const ReadChannelDesc firstCompositeChannel = layerDescriptor->compositeChannelsList[0];
         VRect layerBounds = firstCompositeChannel.bounds;
 
-        // Clamp the layer bounds to the size of the parent document.
+        // Clamp the layer bounds to the bounds of the parent document.
         // The layer bounds can be smaller than the parent document, but any data outside of
         // the parent document bounds should be ignored.
-        if (layerBounds.top < 0)
+        if (layerBounds.top < documentBounds.top)
         {
-            layerBounds.top = 0;
+            layerBounds.top = documentBounds.top;
         }
 
-        if (layerBounds.left < 0)
+        if (layerBounds.left < documentBounds.left)
         {
-            layerBounds.left = 0;
+            layerBounds.left = documentBounds.left;
         }
 
-        if (layerBounds.bottom > documentSize.v)
+        if (layerBounds.bottom > documentBounds.bottom)
         {
-            layerBounds.bottom = documentSize.v;
+            layerBounds.bottom = documentBounds.bottom;
         }
 
-        if (layerBounds.right > documentSize.h)
+        if (layerBounds.right > documentBounds.right)
         {
-            layerBounds.right = documentSize.h;
+            layerBounds.right = documentBounds.right;
         }
 
         const int32 width = layerBounds.right - layerBounds.left;
@@ -220,14 +329,29 @@ namespace
 
         ::std::unique_ptr<FileHandle> file = OpenFile(path, FileOpenMode::Write, preallocationSize);
 
-        const int32 tileWidth = ::std::min(firstCompositeChannel.tileSize.h, width);
-        const int32 tileHeight = ::std::min(firstCompositeChannel.tileSize.v, height);
+        const int32 hostBitDepth = GetImageDepth(filterRecord);
+        const bool convertBitDepth = bitsPerChannel != hostBitDepth;
+
+        const TileGeometry tileGeometry = PlanHostTileGeometry(
+            filterRecord,
+            width,
+            height,
+            hostBitDepth,
+            1,
+            firstCompositeChannel.tileSize.h,
+            firstCompositeChannel.tileSize.v,
+            __FUNCTION__);
+        const int32 tileWidth = tileGeometry.width;
+        const int32 tileHeight = tileGeometry.height;
 
         Gmic8bfImageHeader fileHeader(width, height, numberOfChannels, bitsPerChannel, /* planar */ true, tileWidth, tileHeight);
 
         WriteFile(file.get(), &fileHeader, sizeof(fileHeader));
 
-        filterRecord->inPlaneBytes = bitsPerChannel / 8;
+        Gmic8bfImageTileTable tileTable(fileHeader);
+        tileTable.Reserve(file.get());
+
+        filterRecord->inPlaneBytes = hostBitDepth / 8;
         filterRecord->inColumnBytes = filterRecord->inPlaneBytes;
         filterRecord->inputRate = int2fixed(1);
         int32 tileRowBytes;
@@ -246,11 +370,18 @@ namespace
             throw OSErrException(memFullErr);
         }
 
-        // Nested scope to ensure that the ScopedBufferSuiteBuffer is destroyed before the method exits.
+        // Nested scope to ensure that the PooledBuffer is returned to the pool before the method exits.
         {
-            ScopedBufferSuiteBuffer buffer(filterRecord, imageDataBufferSize);
+            PooledBuffer buffer = AcquirePooledBuffer(static_cast<size_t>(imageDataBufferSize));
 
-            void* imageDataBuffer = buffer.lock();
+            void* imageDataBuffer = buffer.data();
+
+            PooledBuffer conversionBuffer;
+
+            if (convertBitDepth)
+            {
+                conversionBuffer = AcquirePooledBuffer(static_cast<size_t>(tileWidth) * static_cast<size_t>(tileHeight) * static_cast<size_t>(bitsPerChannel / 8));
+            }
 
             PixelMemoryDesc dest{};
             dest.bitOffset = 0;
@@ -283,15 +414,15 @@ namespace
                 for (int32 y = 0; y < height; y += tileHeight)
                 {
                     VRect writeRect{};
-                    writeRect.top = y;
-                    writeRect.bottom = ::std::min(y + tileHeight, height);
+                    writeRect.top = documentBounds.top + y;
+                    writeRect.bottom = documentBounds.top + ::std::min(y + tileHeight, height);
 
                     const int32 rowCount = writeRect.bottom - writeRect.top;
 
                     for (int32 x = 0; x < width; x += tileWidth)
                     {
-                        writeRect.left = x;
-                        writeRect.right = ::std::min(x + tileWidth, width);
+                        writeRect.left = documentBounds.left + x;
+                        writeRect.right = documentBounds.left + ::std::min(x + tileWidth, width);
 
                         const int32 columnCount = writeRect.right - writeRect.left;
                         tileRowBytes = columnCount * filterRecord->inColumnBytes;
@@ -306,12 +437,16 @@ namespace
 
                         VRect wroteRect;
 
-                        OSErrException::ThrowIfError(filterRecord->channelPortProcs->readPixelsProc(
-                            imageChannels[i]->port,
-                            &scaling,
-                            &writeRect,
-                            &dest,
-                            &wroteRect));
+                        {
+                            ScopedHostCallbackTimer callbackTimer;
+
+                            OSErrException::ThrowIfError(filterRecord->channelPortProcs->readPixelsProc(
+                                imageChannels[i]->port,
+                                &scaling,
+                                &writeRect,
+                                &dest,
+                                &wroteRect));
+                        }
 
                         if (wroteRect.top != writeRect.top ||
                             wroteRect.left != writeRect.left ||
@@ -321,16 +456,55 @@ namespace
                             throw ::std::runtime_error("Unable to read all of the requested image data from a layer.");
                         }
 
-                        if (bitsPerChannel == 16)
+                        if (hostBitDepth == 16)
                         {
                             ScaleSixteenBitDataToOutputRange(dest.data, columnCount, rowCount, tileRowBytes);
                         }
 
-                        WriteFile(file.get(), imageDataBuffer, static_cast<size_t>(rowCount) * tileRowBytes);
+                        const int32 tileIndex = tileTable.GetTileIndex(i, x, y);
+                        const size_t channelCount = static_cast<size_t>(rowCount) * static_cast<size_t>(columnCount);
+
+                        if (convertBitDepth)
+                        {
+                            ConvertChannelBitDepth(imageDataBuffer, hostBitDepth, conversionBuffer.data(), bitsPerChannel, channelCount);
+
+                            tileTable.WriteTile(file.get(), tileIndex, conversionBuffer.data(), channelCount);
+                        }
+                        else
+                        {
+                            tileTable.WriteTile(file.get(), tileIndex, imageDataBuffer, channelCount);
+                        }
                     }
                 }
             }
         }
+
+        WriteTileTable(file.get(), fileHeader, tileTable, hasTransparency, __FUNCTION__);
+    }
+
+    // Determines whether G'MIC-Qt will use the layer with the specified input mode.
+    // The active layer is always saved because G'MIC-Qt writes the output to it.
+    bool LayerIsRequiredByInputMode(GmicQtInputMode inputMode, bool isActiveLayer, bool isVisible)
+    {
+        if (isActiveLayer)
+        {
+            return true;
+        }
+
+        switch (inputMode)
+        {
+        case GmicQtInputMode::NoInput:
+        case GmicQtInputMode::ActiveLayer:
+            return false;
+        case GmicQtInputMode::AllVisibleLayers:
+            return isVisible;
+        case GmicQtInputMode::AllHiddenLayers:
+            return !isVisible;
+        case GmicQtInputMode::AllLayers:
+        case GmicQtInputMode::Unknown:
+        default:
+            return true;
+        }
     }
 }
 
@@ -373,16 +547,15 @@ void SaveActiveLayer(
     const int32& bitsPerChannel,
     const bool& grayScale,
     InputLayerIndex* index,
+    const VRect& regionOfInterest,
     FilterRecordPtr filterRecord)
 {
     boost::filesystem::path activeLayerPath = GetTemporaryFileName(outputDir, ".g8i");
 
-    const VPoint imageSize = GetImageSize(filterRecord);
+    SaveActiveLayerCore(filterRecord, regionOfInterest, bitsPerChannel, grayScale, activeLayerPath);
 
-    SaveActiveLayerCore(filterRecord, imageSize, bitsPerChannel, grayScale, activeLayerPath);
-
-    int32 layerWidth = imageSize.h;
-    int32 layerHeight = imageSize.v;
+    int32 layerWidth = regionOfInterest.right - regionOfInterest.left;
+    int32 layerHeight = regionOfInterest.bottom - regionOfInterest.top;
     bool layerIsVisible = true;
     ::std::string layerName;
 
@@ -401,67 +574,75 @@ void SaveAllLayers(
     const bool& grayScale,
     InputLayerIndex* index,
     int32 targetLayerIndex,
+    const VRect& regionOfInterest,
+    GmicQtInputMode inputMode,
     FilterRecordPtr filterRecord)
 {
     ReadLayerDesc* layerDescriptor = filterRecord->documentInfo->layersDescriptor;
 
     int32 activeLayerIndex = 0;
     int32 pixelBasedLayerCount = 0;
+    int32 savedLayerCount = 0;
     int32 layerIndex = 0;
     char layerNameBuffer[128]{};
 
-    const VPoint documentSize = GetImageSize(filterRecord);
-
     while (layerDescriptor != nullptr)
     {
         // Skip over any vector layers.
         if (layerDescriptor->isPixelBased)
         {
-            boost::filesystem::path imagePath = GetTemporaryFileName(outputDir, ".g8i");
-
-            VPoint layerSize{};
-
-            SaveDocumentLayer(
-                filterRecord,
-                documentSize,
-                bitsPerChannel,
-                grayScale,
-                layerDescriptor,
-                imagePath,
-                layerSize);
-
-            int32 layerWidth = layerSize.h;
-            int32 layerHeight = layerSize.v;
+            const bool isActiveLayer = layerIndex == targetLayerIndex;
             bool layerIsVisible = true;
-            ::std::string utf8Name;
 
             if (layerDescriptor->maxVersion >= 2)
             {
                 layerIsVisible = layerDescriptor->isVisible;
+            }
 
-                if (layerDescriptor->unicodeName != nullptr)
+            if (LayerIsRequiredByInputMode(inputMode, isActiveLayer, layerIsVisible))
+            {
+                boost::filesystem::path imagePath = GetTemporaryFileName(outputDir, ".g8i");
+
+                VPoint layerSize{};
+
+                SaveDocumentLayer(
+                    filterRecord,
+                    regionOfInterest,
+                    bitsPerChannel,
+                    grayScale,
+                    layerDescriptor,
+                    imagePath,
+                    layerSize);
+
+                int32 layerWidth = layerSize.h;
+                int32 layerHeight = layerSize.v;
+                ::std::string utf8Name;
+
+                if (layerDescriptor->maxVersion >= 2 && layerDescriptor->unicodeName != nullptr)
                 {
                     utf8Name = ConvertLayerNameToUTF8(layerDescriptor->unicodeName);
                 }
-            }
-
-            if (utf8Name.empty())
-            {
-                int written = ::std::snprintf(layerNameBuffer, sizeof(layerNameBuffer), "Layer %d", pixelBasedLayerCount);
 
-                if (written <= 0)
+                if (utf8Name.empty())
                 {
-                    throw ::std::runtime_error("Unable to write the layer name.");
+                    int written = ::std::snprintf(layerNameBuffer, sizeof(layerNameBuffer), "Layer %d", pixelBasedLayerCount);
+
+                    if (written <= 0)
+                    {
+                        throw ::std::runtime_error("Unable to write the layer name.");
+                    }
+
+                    utf8Name.assign(layerNameBuffer, layerNameBuffer + written);
                 }
 
-                utf8Name.assign(layerNameBuffer, layerNameBuffer + written);
-            }
+                index->AddFile(imagePath, layerWidth, layerHeight, layerIsVisible, utf8Name);
 
-            index->AddFile(imagePath, layerWidth, layerHeight, layerIsVisible, utf8Name);
+                if (isActiveLayer)
+                {
+                    activeLayerIndex = savedLayerCount;
+                }
 
-            if (layerIndex == targetLayerIndex)
-            {
-                activeLayerIndex = pixelBasedLayerCount;
+                savedLayerCount++;
             }
 
             pixelBasedLayerCount++;
@@ -471,6 +652,8 @@ void SaveAllLayers(
         layerIndex++;
     }
 
+    DebugOut("%s: saved %d of %d layers", __FUNCTION__, savedLayerCount, pixelBasedLayerCount);
+
     index->SetActiveLayerIndex(activeLayerIndex);
 }
 
@@ -15,6 +15,7 @@
 
 #include "InputLayerIndex.h"
 #include "FileUtil.h"
+#include "GmicQtParameters.h"
 #include "Utilities.h"
 #include <boost/filesystem.hpp>
 
@@ -49,6 +50,7 @@ void SaveActiveLayer(
     const int32& bitsPerChannel,
     const bool& grayScale,
     InputLayerIndex* index,
+    const VRect& regionOfInterest,
     FilterRecordPtr filterRecord);
 
 #if PSSDK_HAS_LAYER_SUPPORT
@@ -58,6 +60,8 @@ void SaveAllLayers(
     const bool& grayScale,
     InputLayerIndex* index,
     int32 targetLayerIndex,
+    const VRect& regionOfInterest,
+    GmicQtInputMode inputMode,
     FilterRecordPtr filterRecord);
 #endif // PSSDK_HAS_LAYER_SUPPORT
 
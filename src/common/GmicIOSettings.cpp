@@ -13,13 +13,23 @@
 #include "GmicIOSettings.h"
 #include "FileIO.h"
 #include "boost/endian.hpp"
+#include <algorithm>
 #include <vector>
 
 namespace
 {
+    // Version 2 adds the selection export settings.
+    // Version 3 adds the output resampling setting.
+    // Version 4 adds the reduced precision export setting.
+    // Version 5 adds the output file format setting.
+    constexpr int32 IOSettingsFileVersion = 5;
+
+    // The largest number of pixels that can be added around the selection.
+    constexpr int32 MaxSelectionMargin = 1024;
+
     struct IOSettingsFileHeader
     {
-        IOSettingsFileHeader() : version(1), reserved()
+        IOSettingsFileHeader() : version(IOSettingsFileVersion), reserved()
         {
             // G8IS = GMIC 8BF I/O settings
             signature[0] = 'G';
@@ -110,10 +120,68 @@ namespace
 
         WriteFile(fileHandle, &source, sizeof(source));
     }
+
+    void ReadOutputFileFormatValue(FileHandle* fileHandle, OutputFileFormat& value)
+    {
+        value = OutputFileFormat::Default;
+
+        boost::endian::little_uint32_t format{};
+
+        ReadFile(fileHandle, &format, sizeof(format));
+
+        constexpr uint32_t firstValue = static_cast<uint32_t>(OutputFileFormat::Default);
+        constexpr uint32_t lastValue = static_cast<uint32_t>(OutputFileFormat::Qoi);
+
+        if (format >= firstValue && format <= lastValue)
+        {
+            value = static_cast<OutputFileFormat>(static_cast<uint32_t>(format));
+        }
+    }
+
+    void WriteOutputFileFormatValue(FileHandle* fileHandle, OutputFileFormat value)
+    {
+        boost::endian::little_uint32_t format = static_cast<uint32_t>(value);
+
+        WriteFile(fileHandle, &format, sizeof(format));
+    }
+
+    void ReadBooleanValue(FileHandle* fileHandle, bool& value)
+    {
+        boost::endian::little_uint32_t integerValue{};
+
+        ReadFile(fileHandle, &integerValue, sizeof(integerValue));
+
+        value = integerValue != 0;
+    }
+
+    void WriteBooleanValue(FileHandle* fileHandle, bool value)
+    {
+        boost::endian::little_uint32_t integerValue = value ? 1 : 0;
+
+        WriteFile(fileHandle, &integerValue, sizeof(integerValue));
+    }
+
+    void ReadSelectionMarginValue(FileHandle* fileHandle, int32& value)
+    {
+        boost::endian::little_int32_t margin{};
+
+        ReadFile(fileHandle, &margin, sizeof(margin));
+
+        value = ::std::min(::std::max(static_cast<int32>(margin), 0), MaxSelectionMargin);
+    }
+
+    void WriteSelectionMarginValue(FileHandle* fileHandle, int32 value)
+    {
+        boost::endian::little_int32_t margin = value;
+
+        WriteFile(fileHandle, &margin, sizeof(margin));
+    }
 }
 
 GmicIOSettings::GmicIOSettings()
-    : defaultOutputPath(), secondInputImageSource(SecondInputImageSource::None), secondInputImagePath()
+    : defaultOutputPath(), secondInputImageSource(SecondInputImageSource::None), secondInputImagePath(),
+      exportSelectionOnly(false), selectionMargin(0), resampleOutputToDocument(false),
+      reducedPrecisionExport(false), outputFileFormat(OutputFileFormat::Default)
 {
 }
 
@@ -136,6 +204,31 @@ boost::filesystem::path GmicIOSettings::GetSecondInputImagePath() const
     return secondInputImagePath;
 }
 
+bool GmicIOSettings::GetExportSelectionOnly() const
+{
+    return exportSelectionOnly;
+}
+
+int32 GmicIOSettings::GetSelectionMargin() const
+{
+    return selectionMargin;
+}
+
+bool GmicIOSettings::GetResampleOutputToDocument() const
+{
+    return resampleOutputToDocument;
+}
+
+bool GmicIOSettings::GetReducedPrecisionExport() const
+{
+    return reducedPrecisionExport;
+}
+
+OutputFileFormat GmicIOSettings::GetOutputFileFormat() const
+{
+    return outputFileFormat;
+}
+
 void GmicIOSettings::SetDefaultOutputPath(const boost::filesystem::path& path)
 {
     defaultOutputPath = path;
@@ -151,6 +244,31 @@ void GmicIOSettings::SetSecondInputImagePath(const boost::filesystem::path& path
     secondInputImagePath = path;
 }
 
+void GmicIOSettings::SetExportSelectionOnly(bool value)
+{
+    exportSelectionOnly = value;
+}
+
+void GmicIOSettings::SetSelectionMargin(int32 value)
+{
+    selectionMargin = ::std::min(::std::max(value, 0), MaxSelectionMargin);
+}
+
+void GmicIOSettings::SetResampleOutputToDocument(bool value)
+{
+    resampleOutputToDocument = value;
+}
+
+void GmicIOSettings::SetReducedPrecisionExport(bool value)
+{
+    reducedPrecisionExport = value;
+}
+
+void GmicIOSettings::SetOutputFileFormat(OutputFileFormat value)
+{
+    outputFileFormat = value;
+}
+
 void GmicIOSettings::Load(const boost::filesystem::path& path)
 {
     if (boost::filesystem::exists(path))
@@ -165,7 +283,7 @@ void GmicIOSettings::Load(const boost::filesystem::path& path)
             throw ::std::runtime_error("The setting file has an incorrect signature.");
         }
 
-        if (header.version != 1)
+        if (header.version < 1 || header.version > IOSettingsFileVersion)
         {
             throw ::std::runtime_error("The setting file has an unknown version.");
         }
@@ -175,6 +293,27 @@ void GmicIOSettings::Load(const boost::filesystem::path& path)
         ReadSecondInputImageSourceValue(file.get(), secondInputImageSource);
 
         ReadFilePath(file.get(), secondInputImagePath);
+
+        if (header.version >= 2)
+        {
+            ReadBooleanValue(file.get(), exportSelectionOnly);
+            ReadSelectionMarginValue(file.get(), selectionMargin);
+        }
+
+        if (header.version >= 3)
+        {
+            ReadBooleanValue(file.get(), resampleOutputToDocument);
+        }
+
+        if (header.version >= 4)
+        {
+            ReadBooleanValue(file.get(), reducedPrecisionExport);
+        }
+
+        if (header.version >= 5)
+        {
+            ReadOutputFileFormatValue(file.get(), outputFileFormat);
+        }
     }
 }
 
@@ -189,4 +328,9 @@ void GmicIOSettings::Save(const boost::filesystem::path& path)
     WriteFilePath(file.get(), defaultOutputPath);
     WriteSecondInputImageSourceValue(file.get(), secondInputImageSource);
     WriteFilePath(file.get(), secondInputImagePath);
+    WriteBooleanValue(file.get(), exportSelectionOnly);
+    WriteSelectionMarginValue(file.get(), selectionMargin);
+    WriteBooleanValue(file.get(), resampleOutputToDocument);
+    WriteBooleanValue(file.get(), reducedPrecisionExport);
+    WriteOutputFileFormatValue(file.get(), outputFileFormat);
 }
@@ -24,6 +24,17 @@ enum class SecondInputImageSource : uint32_t
     File = 2
 };
 
+// The file format used for the G'MIC-Qt output images that are not written back to the document.
+enum class OutputFileFormat : uint32_t
+{
+    // PNG for 8-bit and 16-bit images, OpenEXR for 32-bit images.
+    Default = 0,
+    TiffUncompressed = 1,
+    TiffDeflate = 2,
+    // QOI for 8-bit images, the other bit depths use the default format.
+    Qoi = 3
+};
+
 class GmicIOSettings
 {
 public:
@@ -37,12 +48,32 @@ public:
 
     boost::filesystem::path GetSecondInputImagePath() const;
 
+    bool GetExportSelectionOnly() const;
+
+    int32 GetSelectionMargin() const;
+
+    bool GetResampleOutputToDocument() const;
+
+    bool GetReducedPrecisionExport() const;
+
+    OutputFileFormat GetOutputFileFormat() const;
+
     void SetDefaultOutputPath(const boost::filesystem::path& path);
 
     void SetSecondInputImageSource(SecondInputImageSource source);
 
     void SetSecondInputImagePath(const boost::filesystem::path& filePath);
 
+    void SetExportSelectionOnly(bool value);
+
+    void SetSelectionMargin(int32 value);
+
+    void SetResampleOutputToDocument(bool value);
+
+    void SetReducedPrecisionExport(bool value);
+
+    void SetOutputFileFormat(OutputFileFormat value);
+
     void Load(const boost::filesystem::path& path);
 
     void Save(const boost::filesystem::path& path);
@@ -52,6 +83,11 @@ private:
     boost::filesystem::path defaultOutputPath;
     SecondInputImageSource secondInputImageSource;
     boost::filesystem::path secondInputImagePath;
+    bool exportSelectionOnly;
+    int32 selectionMargin;
+    bool resampleOutputToDocument;
+    bool reducedPrecisionExport;
+    OutputFileFormat outputFileFormat;
 };
 
 #endif // !GMICOUTPUTSETTINGS_H
@@ -12,13 +12,18 @@
 
 #include "stdafx.h"
 #include "GmicPlugin.h"
+#include "BackgroundImageWriter.h"
+#include "BufferPool.h"
 #include "GmicIOSettings.h"
 #include <vector>
 #include "FileUtil.h"
 #include "Memory.h"
+#include "MemoryUsage.h"
+#include "ParallelFor.h"
 #include "resource.h"
 #include "Utilities.h"
 #include "version.h"
+#include <algorithm>
 #include <stdexcept>
 
 OSErr DoParameters(FilterRecord* filterRecord);
@@ -256,8 +261,11 @@ OSErr DoPrepare(FilterRecord* filterRecord) noexcept
     OSErr err = noErr;
 
     // Take half of the available space.
+    const int32 pluginSpace = filterRecord->maxSpace - (filterRecord->maxSpace / 2);
     filterRecord->maxSpace /= 2;
 
+    SetMemoryBudget(static_cast<uint64_t>(::std::max(pluginSpace, 0)));
+
     if (filterRecord->parameters == nullptr)
     {
         if (HostMeetsRequirements(filterRecord))
@@ -315,8 +323,20 @@ OSErr DoStart(FilterRecord* filterRecord)
 
     OSErr err = CanProcessDocument(filterRecord);
 
+    ResetPeakMemoryUsage();
+
     if (err == noErr)
     {
+        // Resume the output image saves that were interrupted when the host exited, and
+        // report any output images from the previous run that could not be saved.
+        ResumeBackgroundImageSaves();
+        ShowBackgroundImageSaveErrors(filterRecord);
+
+        // The tile buffers are reused by all of the layer, plane and output conversion loops.
+        BufferPoolSession bufferPoolSession(filterRecord);
+        // The worker threads run the image kernels on the pixels of the large host requests.
+        WorkerThreadPoolSession workerThreadPoolSession;
+
         GmicIOSettings settings;
 
         // Try to load the settings file, if present.
@@ -341,6 +361,7 @@ OSErr DoStart(FilterRecord* filterRecord)
             boost::filesystem::path gmicParametersFilePath;
 
             const int32 hostBitDepth = GetImageDepth(filterRecord);
+            const bool showFullUI = ShowUI(filterRecord);
 
             err = WriteGmicFiles(
                 inputDir,
@@ -348,13 +369,13 @@ OSErr DoStart(FilterRecord* filterRecord)
                 gmicParametersFilePath,
                 filterRecord,
                 hostBitDepth,
-                settings);
+                settings,
+                showFullUI);
             DebugOut("After WriteGmicFiles err=%d", err);
+            TraceMemoryUsage("WriteGmicFiles");
 
             if (err == noErr)
             {
-                const bool showFullUI = ShowUI(filterRecord);
-
                 err = ShowGmicUI(
                     indexFilePath,
                     outputDir,
@@ -373,6 +394,7 @@ OSErr DoStart(FilterRecord* filterRecord)
                         hostBitDepth,
                         settings);
                     DebugOut("After ReadGmicOutput err=%d", err);
+                    TraceMemoryUsage("ReadGmicOutput");
                 }
             }
         }
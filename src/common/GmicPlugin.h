@@ -51,7 +51,8 @@ OSErr WriteGmicFiles(
     boost::filesystem::path& gmicParametersFilePath,
     FilterRecord* filterRecord,
     const int32& hostBitDepth,
-    const GmicIOSettings& settings);
+    const GmicIOSettings& settings,
+    bool showFullUI);
 
 constexpr Fixed int2fixed(int value)
 {
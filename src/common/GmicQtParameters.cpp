@@ -445,6 +445,38 @@ boost::filesystem::path GmicQtParameters::PrependGmicCommandName(const boost::fi
     }
 }
 
+GmicQtInputMode GmicQtParameters::GetInputMode() const
+{
+    // These names must match the input mode names that G'MIC-Qt stores in the filter parameters.
+    // The "Active and Above" and "Active and Below" modes are reported as unknown, which makes
+    // the plug-in export all of the layers.
+
+    if (inputMode == "No Input")
+    {
+        return GmicQtInputMode::NoInput;
+    }
+    else if (inputMode == "Active Layer")
+    {
+        return GmicQtInputMode::ActiveLayer;
+    }
+    else if (inputMode == "All Layers")
+    {
+        return GmicQtInputMode::AllLayers;
+    }
+    else if (inputMode == "All Visible")
+    {
+        return GmicQtInputMode::AllVisibleLayers;
+    }
+    else if (inputMode == "All Invisible")
+    {
+        return GmicQtInputMode::AllHiddenLayers;
+    }
+    else
+    {
+        return GmicQtInputMode::Unknown;
+    }
+}
+
 bool GmicQtParameters::IsValid() const
 {
     return !command.empty();
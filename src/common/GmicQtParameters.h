@@ -19,6 +19,17 @@
 #include <string>
 #include <boost/filesystem.hpp>
 
+// The G'MIC-Qt input layer modes that the plug-in can use to limit the exported layers.
+enum class GmicQtInputMode
+{
+    Unknown = 0,
+    NoInput,
+    ActiveLayer,
+    AllLayers,
+    AllVisibleLayers,
+    AllHiddenLayers
+};
+
 class GmicQtParameters
 {
 public:
@@ -31,6 +42,8 @@ public:
 
     boost::filesystem::path PrependGmicCommandName(const boost::filesystem::path& originalFileName);
 
+    GmicQtInputMode GetInputMode() const;
+
     bool IsValid() const;
 
     void SaveToDescriptor(FilterRecordPtr filterRecord) const;
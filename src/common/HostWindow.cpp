@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "HostWindow.h"
+#include <algorithm>
+
+namespace
+{
+    // The number of rows in each band, this keeps the rows that a thread is
+    // working on in the processor cache.
+    constexpr int32 RowBandHeight = 64;
+}
+
+TileMaskOccupancy GetHostWindowTiles(
+    const VRect& window,
+    int32 tileWidth,
+    int32 tileHeight,
+    const MaskOccupancyMap& maskOccupancyMap,
+    ::std::vector<HostWindowTile>& tiles)
+{
+    tiles.clear();
+
+    int32 slot = 0;
+
+    for (int32 y = window.top; y < window.bottom; y += tileHeight)
+    {
+        for (int32 x = window.left; x < window.right; x += tileWidth)
+        {
+            const TileMaskOccupancy maskOccupancy = maskOccupancyMap.GetTileOccupancy(x, y);
+
+            if (maskOccupancy != TileMaskOccupancy::Unselected)
+            {
+                HostWindowTile tile{};
+                tile.left = x - window.left;
+                tile.top = y - window.top;
+                tile.columnCount = ::std::min(tileWidth, window.right - x);
+                tile.rowCount = ::std::min(tileHeight, window.bottom - y);
+                tile.slot = slot;
+                tile.maskOccupancy = maskOccupancy;
+
+                tiles.push_back(tile);
+            }
+
+            slot++;
+        }
+    }
+
+    return GetHostWindowMaskOccupancy(tiles);
+}
+
+TileMaskOccupancy GetHostWindowMaskOccupancy(const ::std::vector<HostWindowTile>& tiles)
+{
+    if (tiles.empty())
+    {
+        return TileMaskOccupancy::Unselected;
+    }
+
+    for (const HostWindowTile& tile : tiles)
+    {
+        if (tile.maskOccupancy == TileMaskOccupancy::PartiallySelected)
+        {
+            return TileMaskOccupancy::PartiallySelected;
+        }
+    }
+
+    return TileMaskOccupancy::Selected;
+}
+
+void GetHostWindowRowBands(const ::std::vector<HostWindowTile>& tiles, ::std::vector<HostWindowRowBand>& bands)
+{
+    bands.clear();
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        for (int32 row = 0; row < tiles[i].rowCount; row += RowBandHeight)
+        {
+            HostWindowRowBand band{};
+            band.tile = static_cast<int32>(i);
+            band.firstRow = row;
+            band.rowCount = ::std::min(RowBandHeight, tiles[i].rowCount - row);
+
+            bands.push_back(band);
+        }
+    }
+}
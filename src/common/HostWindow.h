@@ -0,0 +1,56 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef HOSTWINDOW_H
+#define HOSTWINDOW_H
+
+#include "MaskOccupancyMap.h"
+#include <vector>
+
+// A tile of the image that is part of a host request window.
+struct HostWindowTile
+{
+    // The tile position relative to the top left of the window.
+    int32 left;
+    int32 top;
+    int32 columnCount;
+    int32 rowCount;
+    // The position of the tile in the window, this is used to index the tile buffers.
+    int32 slot;
+    TileMaskOccupancy maskOccupancy;
+};
+
+// A band of rows in one of the window tiles, the bands are the work items
+// of the kernels that run in parallel.
+struct HostWindowRowBand
+{
+    int32 tile;
+    int32 firstRow;
+    int32 rowCount;
+};
+
+// Gets the tiles in the window that are at least partially selected, the window
+// must start on a tile boundary. Returns the mask occupancy of the whole window.
+TileMaskOccupancy GetHostWindowTiles(
+    const VRect& window,
+    int32 tileWidth,
+    int32 tileHeight,
+    const MaskOccupancyMap& maskOccupancyMap,
+    ::std::vector<HostWindowTile>& tiles);
+
+// Gets the mask occupancy of a window that contains the specified tiles.
+TileMaskOccupancy GetHostWindowMaskOccupancy(const ::std::vector<HostWindowTile>& tiles);
+
+// Splits the window tiles into bands of rows.
+void GetHostWindowRowBands(const ::std::vector<HostWindowTile>& tiles, ::std::vector<HostWindowRowBand>& bands);
+
+#endif // !HOSTWINDOW_H
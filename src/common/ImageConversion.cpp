@@ -11,6 +11,7 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "ImageConversion.h"
+#include "PngReader.h"
 
 #ifdef __PIWin__
 #include "ImageConversionWin.h"
@@ -23,6 +24,16 @@ void ConvertImageToGmicInputFormat(
     ::std::unique_ptr<InputLayerInfo>& output,
     bool ignoreFileNotFound)
 {
+    // PNG images are decoded with libpng, which allows the image to be streamed to the
+    // G'MIC-Qt input file in strips. The platform decoder handles the other formats and
+    // reports any file not found errors.
+    boost::system::error_code ec;
+
+    if (boost::filesystem::is_regular_file(input, ec) && TryConvertPngImageToGmicInputFormat(input, output))
+    {
+        return;
+    }
+
     ConvertImageToGmicInputFormatNative(input, output, ignoreFileNotFound);
 }
 
@@ -31,5 +42,10 @@ void ConvertImageToGmicInputFormat(
     size_t inputLength,
     ::std::unique_ptr<InputLayerInfo>& output)
 {
+    if (TryConvertPngImageToGmicInputFormat(input, inputLength, output))
+    {
+        return;
+    }
+
     ConvertImageToGmicInputFormatNative(input, inputLength, output);
 }
@@ -0,0 +1,580 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "ImageResampler.h"
+#include "BufferPool.h"
+#include "FileIO.h"
+#include "Gmic8bfImageHeader.h"
+#include "Gmic8bfImageTileTable.h"
+#include "TilePlanner.h"
+#include <boost/core/noncopyable.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGERESAMPLER_USE_SSE2 1
+#else
+#define IMAGERESAMPLER_USE_SSE2 0
+#endif
+
+namespace
+{
+    constexpr double LanczosRadius = 3.0;
+
+    double Lanczos3(double x)
+    {
+        constexpr double pi = 3.14159265358979323846;
+
+        if (x == 0.0)
+        {
+            return 1.0;
+        }
+
+        if (x <= -LanczosRadius || x >= LanczosRadius)
+        {
+            return 0.0;
+        }
+
+        const double piX = pi * x;
+
+        return (LanczosRadius * ::std::sin(piX) * ::std::sin(piX / LanczosRadius)) / (piX * piX);
+    }
+
+    // The source pixels and normalized filter weights used for each output pixel on one axis.
+    struct FilterContributions
+    {
+        ::std::vector<int32> start;
+        ::std::vector<int32> count;
+        // The weights for each output pixel are stored at a stride of maxTaps.
+        ::std::vector<float> weights;
+        int32 maxTaps;
+    };
+
+    FilterContributions ComputeFilterContributions(int32 sourceSize, int32 destinationSize)
+    {
+        const double scale = static_cast<double>(destinationSize) / static_cast<double>(sourceSize);
+        // When downsampling the filter is stretched to cover all of the source pixels.
+        const double filterScale = ::std::max(1.0, 1.0 / scale);
+        const double support = LanczosRadius * filterScale;
+
+        FilterContributions contributions;
+        contributions.maxTaps = static_cast<int32>(::std::ceil(support * 2.0)) + 1;
+        contributions.start.resize(static_cast<size_t>(destinationSize));
+        contributions.count.resize(static_cast<size_t>(destinationSize));
+        contributions.weights.resize(static_cast<size_t>(destinationSize) * static_cast<size_t>(contributions.maxTaps));
+
+        for (int32 i = 0; i < destinationSize; i++)
+        {
+            const double center = (static_cast<double>(i) + 0.5) / scale;
+
+            const int32 left = ::std::max(static_cast<int32>(::std::floor(center - support)), 0);
+            const int32 right = ::std::min(static_cast<int32>(::std::ceil(center + support)), sourceSize);
+            const int32 count = ::std::max(::std::min(right - left, contributions.maxTaps), 1);
+
+            float* weights = &contributions.weights[static_cast<size_t>(i) * contributions.maxTaps];
+            double total = 0.0;
+
+            for (int32 j = 0; j < count; j++)
+            {
+                const double weight = Lanczos3((static_cast<double>(left + j) + 0.5 - center) / filterScale);
+
+                weights[j] = static_cast<float>(weight);
+                total += weight;
+            }
+
+            if (total != 0.0)
+            {
+                for (int32 j = 0; j < count; j++)
+                {
+                    weights[j] = static_cast<float>(weights[j] / total);
+                }
+            }
+
+            contributions.start[i] = ::std::min(left, sourceSize - 1);
+            contributions.count[i] = ::std::min(count, sourceSize - contributions.start[i]);
+        }
+
+        return contributions;
+    }
+
+    float GetMaxChannelValue(int32 bitsPerChannel)
+    {
+        switch (bitsPerChannel)
+        {
+        case 8:
+            return 255.0f;
+        case 16:
+            return 65535.0f;
+        case 32:
+            return 1.0f;
+        default:
+            throw ::std::runtime_error("Unsupported bit depth.");
+        }
+    }
+
+    void ConvertChannelsToFloat(
+        const uint8* source,
+        float* destination,
+        size_t count,
+        size_t destinationStride,
+        int32 bitsPerChannel)
+    {
+        switch (bitsPerChannel)
+        {
+        case 8:
+            for (size_t i = 0; i < count; i++)
+            {
+                destination[i * destinationStride] = static_cast<float>(source[i]);
+            }
+            break;
+        case 16:
+        {
+            const uint16* src = reinterpret_cast<const uint16*>(source);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                destination[i * destinationStride] = static_cast<float>(src[i]);
+            }
+            break;
+        }
+        case 32:
+        {
+            const float* src = reinterpret_cast<const float*>(source);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                destination[i * destinationStride] = src[i];
+            }
+            break;
+        }
+        default:
+            throw ::std::runtime_error("Unsupported bit depth.");
+        }
+    }
+
+    // Reads the source image in bands of one tile row and provides the rows in an
+    // interleaved float format, the color channels are premultiplied by the alpha
+    // channel to prevent the filter from bleeding the color of transparent pixels.
+    class SourceRowReader : private boost::noncopyable
+    {
+    public:
+        SourceRowReader(FileHandle* file, const Gmic8bfImageHeader& header)
+            : file(file),
+              width(header.GetWidth()),
+              height(header.GetHeight()),
+              numberOfChannels(header.GetNumberOfChannels()),
+              bitsPerChannel(header.GetBitsPerChannel()),
+              tileWidth(header.GetTileWidth()),
+              tileHeight(header.GetTileHeight()),
+              planar(header.IsPlanar()),
+              hasAlphaChannel(header.HasAlphaChannel()),
+              maxChannelValue(GetMaxChannelValue(header.GetBitsPerChannel())),
+              imageDataOffset(GetFilePosition(file)),
+              bandTop(0),
+              bandRowCount(0)
+        {
+            const size_t bytesPerChannel = static_cast<size_t>(bitsPerChannel / 8);
+            const size_t rowChannelCount = static_cast<size_t>(width) * static_cast<size_t>(numberOfChannels);
+
+            if (planar)
+            {
+                tileTable.reset(new Gmic8bfImageTileTable(file, header));
+            }
+
+            rawBand = AcquirePooledBuffer(rowChannelCount * static_cast<size_t>(tileHeight) * bytesPerChannel);
+            floatBand = AcquirePooledBuffer(rowChannelCount * static_cast<size_t>(tileHeight) * sizeof(float));
+        }
+
+        int32 GetNumberOfChannels() const
+        {
+            return numberOfChannels;
+        }
+
+        const float* GetRow(int32 y)
+        {
+            if (y < bandTop || y >= (bandTop + bandRowCount))
+            {
+                LoadBand((y / tileHeight) * tileHeight);
+            }
+
+            const size_t rowChannelCount = static_cast<size_t>(width) * static_cast<size_t>(numberOfChannels);
+
+            return static_cast<const float*>(floatBand.data()) + (static_cast<size_t>(y - bandTop) * rowChannelCount);
+        }
+
+    private:
+        void LoadBand(int32 top)
+        {
+            const int32 rowCount = ::std::min(tileHeight, height - top);
+            const size_t bytesPerChannel = static_cast<size_t>(bitsPerChannel / 8);
+            const size_t rowChannelCount = static_cast<size_t>(width) * static_cast<size_t>(numberOfChannels);
+
+            uint8* const raw = static_cast<uint8*>(rawBand.data());
+            float* const rows = static_cast<float*>(floatBand.data());
+
+            if (planar)
+            {
+                for (int32 channel = 0; channel < numberOfChannels; channel++)
+                {
+                    for (int32 x = 0; x < width; x += tileWidth)
+                    {
+                        const int32 columnCount = ::std::min(tileWidth, width - x);
+
+                        // The tile offsets are read from the tile table.
+                        tileTable->ReadTile(
+                            file,
+                            tileTable->GetTileIndex(channel, x, top),
+                            raw,
+                            static_cast<size_t>(columnCount) * static_cast<size_t>(rowCount));
+
+                        const uint8* source = raw;
+
+                        for (int32 y = 0; y < rowCount; y++)
+                        {
+                            float* destination = rows + (static_cast<size_t>(y) * rowChannelCount) + (static_cast<size_t>(x) * numberOfChannels) + channel;
+
+                            ConvertChannelsToFloat(source, destination, static_cast<size_t>(columnCount), static_cast<size_t>(numberOfChannels), bitsPerChannel);
+
+                            source += static_cast<size_t>(columnCount) * bytesPerChannel;
+                        }
+                    }
+                }
+            }
+            else
+            {
+                SetFilePosition(
+                    file,
+                    imageDataOffset + (static_cast<int64>(top) * static_cast<int64>(rowChannelCount) * static_cast<int64>(bytesPerChannel)));
+
+                ReadFile(file, raw, static_cast<size_t>(rowCount) * rowChannelCount * bytesPerChannel);
+
+                const uint8* source = raw;
+
+                for (int32 x = 0; x < width; x += tileWidth)
+                {
+                    const size_t tileRowChannelCount = static_cast<size_t>(::std::min(tileWidth, width - x)) * numberOfChannels;
+
+                    for (int32 y = 0; y < rowCount; y++)
+                    {
+                        float* destination = rows + (static_cast<size_t>(y) * rowChannelCount) + (static_cast<size_t>(x) * numberOfChannels);
+
+                        ConvertChannelsToFloat(source, destination, tileRowChannelCount, 1, bitsPerChannel);
+
+                        source += tileRowChannelCount * bytesPerChannel;
+                    }
+                }
+            }
+
+            if (hasAlphaChannel)
+            {
+                const int32 alphaIndex = numberOfChannels - 1;
+                const float alphaScale = 1.0f / maxChannelValue;
+
+                for (size_t i = 0, count = static_cast<size_t>(rowCount) * width; i < count; i++)
+                {
+                    float* pixel = rows + (i * numberOfChannels);
+                    const float alpha = pixel[alphaIndex] * alphaScale;
+
+                    for (int32 channel = 0; channel < alphaIndex; channel++)
+                    {
+                        pixel[channel] *= alpha;
+                    }
+                }
+            }
+
+            bandTop = top;
+            bandRowCount = rowCount;
+        }
+
+        FileHandle* file;
+        const int32 width;
+        const int32 height;
+        const int32 numberOfChannels;
+        const int32 bitsPerChannel;
+        const int32 tileWidth;
+        const int32 tileHeight;
+        const bool planar;
+        const bool hasAlphaChannel;
+        const float maxChannelValue;
+        const int64 imageDataOffset;
+        int32 bandTop;
+        int32 bandRowCount;
+        ::std::unique_ptr<Gmic8bfImageTileTable> tileTable;
+        PooledBuffer rawBand;
+        PooledBuffer floatBand;
+    };
+
+    void ResampleRowHorizontal(
+        const float* source,
+        float* destination,
+        int32 numberOfChannels,
+        const FilterContributions& contributions)
+    {
+        const int32 destinationWidth = static_cast<int32>(contributions.start.size());
+
+        for (int32 x = 0; x < destinationWidth; x++)
+        {
+            const float* weights = &contributions.weights[static_cast<size_t>(x) * contributions.maxTaps];
+            const float* src = source + (static_cast<size_t>(contributions.start[x]) * numberOfChannels);
+            const int32 count = contributions.count[x];
+            float* dst = destination + (static_cast<size_t>(x) * numberOfChannels);
+
+#if IMAGERESAMPLER_USE_SSE2
+            if (numberOfChannels == 4)
+            {
+                __m128 total = _mm_setzero_ps();
+
+                for (int32 i = 0; i < count; i++)
+                {
+                    total = _mm_add_ps(total, _mm_mul_ps(_mm_loadu_ps(src + (static_cast<size_t>(i) * 4)), _mm_set1_ps(weights[i])));
+                }
+
+                _mm_storeu_ps(dst, total);
+                continue;
+            }
+#endif // IMAGERESAMPLER_USE_SSE2
+
+            float total[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            for (int32 i = 0; i < count; i++)
+            {
+                const float weight = weights[i];
+
+                for (int32 channel = 0; channel < numberOfChannels; channel++)
+                {
+                    total[channel] += src[(static_cast<size_t>(i) * numberOfChannels) + channel] * weight;
+                }
+            }
+
+            for (int32 channel = 0; channel < numberOfChannels; channel++)
+            {
+                dst[channel] = total[channel];
+            }
+        }
+    }
+
+    // Adds a weighted row to the accumulated output row.
+    void AccumulateWeightedRow(float* destination, const float* source, float weight, size_t count)
+    {
+        size_t i = 0;
+
+#if IMAGERESAMPLER_USE_SSE2
+        const __m128 weights = _mm_set1_ps(weight);
+
+        for (; (i + 4) <= count; i += 4)
+        {
+            _mm_storeu_ps(destination + i, _mm_add_ps(_mm_loadu_ps(destination + i), _mm_mul_ps(_mm_loadu_ps(source + i), weights)));
+        }
+#endif // IMAGERESAMPLER_USE_SSE2
+
+        for (; i < count; i++)
+        {
+            destination[i] += source[i] * weight;
+        }
+    }
+
+    template <typename T>
+    T ConvertFloatToChannel(float value, float maxChannelValue)
+    {
+        return static_cast<T>(::std::min(::std::max(value, 0.0f), maxChannelValue) + 0.5f);
+    }
+
+    template <>
+    float ConvertFloatToChannel<float>(float value, float maxChannelValue)
+    {
+        (void)maxChannelValue;
+
+        return value;
+    }
+
+    template <typename T>
+    void WriteOutputRowToStrip(
+        float* row,
+        int32 width,
+        int32 numberOfChannels,
+        bool hasAlphaChannel,
+        float maxChannelValue,
+        uint8* stripScan0,
+        size_t planeStripSize,
+        int32 stripRow)
+    {
+        const int32 alphaIndex = hasAlphaChannel ? numberOfChannels - 1 : -1;
+
+        for (int32 x = 0; x < width; x++)
+        {
+            float* pixel = row + (static_cast<size_t>(x) * numberOfChannels);
+
+            if (hasAlphaChannel)
+            {
+                const float alpha = ::std::min(::std::max(pixel[alphaIndex], 0.0f), maxChannelValue);
+                // Convert the color channels back to straight alpha.
+                const float colorScale = alpha > 0.0f ? maxChannelValue / alpha : 0.0f;
+
+                for (int32 channel = 0; channel < alphaIndex; channel++)
+                {
+                    pixel[channel] *= colorScale;
+                }
+
+                pixel[alphaIndex] = alpha;
+            }
+        }
+
+        for (int32 channel = 0; channel < numberOfChannels; channel++)
+        {
+            T* destination = reinterpret_cast<T*>(stripScan0 + (planeStripSize * channel)) + (static_cast<size_t>(stripRow) * width);
+            const float* source = row + channel;
+
+            for (int32 x = 0; x < width; x++)
+            {
+                destination[x] = ConvertFloatToChannel<T>(*source, maxChannelValue);
+                source += numberOfChannels;
+            }
+        }
+    }
+}
+
+void ResampleGmic8bfImage(
+    const boost::filesystem::path& inputPath,
+    const boost::filesystem::path& outputPath,
+    int32 outputWidth,
+    int32 outputHeight)
+{
+    if (outputWidth <= 0 || outputHeight <= 0)
+    {
+        throw ::std::runtime_error("The resampled image size must be positive.");
+    }
+
+    ::std::unique_ptr<FileHandle> inputFile = OpenFile(inputPath, FileOpenMode::Read);
+    const Gmic8bfImageHeader inputHeader(inputFile.get());
+
+    const int32 inputWidth = inputHeader.GetWidth();
+    const int32 inputHeight = inputHeader.GetHeight();
+    const int32 numberOfChannels = inputHeader.GetNumberOfChannels();
+    const int32 bitsPerChannel = inputHeader.GetBitsPerChannel();
+    const bool hasAlphaChannel = inputHeader.HasAlphaChannel();
+    const float maxChannelValue = GetMaxChannelValue(bitsPerChannel);
+    const size_t bytesPerChannel = static_cast<size_t>(bitsPerChannel / 8);
+
+    if (numberOfChannels < 1 || numberOfChannels > 4)
+    {
+        throw ::std::runtime_error("Unsupported Gmic8bfImage channel count.");
+    }
+
+    SourceRowReader sourceReader(inputFile.get(), inputHeader);
+
+    const FilterContributions horizontal = ComputeFilterContributions(inputWidth, outputWidth);
+    const FilterContributions vertical = ComputeFilterContributions(inputHeight, outputHeight);
+
+    const size_t outputRowChannelCount = static_cast<size_t>(outputWidth) * static_cast<size_t>(numberOfChannels);
+
+    // The horizontally resampled source rows are kept in a ring buffer that holds
+    // the rows used by the vertical filter for the current output row.
+    const int32 ringCapacity = vertical.maxTaps;
+    PooledBuffer ringBuffer = AcquirePooledBuffer(outputRowChannelCount * static_cast<size_t>(ringCapacity) * sizeof(float));
+    float* const ringScan0 = static_cast<float*>(ringBuffer.data());
+
+    PooledBuffer outputRowBuffer = AcquirePooledBuffer(outputRowChannelCount * sizeof(float));
+    float* const outputRow = static_cast<float*>(outputRowBuffer.data());
+
+    const TileGeometry stripGeometry = PlanBufferStripGeometry(
+        outputWidth,
+        outputHeight,
+        numberOfChannels * static_cast<int32>(bytesPerChannel),
+        __FUNCTION__);
+
+    const size_t planeStripSize = static_cast<size_t>(outputWidth) * static_cast<size_t>(stripGeometry.height) * bytesPerChannel;
+    PooledBuffer stripBuffer = AcquirePooledBuffer(planeStripSize * static_cast<size_t>(numberOfChannels));
+    uint8* const stripScan0 = static_cast<uint8*>(stripBuffer.data());
+
+    const Gmic8bfImageHeader outputHeader(
+        outputWidth,
+        outputHeight,
+        numberOfChannels,
+        bitsPerChannel,
+        /* planar */ true,
+        outputWidth,
+        stripGeometry.height);
+
+    const int64 outputPlaneSize = static_cast<int64>(outputWidth) * outputHeight * static_cast<int64>(bytesPerChannel);
+
+    ::std::unique_ptr<FileHandle> outputFile = OpenFile(
+        outputPath,
+        FileOpenMode::Write,
+        static_cast<int64>(sizeof(outputHeader)) + (outputPlaneSize * numberOfChannels));
+
+    WriteFile(outputFile.get(), &outputHeader, sizeof(outputHeader));
+
+    const int64 outputDataOffset = GetFilePosition(outputFile.get());
+
+    int32 nextSourceRow = 0;
+
+    for (int32 stripTop = 0; stripTop < outputHeight; stripTop += stripGeometry.height)
+    {
+        const int32 stripRowCount = ::std::min(stripGeometry.height, outputHeight - stripTop);
+
+        for (int32 stripRow = 0; stripRow < stripRowCount; stripRow++)
+        {
+            const int32 y = stripTop + stripRow;
+            const int32 start = vertical.start[y];
+            const int32 count = vertical.count[y];
+            const float* weights = &vertical.weights[static_cast<size_t>(y) * vertical.maxTaps];
+
+            while (nextSourceRow < (start + count))
+            {
+                float* ringRow = ringScan0 + (static_cast<size_t>(nextSourceRow % ringCapacity) * outputRowChannelCount);
+
+                ResampleRowHorizontal(sourceReader.GetRow(nextSourceRow), ringRow, numberOfChannels, horizontal);
+
+                nextSourceRow++;
+            }
+
+            ::std::memset(outputRow, 0, outputRowChannelCount * sizeof(float));
+
+            for (int32 i = 0; i < count; i++)
+            {
+                const float* ringRow = ringScan0 + (static_cast<size_t>((start + i) % ringCapacity) * outputRowChannelCount);
+
+                AccumulateWeightedRow(outputRow, ringRow, weights[i], outputRowChannelCount);
+            }
+
+            switch (bitsPerChannel)
+            {
+            case 8:
+                WriteOutputRowToStrip<uint8>(outputRow, outputWidth, numberOfChannels, hasAlphaChannel, maxChannelValue, stripScan0, planeStripSize, stripRow);
+                break;
+            case 16:
+                WriteOutputRowToStrip<uint16>(outputRow, outputWidth, numberOfChannels, hasAlphaChannel, maxChannelValue, stripScan0, planeStripSize, stripRow);
+                break;
+            case 32:
+                WriteOutputRowToStrip<float>(outputRow, outputWidth, numberOfChannels, hasAlphaChannel, maxChannelValue, stripScan0, planeStripSize, stripRow);
+                break;
+            default:
+                throw ::std::runtime_error("Unsupported bit depth.");
+            }
+        }
+
+        // The output strips are full-width tiles, so each plane strip is written at its offset in the plane.
+        const size_t stripPlaneBytes = static_cast<size_t>(outputWidth) * static_cast<size_t>(stripRowCount) * bytesPerChannel;
+
+        for (int32 channel = 0; channel < numberOfChannels; channel++)
+        {
+            SetFilePosition(
+                outputFile.get(),
+                outputDataOffset + (channel * outputPlaneSize) + (static_cast<int64>(stripTop) * outputWidth * static_cast<int64>(bytesPerChannel)));
+
+            WriteFile(outputFile.get(), stripScan0 + (planeStripSize * channel), stripPlaneBytes);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef IMAGERESAMPLER_H
+#define IMAGERESAMPLER_H
+
+#include "Common.h"
+#include <boost/filesystem.hpp>
+
+// Resamples a Gmic8bfImage to the specified size using a separable Lanczos-3 filter.
+// The output image is planar and uses the same bit depth as the input image.
+void ResampleGmic8bfImage(
+    const boost::filesystem::path& inputPath,
+    const boost::filesystem::path& outputPath,
+    int32 outputWidth,
+    int32 outputHeight);
+
+#endif // !IMAGERESAMPLER_H
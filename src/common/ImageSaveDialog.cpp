@@ -22,7 +22,7 @@ OSErr GetNewImageFileName(
     const FilterRecordPtr filterRecord,
     const boost::filesystem::path& defaultFileName,
     boost::filesystem::path& outputFileName,
-    int32 imageBitDepth)
+    OutputImageFileType fileType)
 {
-    return GetNewImageFileNameNative(filterRecord, defaultFileName, outputFileName, imageBitDepth);
+    return GetNewImageFileNameNative(filterRecord, defaultFileName, outputFileName, fileType);
 }
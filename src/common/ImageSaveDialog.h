@@ -14,11 +14,12 @@
 #define IMAGESAVEDIALOG_H
 
 #include "GmicPlugin.h"
+#include "OutputImageWriter.h"
 
 OSErr GetNewImageFileName(
     const FilterRecordPtr filterRecord,
     const boost::filesystem::path& defaultFileName,
     boost::filesystem::path& outputFileName,
-    int32 imageBitDepth);
+    OutputImageFileType fileType);
 
 #endif // !IMAGESAVEDIALOG_H
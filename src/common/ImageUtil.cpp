@@ -11,6 +11,16 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "ImageUtil.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGEUTIL_USE_SSE2 1
+#else
+#define IMAGEUTIL_USE_SSE2 0
+#endif
 
 ::std::vector<uint16> BuildSixteenBitToHostLUT()
 {
@@ -25,3 +35,350 @@
 
     return sixteenBitToHostLUT;
 }
+
+namespace
+{
+    ::std::vector<uint8> BuildSixteenToEightBitLUT()
+    {
+        ::std::vector<uint8> lut;
+        lut.reserve(65536);
+
+        for (size_t i = 0; i < lut.capacity(); i++)
+        {
+            lut.push_back(static_cast<uint8>(((i * 255) + 32767) / 65535));
+        }
+
+        return lut;
+    }
+
+    ::std::vector<float> BuildEightBitToFloatLUT()
+    {
+        ::std::vector<float> lut;
+        lut.reserve(256);
+
+        for (size_t i = 0; i < lut.capacity(); i++)
+        {
+            lut.push_back(static_cast<float>(i) / 255.0f);
+        }
+
+        return lut;
+    }
+
+    void ConvertEightToSixteenBits(const uint8* source, uint16* destination, size_t count)
+    {
+        // This loop should be automatically vectorized by the compiler.
+        for (size_t i = 0; i < count; i++)
+        {
+            destination[i] = static_cast<uint16>(source[i] * 257);
+        }
+    }
+
+    void ConvertEightBitsToFloat(const uint8* source, float* destination, size_t count)
+    {
+        static const ::std::vector<float> eightBitToFloatLUT = BuildEightBitToFloatLUT();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            destination[i] = eightBitToFloatLUT[source[i]];
+        }
+    }
+
+    void ConvertSixteenToEightBits(const uint16* source, uint8* destination, size_t count)
+    {
+        static const ::std::vector<uint8> sixteenToEightBitLUT = BuildSixteenToEightBitLUT();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            destination[i] = sixteenToEightBitLUT[source[i]];
+        }
+    }
+
+    void ConvertSixteenBitsToFloat(const uint16* source, float* destination, size_t count)
+    {
+        constexpr float scale = 1.0f / 65535.0f;
+
+        size_t i = 0;
+
+#if IMAGEUTIL_USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 scaleVector = _mm_set1_ps(scale);
+
+        for (; (i + 8) <= count; i += 8)
+        {
+            const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+
+            const __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(values, zero));
+            const __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(values, zero));
+
+            _mm_storeu_ps(destination + i, _mm_mul_ps(low, scaleVector));
+            _mm_storeu_ps(destination + i + 4, _mm_mul_ps(high, scaleVector));
+        }
+#endif // IMAGEUTIL_USE_SSE2
+
+        for (; i < count; i++)
+        {
+            destination[i] = static_cast<float>(source[i]) * scale;
+        }
+    }
+
+    float ClampAndScale(float value, float maxValue)
+    {
+        return (::std::min(::std::max(value, 0.0f), 1.0f) * maxValue) + 0.5f;
+    }
+
+    void ConvertFloatToEightBits(const float* source, uint8* destination, size_t count)
+    {
+        size_t i = 0;
+
+#if IMAGEUTIL_USE_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 maxValue = _mm_set1_ps(255.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+
+        for (; (i + 8) <= count; i += 8)
+        {
+            const __m128 low = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i), zero), one), maxValue), half);
+            const __m128 high = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i + 4), zero), one), maxValue), half);
+
+            const __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(low), _mm_cvttps_epi32(high));
+
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + i), _mm_packus_epi16(words, words));
+        }
+#endif // IMAGEUTIL_USE_SSE2
+
+        for (; i < count; i++)
+        {
+            destination[i] = static_cast<uint8>(ClampAndScale(source[i], 255.0f));
+        }
+    }
+
+    void ConvertFloatToSixteenBits(const float* source, uint16* destination, size_t count)
+    {
+        size_t i = 0;
+
+#if IMAGEUTIL_USE_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 maxValue = _mm_set1_ps(65535.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128i bias = _mm_set1_epi32(32768);
+        const __m128i signBit = _mm_set1_epi16(static_cast<short>(0x8000));
+
+        for (; (i + 8) <= count; i += 8)
+        {
+            const __m128 low = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i), zero), one), maxValue), half);
+            const __m128 high = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i + 4), zero), one), maxValue), half);
+
+            // SSE2 only has a signed saturating pack, so the values are biased into the signed range and back.
+            const __m128i lowWords = _mm_sub_epi32(_mm_cvttps_epi32(low), bias);
+            const __m128i highWords = _mm_sub_epi32(_mm_cvttps_epi32(high), bias);
+
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i*>(destination + i),
+                _mm_xor_si128(_mm_packs_epi32(lowWords, highWords), signBit));
+        }
+#endif // IMAGEUTIL_USE_SSE2
+
+        for (; i < count; i++)
+        {
+            destination[i] = static_cast<uint16>(ClampAndScale(source[i], 65535.0f));
+        }
+    }
+}
+
+void ConvertChannelBitDepth(
+    const void* source,
+    int32 sourceBitsPerChannel,
+    void* destination,
+    int32 destinationBitsPerChannel,
+    size_t count)
+{
+    if (sourceBitsPerChannel == destinationBitsPerChannel)
+    {
+        ::std::memcpy(destination, source, count * static_cast<size_t>(sourceBitsPerChannel / 8));
+        return;
+    }
+
+    switch (sourceBitsPerChannel)
+    {
+    case 8:
+        if (destinationBitsPerChannel == 16)
+        {
+            ConvertEightToSixteenBits(static_cast<const uint8*>(source), static_cast<uint16*>(destination), count);
+            return;
+        }
+        else if (destinationBitsPerChannel == 32)
+        {
+            ConvertEightBitsToFloat(static_cast<const uint8*>(source), static_cast<float*>(destination), count);
+            return;
+        }
+        break;
+    case 16:
+        if (destinationBitsPerChannel == 8)
+        {
+            ConvertSixteenToEightBits(static_cast<const uint16*>(source), static_cast<uint8*>(destination), count);
+            return;
+        }
+        else if (destinationBitsPerChannel == 32)
+        {
+            ConvertSixteenBitsToFloat(static_cast<const uint16*>(source), static_cast<float*>(destination), count);
+            return;
+        }
+        break;
+    case 32:
+        if (destinationBitsPerChannel == 8)
+        {
+            ConvertFloatToEightBits(static_cast<const float*>(source), static_cast<uint8*>(destination), count);
+            return;
+        }
+        else if (destinationBitsPerChannel == 16)
+        {
+            ConvertFloatToSixteenBits(static_cast<const float*>(source), static_cast<uint16*>(destination), count);
+            return;
+        }
+        break;
+    }
+
+    throw ::std::runtime_error("Unsupported bit depth conversion.");
+}
+
+namespace
+{
+    template <typename T>
+    bool AllSamplesMatch(const T* data, size_t count, T value)
+    {
+        size_t i = 0;
+
+#if IMAGEUTIL_USE_SSE2
+        __m128i pattern;
+
+        switch (sizeof(T))
+        {
+        case 1:
+            pattern = _mm_set1_epi8(static_cast<char>(value));
+            break;
+        case 2:
+            pattern = _mm_set1_epi16(static_cast<short>(value));
+            break;
+        default:
+            pattern = _mm_set1_epi32(static_cast<int>(value));
+            break;
+        }
+
+        constexpr size_t samplesPerVector = sizeof(__m128i) / sizeof(T);
+
+        // The differences from the pattern are accumulated so that the loop does not branch for
+        // every vector, the scan stops at the end of each 4 KiB block that has a mismatch.
+        constexpr size_t samplesPerBlock = 4096 / sizeof(T);
+
+        while ((count - i) >= samplesPerVector)
+        {
+            const size_t blockEnd = i + ::std::min(samplesPerBlock, ((count - i) / samplesPerVector) * samplesPerVector);
+
+            __m128i difference = _mm_setzero_si128();
+
+            for (; i < blockEnd; i += samplesPerVector)
+            {
+                const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+                difference = _mm_or_si128(difference, _mm_xor_si128(samples, pattern));
+            }
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(difference, _mm_setzero_si128())) != 0xffff)
+            {
+                return false;
+            }
+        }
+#endif // IMAGEUTIL_USE_SSE2
+
+        T difference = 0;
+
+        for (; i < count; i++)
+        {
+            difference |= static_cast<T>(data[i] ^ value);
+        }
+
+        return difference == 0;
+    }
+
+    bool AllSamplesMatch(const void* data, size_t count, int32 bitsPerChannel, uint32 value)
+    {
+        switch (bitsPerChannel)
+        {
+        case 8:
+            return AllSamplesMatch(static_cast<const uint8*>(data), count, static_cast<uint8>(value));
+        case 16:
+            return AllSamplesMatch(static_cast<const uint16*>(data), count, static_cast<uint16>(value));
+        case 32:
+            // The float samples are compared using their bit patterns.
+            return AllSamplesMatch(static_cast<const uint32*>(data), count, value);
+        default:
+            throw ::std::runtime_error("Unsupported bit depth.");
+        }
+    }
+}
+
+bool IsOpaqueAlphaData(const void* data, size_t count, int32 bitsPerChannel)
+{
+    return AllSamplesMatch(data, count, bitsPerChannel, GetOpaqueAlphaSampleValue(bitsPerChannel));
+}
+
+uint32 GetOpaqueAlphaSampleValue(int32 bitsPerChannel)
+{
+    switch (bitsPerChannel)
+    {
+    case 8:
+        return 0xff;
+    case 16:
+        return 0xffff;
+    case 32:
+        // 1.0 in the IEEE 754 binary32 format.
+        return 0x3f800000;
+    default:
+        throw ::std::runtime_error("Unsupported bit depth.");
+    }
+}
+
+bool IsConstantSampleData(const void* data, size_t count, int32 bitsPerChannel, uint32& value)
+{
+    if (count == 0)
+    {
+        return false;
+    }
+
+    switch (bitsPerChannel)
+    {
+    case 8:
+        value = *static_cast<const uint8*>(data);
+        break;
+    case 16:
+        value = *static_cast<const uint16*>(data);
+        break;
+    case 32:
+        value = *static_cast<const uint32*>(data);
+        break;
+    default:
+        throw ::std::runtime_error("Unsupported bit depth.");
+    }
+
+    return AllSamplesMatch(data, count, bitsPerChannel, value);
+}
+
+void FillSampleData(void* data, size_t count, int32 bitsPerChannel, uint32 value)
+{
+    switch (bitsPerChannel)
+    {
+    case 8:
+        ::std::fill_n(static_cast<uint8*>(data), count, static_cast<uint8>(value));
+        break;
+    case 16:
+        ::std::fill_n(static_cast<uint16*>(data), count, static_cast<uint16>(value));
+        break;
+    case 32:
+        ::std::fill_n(static_cast<uint32*>(data), count, value);
+        break;
+    default:
+        throw ::std::runtime_error("Unsupported bit depth.");
+    }
+}
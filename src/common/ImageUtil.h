@@ -18,4 +18,27 @@
 
 ::std::vector<uint16> BuildSixteenBitToHostLUT();
 
+// Converts channel data between the Gmic8bfImage bit depths.
+// The 16-bit data uses the range of [0, 65535], and 32-bit data is clamped to [0, 1]
+// when it is converted to an integer format.
+void ConvertChannelBitDepth(
+    const void* source,
+    int32 sourceBitsPerChannel,
+    void* destination,
+    int32 destinationBitsPerChannel,
+    size_t count);
+
+// Determines whether every sample is fully opaque, using the Gmic8bfImage sample formats.
+// The 16-bit integer data uses the range of [0, 65535].
+bool IsOpaqueAlphaData(const void* data, size_t count, int32 bitsPerChannel);
+
+// Gets the bit pattern of a fully opaque sample, using the Gmic8bfImage sample formats.
+uint32 GetOpaqueAlphaSampleValue(int32 bitsPerChannel);
+
+// Determines whether every sample has the same bit pattern, the pattern is returned in value.
+bool IsConstantSampleData(const void* data, size_t count, int32 bitsPerChannel, uint32& value);
+
+// Sets every sample to the specified bit pattern.
+void FillSampleData(void* data, size_t count, int32 bitsPerChannel, uint32 value);
+
 #endif // !IMAGEUTIL_H
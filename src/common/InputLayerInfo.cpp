@@ -45,6 +45,21 @@ InputLayerInfo InputLayerInfo::Clone() const
     return InputLayerInfo(imagePath, layerWidth, layerHeight, layerIsVisible, utf8LayerName);
 }
 
+const boost::filesystem::path& InputLayerInfo::GetImagePath() const
+{
+    return imagePath;
+}
+
+int32 InputLayerInfo::GetWidth() const
+{
+    return layerWidth;
+}
+
+int32 InputLayerInfo::GetHeight() const
+{
+    return layerHeight;
+}
+
 void InputLayerInfo::Write(FileHandle* fileHandle)
 {
     IndexLayerInfoHeader header(layerWidth, layerHeight, layerIsVisible);
@@ -32,6 +32,12 @@ public:
 
     InputLayerInfo Clone() const;
 
+    const boost::filesystem::path& GetImagePath() const;
+
+    int32 GetWidth() const;
+
+    int32 GetHeight() const;
+
     void Write(FileHandle* fileHandle);
 
 private:
@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "MaskOccupancyMap.h"
+#include "ImageUtil.h"
+#include "TilePlanner.h"
+#include "Utilities.h"
+#include <algorithm>
+
+namespace
+{
+    TileMaskOccupancy GetMaskOccupancy(const uint8* maskData, int32 maskRowBytes, int32 columnCount, int32 rowCount)
+    {
+        uint32 firstRowValue = 0;
+
+        for (int32 y = 0; y < rowCount; y++)
+        {
+            const uint8* mask = maskData + (static_cast<int64>(y) * maskRowBytes);
+            uint32 rowValue;
+
+            if (!IsConstantSampleData(mask, static_cast<size_t>(columnCount), 8, rowValue))
+            {
+                return TileMaskOccupancy::PartiallySelected;
+            }
+
+            if (y == 0)
+            {
+                firstRowValue = rowValue;
+            }
+            else if (rowValue != firstRowValue)
+            {
+                return TileMaskOccupancy::PartiallySelected;
+            }
+        }
+
+        switch (firstRowValue)
+        {
+        case 0:
+            return TileMaskOccupancy::Unselected;
+        case 255:
+            return TileMaskOccupancy::Selected;
+        default:
+            return TileMaskOccupancy::PartiallySelected;
+        }
+    }
+}
+
+MaskOccupancyMap::MaskOccupancyMap(FilterRecordPtr filterRecord, const VRect& bounds, int32 tileWidth, int32 tileHeight)
+    : bounds(bounds),
+      tileWidth(tileWidth),
+      tileHeight(tileHeight),
+      tilesAcross((bounds.right - bounds.left + tileWidth - 1) / tileWidth),
+      tiles(
+          static_cast<size_t>(tilesAcross) * static_cast<size_t>((bounds.bottom - bounds.top + tileHeight - 1) / tileHeight),
+          TileMaskOccupancy::Selected)
+{
+    if (!filterRecord->haveMask)
+    {
+        return;
+    }
+
+    // The mask is requested in windows that cover several tiles, so that the host is called
+    // once for each window instead of once for each tile. The mask data is only read from
+    // the host buffer, the plug-in does not allocate any buffers for it.
+    const TileGeometry windowGeometry = PlanHostWindowGeometry(
+        filterRecord,
+        bounds.right - bounds.left,
+        bounds.bottom - bounds.top,
+        tileWidth,
+        tileHeight,
+        /* hostBytesPerPixel */ 1,
+        /* bufferBytesPerPixel */ 0,
+        __FUNCTION__);
+
+    // Only the mask is requested, the host does not read or write any image data.
+    filterRecord->maskRate = int2fixed(1);
+    SetOutputRect(filterRecord, 0, 0, 0, 0);
+
+    for (int32 windowTop = bounds.top; windowTop < bounds.bottom; windowTop += windowGeometry.height)
+    {
+        const int32 windowBottom = ::std::min(windowTop + windowGeometry.height, bounds.bottom);
+
+        for (int32 windowLeft = bounds.left; windowLeft < bounds.right; windowLeft += windowGeometry.width)
+        {
+            const int32 windowRight = ::std::min(windowLeft + windowGeometry.width, bounds.right);
+
+            SetMaskRect(filterRecord, windowTop, windowLeft, windowBottom, windowRight);
+
+            OSErrException::ThrowIfError(TimedAdvanceState(filterRecord));
+
+            const uint8* const maskData = static_cast<const uint8*>(filterRecord->maskData);
+            const int32 maskRowBytes = filterRecord->maskRowBytes;
+
+            // The window is a multiple of the tile size, so the tiles in the window use the same grid as the map.
+            for (int32 top = windowTop; top < windowBottom; top += tileHeight)
+            {
+                const int32 bottom = ::std::min(top + tileHeight, windowBottom);
+                const size_t tileRowIndex = static_cast<size_t>((top - bounds.top) / tileHeight) * static_cast<size_t>(tilesAcross);
+
+                for (int32 left = windowLeft; left < windowRight; left += tileWidth)
+                {
+                    const int32 right = ::std::min(left + tileWidth, windowRight);
+
+                    const uint8* const tileMaskData = maskData +
+                        (static_cast<int64>(top - windowTop) * maskRowBytes) +
+                        (left - windowLeft);
+
+                    tiles[tileRowIndex + static_cast<size_t>((left - bounds.left) / tileWidth)] = GetMaskOccupancy(
+                        tileMaskData,
+                        maskRowBytes,
+                        right - left,
+                        bottom - top);
+                }
+            }
+        }
+    }
+
+    SetMaskRect(filterRecord, 0, 0, 0, 0);
+}
+
+TileMaskOccupancy MaskOccupancyMap::GetTileOccupancy(int32 left, int32 top) const
+{
+    const int32 tileX = (left - bounds.left) / tileWidth;
+    const int32 tileY = (top - bounds.top) / tileHeight;
+
+    return tiles[(static_cast<size_t>(tileY) * static_cast<size_t>(tilesAcross)) + static_cast<size_t>(tileX)];
+}
+
+void SetOutputTileMaskRect(
+    FilterRecordPtr filterRecord,
+    TileMaskOccupancy occupancy,
+    int32 top,
+    int32 left,
+    int32 bottom,
+    int32 right)
+{
+    if (occupancy == TileMaskOccupancy::PartiallySelected)
+    {
+        SetMaskRect(filterRecord, top, left, bottom, right);
+    }
+    else if (filterRecord->haveMask)
+    {
+        SetMaskRect(filterRecord, 0, 0, 0, 0);
+    }
+}
+
+const uint8* GetOutputTileMaskData(FilterRecordPtr filterRecord, TileMaskOccupancy occupancy)
+{
+    return occupancy == TileMaskOccupancy::PartiallySelected ? static_cast<const uint8*>(filterRecord->maskData) : nullptr;
+}
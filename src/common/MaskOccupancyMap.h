@@ -0,0 +1,59 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef MASKOCCUPANCYMAP_H
+#define MASKOCCUPANCYMAP_H
+
+#include "GmicPlugin.h"
+#include <vector>
+
+enum class TileMaskOccupancy : uint8
+{
+    Unselected,
+    PartiallySelected,
+    Selected
+};
+
+// The selection coverage of the output tiles, this is computed from the host mask
+// before any output is requested so that the unselected tiles can be skipped and
+// the fully selected tiles can be copied without checking the mask.
+class MaskOccupancyMap
+{
+public:
+    MaskOccupancyMap(FilterRecordPtr filterRecord, const VRect& bounds, int32 tileWidth, int32 tileHeight);
+
+    // Gets the occupancy of the tile that starts at the specified document coordinates.
+    TileMaskOccupancy GetTileOccupancy(int32 left, int32 top) const;
+
+private:
+    VRect bounds;
+    int32 tileWidth;
+    int32 tileHeight;
+    int32 tilesAcross;
+    ::std::vector<TileMaskOccupancy> tiles;
+};
+
+// Sets the mask rectangle for an output tile, the mask is only requested for
+// the tiles that are partially selected.
+void SetOutputTileMaskRect(
+    FilterRecordPtr filterRecord,
+    TileMaskOccupancy occupancy,
+    int32 top,
+    int32 left,
+    int32 bottom,
+    int32 right);
+
+// Gets the mask data of an output tile after advanceState, or nullptr if the tile
+// is fully selected.
+const uint8* GetOutputTileMaskData(FilterRecordPtr filterRecord, TileMaskOccupancy occupancy);
+
+#endif // !MASKOCCUPANCYMAP_H
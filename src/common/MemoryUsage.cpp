@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "MemoryUsage.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <mutex>
+
+namespace
+{
+    constexpr size_t CategoryCount = static_cast<size_t>(MemoryUsageCategory::Count);
+
+    struct CategoryUsage
+    {
+        uint64_t current;
+        uint64_t peak;
+    };
+
+    class MemoryUsageTracker
+    {
+    public:
+        MemoryUsageTracker() noexcept
+            : mutex(), categories(), currentTotal(0), peakTotal(0), budget(0)
+        {
+        }
+
+        void SetBudget(uint64_t value) noexcept
+        {
+            ::std::lock_guard<::std::mutex> lock(mutex);
+
+            budget = value;
+        }
+
+        uint64_t GetRemainingBudget() noexcept
+        {
+            ::std::lock_guard<::std::mutex> lock(mutex);
+
+            if (budget == 0)
+            {
+                return ::std::numeric_limits<uint64_t>::max();
+            }
+
+            return currentTotal < budget ? budget - currentTotal : 0;
+        }
+
+        void Allocate(MemoryUsageCategory category, uint64_t size) noexcept
+        {
+            ::std::lock_guard<::std::mutex> lock(mutex);
+
+            CategoryUsage& usage = categories[static_cast<size_t>(category)];
+
+            usage.current += size;
+            usage.peak = ::std::max(usage.peak, usage.current);
+
+            currentTotal += size;
+            peakTotal = ::std::max(peakTotal, currentTotal);
+        }
+
+        void Free(MemoryUsageCategory category, uint64_t size) noexcept
+        {
+            ::std::lock_guard<::std::mutex> lock(mutex);
+
+            CategoryUsage& usage = categories[static_cast<size_t>(category)];
+
+            usage.current -= ::std::min(usage.current, size);
+            currentTotal -= ::std::min(currentTotal, size);
+        }
+
+        void ResetPeak() noexcept
+        {
+            ::std::lock_guard<::std::mutex> lock(mutex);
+
+            for (CategoryUsage& usage : categories)
+            {
+                usage.peak = usage.current;
+            }
+
+            peakTotal = currentTotal;
+        }
+
+        void Trace(const char* context) noexcept
+        {
+#if DEBUG_BUILD
+            ::std::lock_guard<::std::mutex> lock(mutex);
+
+            DebugOut("%s memory usage: current=%llu peak=%llu budget=%llu",
+                     context,
+                     currentTotal,
+                     peakTotal,
+                     budget);
+
+            for (size_t i = 0; i < CategoryCount; i++)
+            {
+                DebugOut("  %s: current=%llu peak=%llu",
+                         GetCategoryName(static_cast<MemoryUsageCategory>(i)),
+                         categories[i].current,
+                         categories[i].peak);
+            }
+#else
+            (void)context;
+#endif // DEBUG_BUILD
+        }
+
+    private:
+
+        static const char* GetCategoryName(MemoryUsageCategory category) noexcept
+        {
+            switch (category)
+            {
+            case MemoryUsageCategory::HostBuffer:
+                return "HostBuffer";
+            case MemoryUsageCategory::Heap:
+                return "Heap";
+            case MemoryUsageCategory::ImageDecoder:
+                return "ImageDecoder";
+            case MemoryUsageCategory::ImageEncoder:
+                return "ImageEncoder";
+            default:
+                return "Unknown";
+            }
+        }
+
+        ::std::mutex mutex;
+        ::std::array<CategoryUsage, CategoryCount> categories;
+        uint64_t currentTotal;
+        uint64_t peakTotal;
+        uint64_t budget;
+    };
+
+    MemoryUsageTracker& GetMemoryUsageTracker() noexcept
+    {
+        static MemoryUsageTracker tracker;
+
+        return tracker;
+    }
+}
+
+void SetMemoryBudget(uint64_t budgetInBytes) noexcept
+{
+    GetMemoryUsageTracker().SetBudget(budgetInBytes);
+}
+
+uint64_t GetRemainingMemoryBudget() noexcept
+{
+    return GetMemoryUsageTracker().GetRemainingBudget();
+}
+
+void RecordMemoryAllocation(MemoryUsageCategory category, uint64_t size) noexcept
+{
+    GetMemoryUsageTracker().Allocate(category, size);
+}
+
+void RecordMemoryFree(MemoryUsageCategory category, uint64_t size) noexcept
+{
+    GetMemoryUsageTracker().Free(category, size);
+}
+
+void ResetPeakMemoryUsage() noexcept
+{
+    GetMemoryUsageTracker().ResetPeak();
+}
+
+void TraceMemoryUsage(const char* context) noexcept
+{
+    GetMemoryUsageTracker().Trace(context);
+}
+
+ScopedMemoryUsageRecord::ScopedMemoryUsageRecord(MemoryUsageCategory category, uint64_t size)
+    : category(category), size(size)
+{
+    RecordMemoryAllocation(category, size);
+}
+
+ScopedMemoryUsageRecord::~ScopedMemoryUsageRecord()
+{
+    RecordMemoryFree(category, size);
+}
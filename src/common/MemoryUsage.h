@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include "Common.h"
+#include <boost/core/noncopyable.hpp>
+
+enum class MemoryUsageCategory
+{
+    // Buffers allocated through the host BufferSuite.
+    HostBuffer = 0,
+    // General heap allocations made by the plug-in.
+    Heap,
+    // Memory used when decoding the second input image.
+    ImageDecoder,
+    // Memory used when encoding the G'MIC-Qt output images.
+    ImageEncoder,
+
+    Count
+};
+
+// Sets the number of bytes the plug-in may use, a value of zero removes the limit.
+void SetMemoryBudget(uint64_t budgetInBytes) noexcept;
+uint64_t GetRemainingMemoryBudget() noexcept;
+
+// Records an allocation, the budget is only used when planning the tile sizes.
+void RecordMemoryAllocation(MemoryUsageCategory category, uint64_t size) noexcept;
+void RecordMemoryFree(MemoryUsageCategory category, uint64_t size) noexcept;
+
+void ResetPeakMemoryUsage() noexcept;
+void TraceMemoryUsage(const char* context) noexcept;
+
+// Records an allocation for the lifetime of the object.
+class ScopedMemoryUsageRecord : private boost::noncopyable
+{
+public:
+    ScopedMemoryUsageRecord(MemoryUsageCategory category, uint64_t size);
+
+    ~ScopedMemoryUsageRecord();
+
+private:
+    const MemoryUsageCategory category;
+    const uint64_t size;
+};
+
+#endif // !MEMORYUSAGE_H
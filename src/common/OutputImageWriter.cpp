@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "OutputImageWriter.h"
+#include "ExrWriter.h"
+#include "PngWriter.h"
+#include "QoiWriter.h"
+#include "TiffWriter.h"
+#include "Utilities.h"
+
+OutputImageFileType GetOutputImageFileType(OutputFileFormat format, int32 bitsPerChannel)
+{
+    switch (format)
+    {
+    case OutputFileFormat::TiffUncompressed:
+        return OutputImageFileType::TiffUncompressed;
+    case OutputFileFormat::TiffDeflate:
+        return OutputImageFileType::TiffDeflate;
+    case OutputFileFormat::Qoi:
+        if (bitsPerChannel == 8)
+        {
+            return OutputImageFileType::Qoi;
+        }
+        break;
+    case OutputFileFormat::Default:
+    default:
+        break;
+    }
+
+    return bitsPerChannel == 32 ? OutputImageFileType::Exr : OutputImageFileType::Png;
+}
+
+const char* GetOutputImageFileExtension(OutputImageFileType fileType)
+{
+    switch (fileType)
+    {
+    case OutputImageFileType::Exr:
+        return ".exr";
+    case OutputImageFileType::TiffUncompressed:
+    case OutputImageFileType::TiffDeflate:
+        return ".tif";
+    case OutputImageFileType::Qoi:
+        return ".qoi";
+    case OutputImageFileType::Png:
+    default:
+        return ".png";
+    }
+}
+
+OutputImageWriterOptions GetOutputImageWriterOptions(const FilterRecordPtr filterRecord)
+{
+    OutputImageWriterOptions options{};
+    options.hostBufferSpace = static_cast<uint64>(filterRecord->bufferProcs->spaceProc());
+    options.hostTileHeight = GetTileHeight(filterRecord->outTileHeight);
+
+    return options;
+}
+
+void ConvertGmic8bfImageToOutputFile(
+    const OutputImageWriterOptions& options,
+    OutputImageFileType fileType,
+    const boost::filesystem::path& inputFilePath,
+    const boost::filesystem::path& outputFilePath)
+{
+    switch (fileType)
+    {
+    case OutputImageFileType::Png:
+        ConvertGmic8bfImageToPng(inputFilePath, outputFilePath, options.hostBufferSpace, options.hostTileHeight);
+        break;
+    case OutputImageFileType::Exr:
+        ConvertGmic8bfImageToExr(inputFilePath, outputFilePath);
+        break;
+    case OutputImageFileType::TiffUncompressed:
+        ConvertGmic8bfImageToTiff(inputFilePath, outputFilePath, /* deflateCompression */ false);
+        break;
+    case OutputImageFileType::TiffDeflate:
+        ConvertGmic8bfImageToTiff(inputFilePath, outputFilePath, /* deflateCompression */ true);
+        break;
+    case OutputImageFileType::Qoi:
+        ConvertGmic8bfImageToQoi(inputFilePath, outputFilePath);
+        break;
+    default:
+        throw ::std::runtime_error("Unsupported output image file type.");
+    }
+}
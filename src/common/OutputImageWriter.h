@@ -0,0 +1,51 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef OUTPUTIMAGEWRITER_H
+#define OUTPUTIMAGEWRITER_H
+
+#include "GmicPlugin.h"
+#include "GmicIOSettings.h"
+#include <boost/filesystem.hpp>
+
+// The file type used to save a G'MIC-Qt output image that is not written back to the document.
+enum class OutputImageFileType
+{
+    Png,
+    Exr,
+    TiffUncompressed,
+    TiffDeflate,
+    Qoi
+};
+
+OutputImageFileType GetOutputImageFileType(OutputFileFormat format, int32 bitsPerChannel);
+
+// Gets the file extension, including the leading period.
+const char* GetOutputImageFileExtension(OutputImageFileType fileType);
+
+// The host values that are used by the output image writers. These are copied from the
+// FilterRecord so that an image can be saved after the filter has returned to the host.
+struct OutputImageWriterOptions
+{
+    uint64 hostBufferSpace;
+    int32 hostTileHeight;
+};
+
+OutputImageWriterOptions GetOutputImageWriterOptions(const FilterRecordPtr filterRecord);
+
+void ConvertGmic8bfImageToOutputFile(
+    const OutputImageWriterOptions& options,
+    OutputImageFileType fileType,
+    const boost::filesystem::path& inputFilePath,
+    const boost::filesystem::path& outputFilePath);
+
+#endif // !OUTPUTIMAGEWRITER_H
@@ -0,0 +1,258 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "ParallelFor.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Limits the number of threads on systems with many cores, the kernels
+    // that use the pool are limited by the memory bandwidth.
+    constexpr unsigned int MaximumWorkerThreads = 15;
+
+    struct ParallelForJob
+    {
+        const ::std::function<void(int32, int32)>* body;
+        int32 count;
+        int32 grainSize;
+        ::std::atomic<int32> nextIndex;
+        ::std::mutex errorMutex;
+        ::std::exception_ptr error;
+    };
+
+    // The threads take the next range from a shared counter, so a thread that finishes
+    // its range early continues with the remaining work instead of waiting.
+    void RunParallelForJob(ParallelForJob& job) noexcept
+    {
+        while (true)
+        {
+            const int32 begin = job.nextIndex.fetch_add(job.grainSize);
+
+            if (begin >= job.count)
+            {
+                break;
+            }
+
+            try
+            {
+                (*job.body)(begin, ::std::min(begin + job.grainSize, job.count));
+            }
+            catch (...)
+            {
+                ::std::lock_guard<::std::mutex> lock(job.errorMutex);
+
+                if (!job.error)
+                {
+                    job.error = ::std::current_exception();
+                }
+
+                // Stop the other threads from starting new ranges.
+                job.nextIndex.store(job.count);
+            }
+        }
+    }
+}
+
+class WorkerThreadPool : private boost::noncopyable
+{
+public:
+    WorkerThreadPool()
+        : ownerThreadId(::std::this_thread::get_id()),
+          currentJob(nullptr),
+          jobGeneration(0),
+          activeWorkerCount(0),
+          stopping(false),
+          threadsStarted(false)
+    {
+    }
+
+    ~WorkerThreadPool()
+    {
+        {
+            ::std::lock_guard<::std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        jobAvailable.notify_all();
+
+        for (::std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    bool IsOwnerThread() const noexcept
+    {
+        return ::std::this_thread::get_id() == ownerThreadId;
+    }
+
+    void Run(ParallelForJob& job)
+    {
+        StartThreads();
+
+        if (!threads.empty())
+        {
+            {
+                ::std::lock_guard<::std::mutex> lock(mutex);
+
+                currentJob = &job;
+                jobGeneration++;
+                activeWorkerCount = static_cast<int32>(threads.size());
+            }
+
+            jobAvailable.notify_all();
+        }
+
+        RunParallelForJob(job);
+
+        if (!threads.empty())
+        {
+            ::std::unique_lock<::std::mutex> lock(mutex);
+
+            jobFinished.wait(lock, [this] { return activeWorkerCount == 0; });
+
+            currentJob = nullptr;
+        }
+    }
+
+private:
+    void StartThreads() noexcept
+    {
+        if (threadsStarted)
+        {
+            return;
+        }
+
+        threadsStarted = true;
+
+        const unsigned int processorCount = ::std::thread::hardware_concurrency();
+        const unsigned int threadCount = processorCount > 1 ? ::std::min(processorCount - 1, MaximumWorkerThreads) : 0;
+
+        try
+        {
+            threads.reserve(threadCount);
+
+            for (unsigned int i = 0; i < threadCount; i++)
+            {
+                threads.emplace_back(&WorkerThreadPool::WorkerThreadProc, this);
+            }
+        }
+        catch (...)
+        {
+            // The jobs can run with fewer threads, or only on the calling thread.
+        }
+    }
+
+    void WorkerThreadProc() noexcept
+    {
+        uint64 lastGeneration = 0;
+
+        while (true)
+        {
+            ParallelForJob* job;
+
+            {
+                ::std::unique_lock<::std::mutex> lock(mutex);
+
+                jobAvailable.wait(lock, [&] { return stopping || jobGeneration != lastGeneration; });
+
+                if (stopping)
+                {
+                    return;
+                }
+
+                lastGeneration = jobGeneration;
+                job = currentJob;
+            }
+
+            RunParallelForJob(*job);
+
+            {
+                ::std::lock_guard<::std::mutex> lock(mutex);
+
+                activeWorkerCount--;
+
+                if (activeWorkerCount == 0)
+                {
+                    jobFinished.notify_one();
+                }
+            }
+        }
+    }
+
+    const ::std::thread::id ownerThreadId;
+    ::std::vector<::std::thread> threads;
+    ::std::mutex mutex;
+    ::std::condition_variable jobAvailable;
+    ::std::condition_variable jobFinished;
+    ParallelForJob* currentJob;
+    uint64 jobGeneration;
+    int32 activeWorkerCount;
+    bool stopping;
+    bool threadsStarted;
+};
+
+namespace
+{
+    WorkerThreadPool* activeWorkerThreadPool = nullptr;
+}
+
+WorkerThreadPoolSession::WorkerThreadPoolSession()
+    : pool(new WorkerThreadPool())
+{
+    activeWorkerThreadPool = pool;
+}
+
+WorkerThreadPoolSession::~WorkerThreadPoolSession()
+{
+    if (activeWorkerThreadPool == pool)
+    {
+        activeWorkerThreadPool = nullptr;
+    }
+
+    delete pool;
+}
+
+void ParallelFor(int32 count, int32 grainSize, const ::std::function<void(int32 begin, int32 end)>& body)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    grainSize = ::std::max(grainSize, 1);
+
+    if (count <= grainSize || activeWorkerThreadPool == nullptr || !activeWorkerThreadPool->IsOwnerThread())
+    {
+        body(0, count);
+        return;
+    }
+
+    ParallelForJob job;
+    job.body = &body;
+    job.count = count;
+    job.grainSize = grainSize;
+    job.nextIndex.store(0);
+
+    activeWorkerThreadPool->Run(job);
+
+    if (job.error)
+    {
+        ::std::rethrow_exception(job.error);
+    }
+}
@@ -0,0 +1,42 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include "Common.h"
+#include <boost/core/noncopyable.hpp>
+#include <functional>
+
+class WorkerThreadPool;
+
+// Keeps a set of worker threads for the lifetime of a filter invocation, the
+// threads are started by the first ParallelFor call and joined when the session ends.
+class WorkerThreadPoolSession : private boost::noncopyable
+{
+public:
+    WorkerThreadPoolSession();
+
+    ~WorkerThreadPoolSession();
+
+private:
+    WorkerThreadPool* pool;
+};
+
+// Calls body with consecutive ranges of [0, count) that contain at most grainSize items.
+// When called on the thread that created the session the ranges are processed by the
+// worker threads and the calling thread, otherwise they are processed on the calling thread.
+// The body must not acquire pooled buffers, an exception thrown by the body is rethrown
+// after the other ranges have finished.
+void ParallelFor(int32 count, int32 grainSize, const ::std::function<void(int32 begin, int32 end)>& body);
+
+#endif // !PARALLELFOR_H
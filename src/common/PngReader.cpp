@@ -0,0 +1,482 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "PngReader.h"
+#include "BufferPool.h"
+#include "FileIO.h"
+#include "FileUtil.h"
+#include "Gmic8bfImageWriter.h"
+#include "TilePlanner.h"
+#include <boost/core/noncopyable.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <string>
+#include <setjmp.h>
+#include <png.h>
+
+namespace
+{
+    constexpr size_t PngSignatureSize = 8;
+
+    enum class PngDecodeResult
+    {
+        Success = 0,
+        Unsupported,
+        Error
+    };
+
+    struct PngErrorData
+    {
+        PngErrorData()
+            : errorMessageSet(false), errorMessage()
+        {
+        }
+
+        ::std::string GetErrorMessage() const
+        {
+            return errorMessage;
+        }
+
+        void SetErrorMessage(const char* const message) noexcept
+        {
+            if (!errorMessageSet)
+            {
+                errorMessageSet = true;
+
+                try
+                {
+                    errorMessage = message;
+                }
+                catch (...)
+                {
+                }
+            }
+        }
+
+    private:
+        bool errorMessageSet;
+        ::std::string errorMessage;
+    };
+
+    struct PngReadSource
+    {
+        FileHandle* file;
+        const uint8* data;
+        size_t dataLength;
+        size_t dataOffset;
+    };
+
+    struct PngImageInfo
+    {
+        png_uint_32 width;
+        png_uint_32 height;
+        int32 numberOfChannels;
+        size_t rowBytes;
+    };
+
+    void PngReadErrorHandler(png_structp png, png_const_charp errorDescription)
+    {
+        PngErrorData* errorData = static_cast<PngErrorData*>(png_get_error_ptr(png));
+
+        if (errorData)
+        {
+            DebugOut("LibPng error: %s", errorDescription);
+
+            errorData->SetErrorMessage(errorDescription);
+        }
+
+        longjmp(png_jmpbuf(png), 1);
+    }
+
+    void ReadPngData(png_structp png_ptr, png_bytep data, png_size_t length)
+    {
+        PngReadSource* source = static_cast<PngReadSource*>(png_get_io_ptr(png_ptr));
+
+        bool readSucceeded = true;
+
+        if (source->file != nullptr)
+        {
+            try
+            {
+                ReadFile(source->file, data, length);
+            }
+            catch (...)
+            {
+                readSucceeded = false;
+            }
+        }
+        else
+        {
+            if (length <= (source->dataLength - source->dataOffset))
+            {
+                memcpy(data, source->data + source->dataOffset, length);
+                source->dataOffset += length;
+            }
+            else
+            {
+                readSucceeded = false;
+            }
+        }
+
+        // png_error must not be called from a catch block, it uses longjmp to return to the decoder.
+        if (!readSucceeded)
+        {
+            png_error(png_ptr, "Unable to read the PNG image data.");
+        }
+    }
+
+    bool WriteStrip(FileHandle* file, const uint8* data, size_t dataLength, PngErrorData* errorData) noexcept
+    {
+        try
+        {
+            WriteFile(file, data, dataLength);
+
+            return true;
+        }
+        catch (const ::std::exception& e)
+        {
+            errorData->SetErrorMessage(e.what());
+        }
+        catch (...)
+        {
+            errorData->SetErrorMessage("An unknown error occurred when writing the G'MIC image data.");
+        }
+
+        return false;
+    }
+
+    // Disable "C4611: interaction between '_setjmp' and C++ object destruction is non-portable" on MSVC.
+    // The methods that call setjmp do not create any C++ objects.
+#if _MSC_VER
+#pragma warning(disable:4611)
+#endif
+
+    PngDecodeResult ReadPngHeader(png_structp pngPtr, png_infop infoPtr, PngImageInfo* imageInfo)
+    {
+        if (setjmp(png_jmpbuf(pngPtr)))
+        {
+            return PngDecodeResult::Error;
+        }
+
+        png_read_info(pngPtr, infoPtr);
+
+        int bitDepth = 0;
+        int colorType = 0;
+        int interlaceType = 0;
+
+        png_get_IHDR(
+            pngPtr,
+            infoPtr,
+            &imageInfo->width,
+            &imageInfo->height,
+            &bitDepth,
+            &colorType,
+            &interlaceType,
+            nullptr,
+            nullptr);
+
+        // Interlaced images cannot be decoded in strips.
+        if (interlaceType != PNG_INTERLACE_NONE ||
+            imageInfo->width > static_cast<png_uint_32>(::std::numeric_limits<int32>::max()) ||
+            imageInfo->height > static_cast<png_uint_32>(::std::numeric_limits<int32>::max()))
+        {
+            return PngDecodeResult::Unsupported;
+        }
+
+        // The images are converted to the gray, RGB or RGBA layouts with 8 bits per channel.
+        if (bitDepth == 16)
+        {
+            png_set_strip_16(pngPtr);
+        }
+
+        if (colorType == PNG_COLOR_TYPE_PALETTE)
+        {
+            png_set_palette_to_rgb(pngPtr);
+        }
+        else if (colorType == PNG_COLOR_TYPE_GRAY && bitDepth < 8)
+        {
+            png_set_expand_gray_1_2_4_to_8(pngPtr);
+        }
+
+        const bool hasTransparencyChunk = png_get_valid(pngPtr, infoPtr, PNG_INFO_tRNS) != 0;
+
+        if (hasTransparencyChunk)
+        {
+            png_set_tRNS_to_alpha(pngPtr);
+        }
+
+        if ((colorType & PNG_COLOR_MASK_COLOR) == 0 &&
+            ((colorType & PNG_COLOR_MASK_ALPHA) != 0 || hasTransparencyChunk))
+        {
+            // There is no gray + alpha layout, the image is converted to RGBA.
+            png_set_gray_to_rgb(pngPtr);
+        }
+
+        png_read_update_info(pngPtr, infoPtr);
+
+        imageInfo->numberOfChannels = png_get_channels(pngPtr, infoPtr);
+        imageInfo->rowBytes = png_get_rowbytes(pngPtr, infoPtr);
+
+        return PngDecodeResult::Success;
+    }
+
+    PngDecodeResult ReadPngRows(
+        png_structp pngPtr,
+        FileHandle* outputFile,
+        uint8* stripBuffer,
+        size_t rowBytes,
+        int32 height,
+        int32 stripHeight,
+        PngErrorData* errorData)
+    {
+        if (setjmp(png_jmpbuf(pngPtr)))
+        {
+            return PngDecodeResult::Error;
+        }
+
+        for (int32 y = 0; y < height; y += stripHeight)
+        {
+            const int32 rowCount = ::std::min(stripHeight, height - y);
+
+            for (int32 i = 0; i < rowCount; i++)
+            {
+                png_read_row(pngPtr, stripBuffer + (static_cast<size_t>(i) * rowBytes), nullptr);
+            }
+
+            if (!WriteStrip(outputFile, stripBuffer, static_cast<size_t>(rowCount) * rowBytes, errorData))
+            {
+                return PngDecodeResult::Error;
+            }
+        }
+
+        png_read_end(pngPtr, nullptr);
+
+        return PngDecodeResult::Success;
+    }
+
+#if _MSC_VER
+#pragma warning(default:4611)
+#endif
+
+    class ScopedPngReadStruct : private boost::noncopyable
+    {
+    public:
+        explicit ScopedPngReadStruct(PngErrorData* errorData)
+            : pngPtr(nullptr), infoPtr(nullptr)
+        {
+            pngPtr = png_create_read_struct(
+                PNG_LIBPNG_VER_STRING,
+                static_cast<png_voidp>(errorData),
+                PngReadErrorHandler,
+                nullptr);
+
+            if (pngPtr == nullptr)
+            {
+                throw ::std::bad_alloc();
+            }
+
+            infoPtr = png_create_info_struct(pngPtr);
+
+            if (infoPtr == nullptr)
+            {
+                png_destroy_read_struct(&pngPtr, nullptr, nullptr);
+                throw ::std::bad_alloc();
+            }
+        }
+
+        ~ScopedPngReadStruct()
+        {
+            png_destroy_read_struct(&pngPtr, &infoPtr, nullptr);
+        }
+
+        png_structp get_png() const noexcept
+        {
+            return pngPtr;
+        }
+
+        png_infop get_info() const noexcept
+        {
+            return infoPtr;
+        }
+
+    private:
+        png_structp pngPtr;
+        png_infop infoPtr;
+    };
+
+    struct PngStripWriter
+    {
+        png_structp pngPtr;
+        PngErrorData* errorData;
+        size_t rowBytes;
+        int32 stripHeight;
+
+        static void WriteCallback(
+            FileHandle* file,
+            int32 imageWidth,
+            int32 imageHeight,
+            int32 numberOfChannels,
+            int32 bitsPerChannel,
+            void* callbackState)
+        {
+            (void)imageWidth;
+            (void)numberOfChannels;
+            (void)bitsPerChannel;
+
+            if (file == nullptr || callbackState == nullptr)
+            {
+                throw ::std::runtime_error("A required pointer was null.");
+            }
+
+            PngStripWriter* instance = static_cast<PngStripWriter*>(callbackState);
+
+            PooledBuffer stripBuffer = AcquirePooledBuffer(instance->rowBytes * static_cast<size_t>(instance->stripHeight));
+
+            if (ReadPngRows(
+                instance->pngPtr,
+                file,
+                static_cast<uint8*>(stripBuffer.data()),
+                instance->rowBytes,
+                imageHeight,
+                instance->stripHeight,
+                instance->errorData) != PngDecodeResult::Success)
+            {
+                const ::std::string errorMessage = instance->errorData->GetErrorMessage();
+
+                if (errorMessage.empty())
+                {
+                    throw ::std::runtime_error("An unspecified error occurred when decoding the PNG image.");
+                }
+                else
+                {
+                    throw ::std::runtime_error(errorMessage);
+                }
+            }
+        }
+    };
+
+    bool DoPngConversion(PngReadSource* source, ::std::unique_ptr<InputLayerInfo>& output)
+    {
+        ::std::unique_ptr<PngErrorData> errorData = ::std::make_unique<PngErrorData>();
+        ScopedPngReadStruct readStruct(errorData.get());
+
+        png_set_read_fn(readStruct.get_png(), static_cast<png_voidp>(source), ReadPngData);
+
+        PngImageInfo imageInfo{};
+
+        switch (ReadPngHeader(readStruct.get_png(), readStruct.get_info(), &imageInfo))
+        {
+        case PngDecodeResult::Success:
+            break;
+        case PngDecodeResult::Unsupported:
+            return false;
+        case PngDecodeResult::Error:
+        default:
+            {
+                const ::std::string errorMessage = errorData->GetErrorMessage();
+
+                throw ::std::runtime_error(errorMessage.empty() ? "Unable to read the PNG image header." : errorMessage);
+            }
+        }
+
+        const int32 width = static_cast<int32>(imageInfo.width);
+        const int32 height = static_cast<int32>(imageInfo.height);
+
+        if (imageInfo.rowBytes != (static_cast<size_t>(width) * static_cast<size_t>(imageInfo.numberOfChannels)))
+        {
+            // The decoder output does not use 8 bits per channel.
+            return false;
+        }
+
+        const TileGeometry stripGeometry = PlanBufferStripGeometry(
+            width,
+            height,
+            imageInfo.numberOfChannels,
+            __FUNCTION__);
+
+        PngStripWriter writer{ readStruct.get_png(), errorData.get(), imageInfo.rowBytes, stripGeometry.height };
+
+        const boost::filesystem::path path = GetTemporaryFileName(GetInputDirectory(), ".g8i");
+
+        WritePixelsFromCallback(
+            width,
+            height,
+            imageInfo.numberOfChannels,
+            8,
+            /* planar */ false,
+            stripGeometry.width,
+            stripGeometry.height,
+            &PngStripWriter::WriteCallback,
+            &writer,
+            path);
+
+        output.reset(new InputLayerInfo(
+            path,
+            width,
+            height,
+            true,
+            "2nd Layer"));
+
+        return true;
+    }
+}
+
+bool IsPngImage(const void* data, size_t dataLength)
+{
+    return data != nullptr &&
+           dataLength >= PngSignatureSize &&
+           png_sig_cmp(static_cast<png_const_bytep>(data), 0, PngSignatureSize) == 0;
+}
+
+bool TryConvertPngImageToGmicInputFormat(
+    const boost::filesystem::path& input,
+    ::std::unique_ptr<InputLayerInfo>& output)
+{
+    if (boost::filesystem::file_size(input) < PngSignatureSize)
+    {
+        return false;
+    }
+
+    ::std::unique_ptr<FileHandle> file = OpenFile(input, FileOpenMode::Read);
+
+    uint8 signature[PngSignatureSize]{};
+
+    ReadFile(file.get(), signature, sizeof(signature));
+
+    if (!IsPngImage(signature, sizeof(signature)))
+    {
+        return false;
+    }
+
+    SetFilePosition(file.get(), 0);
+
+    PngReadSource source{ file.get(), nullptr, 0, 0 };
+
+    return DoPngConversion(&source, output);
+}
+
+bool TryConvertPngImageToGmicInputFormat(
+    const void* input,
+    size_t inputLength,
+    ::std::unique_ptr<InputLayerInfo>& output)
+{
+    if (!IsPngImage(input, inputLength))
+    {
+        return false;
+    }
+
+    PngReadSource source{ nullptr, static_cast<const uint8*>(input), inputLength, 0 };
+
+    return DoPngConversion(&source, output);
+}
@@ -0,0 +1,36 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef PNGREADER_H
+#define PNGREADER_H
+
+#include "Common.h"
+#include "InputLayerInfo.h"
+#include <boost/filesystem.hpp>
+#include <memory>
+
+bool IsPngImage(const void* data, size_t dataLength);
+
+// Decodes a non-interlaced PNG image to a Gmic8bfImage in strips, the image
+// is converted to 8 bits per channel using the same channel layouts as the
+// platform image decoders.
+// Returns false if the image uses a format that must be handled by the platform decoder.
+bool TryConvertPngImageToGmicInputFormat(
+    const boost::filesystem::path& input,
+    ::std::unique_ptr<InputLayerInfo>& output);
+
+bool TryConvertPngImageToGmicInputFormat(
+    const void* input,
+    size_t inputLength,
+    ::std::unique_ptr<InputLayerInfo>& output);
+
+#endif // !PNGREADER_H
@@ -11,11 +11,15 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "PngWriter.h"
+#include "BufferPool.h"
 #include "FileUtil.h"
 #include "Gmic8bfImageHeader.h"
+#include "MemoryUsage.h"
 #include "Utilities.h"
 #include <boost/endian.hpp>
 #include <boost/predef.h>
+#include <cstddef>
+#include <limits>
 #include <new>
 #include <string>
 #include <setjmp.h>
@@ -77,6 +81,45 @@ namespace
         longjmp(png_jmpbuf(png), 1);
     }
 
+    // The size of each libpng allocation is stored in front of the returned block
+    // so that it can be removed from the memory usage statistics when freed.
+    constexpr size_t PngAllocationHeaderSize = alignof(::std::max_align_t);
+
+    png_voidp PngMalloc(png_structp png_ptr, png_alloc_size_t size)
+    {
+        (void)png_ptr;
+
+        if (size > (::std::numeric_limits<size_t>::max() - PngAllocationHeaderSize))
+        {
+            return nullptr;
+        }
+
+        void* block = malloc(size + PngAllocationHeaderSize);
+
+        if (block == nullptr)
+        {
+            return nullptr;
+        }
+
+        *static_cast<size_t*>(block) = size;
+        RecordMemoryAllocation(MemoryUsageCategory::ImageEncoder, static_cast<uint64_t>(size));
+
+        return static_cast<uint8*>(block) + PngAllocationHeaderSize;
+    }
+
+    void PngFree(png_structp png_ptr, png_voidp ptr)
+    {
+        (void)png_ptr;
+
+        if (ptr != nullptr)
+        {
+            void* block = static_cast<uint8*>(ptr) - PngAllocationHeaderSize;
+
+            RecordMemoryFree(MemoryUsageCategory::ImageEncoder, static_cast<uint64_t>(*static_cast<size_t*>(block)));
+            free(block);
+        }
+    }
+
     void WritePngData(png_structp png_ptr, png_bytep data, png_size_t length)
     {
         FileHandle* fileHandle = static_cast<FileHandle*>(png_get_io_ptr(png_ptr));
@@ -125,29 +168,39 @@ namespace
     }
 
     int32 GetMaxInputChunkHeight(
-        const FilterRecordPtr filterRecord,
+        uint64 hostBufferSpace,
+        int32 hostTileHeight,
         int32 inputRowBytes,
         int32 inputHeight)
     {
-        const int32 maxBufferSpace = filterRecord->bufferProcs->spaceProc();
-        const int32 maxHeight = ::std::min(GetTileHeight(filterRecord->outTileHeight), inputHeight);
+        // Use smaller chunks when the remaining memory budget is less than the host buffer space.
+        const int32 maxBufferSpace = static_cast<int32>(::std::min(
+            ::std::min(static_cast<uint64_t>(hostBufferSpace), GetRemainingMemoryBudget()),
+            static_cast<uint64_t>(::std::numeric_limits<int32>::max())));
+        const int32 maxHeight = ::std::min(hostTileHeight, inputHeight);
 
         return ::std::min(::std::max(maxBufferSpace / inputRowBytes, 1), maxHeight);
     }
 
     OSErr SavePngImage(
-        const FilterRecordPtr filterRecord,
         FileHandle* inputFile,
         const Gmic8bfImageHeader& inputFileHeader,
         FileHandle* outputFile,
+        uint8* inputBuffer,
+        int32 inputRowBytes,
+        int32 maxInputChunkHeight,
         PngErrorData* errorData)
     {
         OSErr err = noErr;
 
-        BufferID inputDataBufferID = nullptr;
-        bool inputBufferValid = false;
-
-        png_structp pngPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, static_cast<png_voidp>(errorData), PngWriteErrorHandler, nullptr);
+        png_structp pngPtr = png_create_write_struct_2(
+            PNG_LIBPNG_VER_STRING,
+            static_cast<png_voidp>(errorData),
+            PngWriteErrorHandler,
+            nullptr,
+            nullptr,
+            PngMalloc,
+            PngFree);
 
         if (!pngPtr)
         {
@@ -174,13 +227,6 @@ namespace
         {
             png_destroy_write_struct(&pngPtr, &infoPtr);
 
-            if (inputBufferValid)
-            {
-                filterRecord->bufferProcs->unlockProc(inputDataBufferID);
-                filterRecord->bufferProcs->freeProc(inputDataBufferID);
-                inputBufferValid = false;
-            }
-
             return ioErr;
         }
 
@@ -211,7 +257,8 @@ namespace
             break;
         default:
             png_destroy_write_struct(&pngPtr, &infoPtr);
-            return ShowErrorMessage("Unsupported Gmic8bfImage channel count.", filterRecord, paramErr);
+            errorData->SetErrorMessage("Unsupported Gmic8bfImage channel count.");
+            return paramErr;
         }
 
         png_set_IHDR(
@@ -231,107 +278,63 @@ namespace
 
         if (err == noErr)
         {
-            int32 inputRowBytes = 0;
-
-            if (!TryMultiplyInt32(width, numberOfChannels, inputRowBytes))
+            for (int32 y = 0; y < height; y += maxInputChunkHeight)
             {
-                // The multiplication would have resulted in an integer overflow / underflow.
-                png_destroy_write_struct(&pngPtr, &infoPtr);
-                return memFullErr;
-            }
+                const int32 top = y;
+                const int32 bottom = ::std::min(y + maxInputChunkHeight, height);
 
-            if (bitsPerChannel == 16)
-            {
-                if (!TryMultiplyInt32(inputRowBytes, 2, inputRowBytes))
-                {
-                    // The multiplication would have resulted in an integer overflow / underflow.
-                    png_destroy_write_struct(&pngPtr, &infoPtr);
-                    return memFullErr;
-                }
-            }
-
-            const int32 maxInputChunkHeight = GetMaxInputChunkHeight(filterRecord, inputRowBytes, height);
+                const int32 rowCount = bottom - top;
 
-            int32 inputImageBufferSize;
+                FillInputDataBuffer(
+                    inputFile,
+                    inputBuffer,
+                    inputRowBytes,
+                    rowCount,
+                    errorData);
 
-            if (!TryMultiplyInt32(inputRowBytes, maxInputChunkHeight, inputImageBufferSize))
-            {
-                // The multiplication would have resulted in an integer overflow / underflow.
-                err = memFullErr;
-            }
+                err = errorData->GetWriteErrorCode();
 
-            if (err == noErr)
-            {
-                err = filterRecord->bufferProcs->allocateProc(inputImageBufferSize, &inputDataBufferID);
+                if (err != noErr)
+                {
+                    break;
+                }
 
-                if (err == noErr)
+                // PNG uses big-endian byte order for 16-bit image data, so we need to
+                // byte-swap on little-endian platforms.
+#if BOOST_ENDIAN_LITTLE_BYTE
+                if (bitsPerChannel == 16)
                 {
-                    inputBufferValid = true;
-                    uint8* inputBuffer = reinterpret_cast<uint8*>(filterRecord->bufferProcs->lockProc(inputDataBufferID, false));
+                    const size_t sampleCount = static_cast<size_t>(width) * rowCount * numberOfChannels;
+                    uint16* data = reinterpret_cast<uint16*>(inputBuffer);
 
-                    for (int32 y = 0; y < height; y += maxInputChunkHeight)
+                    // This loop should be automatically vectorized by the compiler.
+                    for (size_t i = 0; i < sampleCount; i++)
                     {
-                        const int32 top = y;
-                        const int32 bottom = ::std::min(y + maxInputChunkHeight, height);
-
-                        const int32 rowCount = bottom - top;
-
-                        FillInputDataBuffer(
-                            inputFile,
-                            inputBuffer,
-                            inputRowBytes,
-                            rowCount,
-                            errorData);
-
-                        err = errorData->GetWriteErrorCode();
-
-                        if (err != noErr)
-                        {
-                            break;
-                        }
-
-                        // PNG uses big-endian byte order for 16-bit image data, so we need to
-                        // byte-swap on little-endian platforms.
-#if BOOST_ENDIAN_LITTLE_BYTE
-                        if (bitsPerChannel == 16)
-                        {
-                            const size_t sampleCount = static_cast<size_t>(width) * rowCount * numberOfChannels;
-                            uint16* data = reinterpret_cast<uint16*>(inputBuffer);
-
-                            // This loop should be automatically vectorized by the compiler.
-                            for (size_t i = 0; i < sampleCount; i++)
-                            {
-                                boost::endian::endian_reverse_inplace(data[i]);
-                            }
-                        }
+                        boost::endian::endian_reverse_inplace(data[i]);
+                    }
+                }
 #endif // BOOST_ENDIAN_LITTLE_BYTE
 
-                        for (int32 i = 0; i < rowCount; i++)
-                        {
-                            png_bytep row = inputBuffer + (static_cast<int64>(i) * inputRowBytes);
-
-                            png_write_row(pngPtr, row);
-                        }
+                for (int32 i = 0; i < rowCount; i++)
+                {
+                    png_bytep row = inputBuffer + (static_cast<int64>(i) * inputRowBytes);
 
-                        err = errorData->GetWriteErrorCode();
+                    png_write_row(pngPtr, row);
+                }
 
-                        if (err != noErr)
-                        {
-                            break;
-                        }
-                    }
+                err = errorData->GetWriteErrorCode();
 
-                    if (err == noErr)
-                    {
-                        png_write_end(pngPtr, infoPtr);
+                if (err != noErr)
+                {
+                    break;
+                }
+            }
 
-                        err = errorData->GetWriteErrorCode();
-                    }
+            if (err == noErr)
+            {
+                png_write_end(pngPtr, infoPtr);
 
-                    filterRecord->bufferProcs->unlockProc(inputDataBufferID);
-                    filterRecord->bufferProcs->freeProc(inputDataBufferID);
-                    inputBufferValid = false;
-                }
+                err = errorData->GetWriteErrorCode();
             }
         }
 
@@ -342,17 +345,52 @@ namespace
 }
 
 void ConvertGmic8bfImageToPng(
-    const FilterRecordPtr filterRecord,
     const boost::filesystem::path& inputFilePath,
-    const boost::filesystem::path& outputFilePath)
+    const boost::filesystem::path& outputFilePath,
+    uint64 hostBufferSpace,
+    int32 hostTileHeight)
 {
     ::std::unique_ptr<FileHandle> inputFile = OpenFile(inputFilePath, FileOpenMode::Read);
     Gmic8bfImageHeader inputFileHeader(inputFile.get());
 
+    int32 inputRowBytes = 0;
+
+    if (!TryMultiplyInt32(inputFileHeader.GetWidth(), inputFileHeader.GetNumberOfChannels(), inputRowBytes) ||
+        !TryMultiplyInt32(inputRowBytes, inputFileHeader.GetBitsPerChannel() / 8, inputRowBytes))
+    {
+        // The multiplication would have resulted in an integer overflow / underflow.
+        throw ::std::bad_alloc();
+    }
+
+    const int32 maxInputChunkHeight = GetMaxInputChunkHeight(
+        hostBufferSpace,
+        hostTileHeight,
+        inputRowBytes,
+        inputFileHeader.GetHeight());
+
+    int32 inputImageBufferSize = 0;
+
+    if (!TryMultiplyInt32(inputRowBytes, maxInputChunkHeight, inputImageBufferSize))
+    {
+        // The multiplication would have resulted in an integer overflow / underflow.
+        throw ::std::bad_alloc();
+    }
+
+    // The input buffer is allocated here because SavePngImage cannot
+    // create C++ objects that would be skipped by longjmp.
+    PooledBuffer inputBuffer = AcquirePooledBuffer(static_cast<size_t>(inputImageBufferSize));
+
     ::std::unique_ptr<FileHandle> outputFile = OpenFile(outputFilePath, FileOpenMode::Write);
     ::std::unique_ptr<PngErrorData> errorData = ::std::make_unique<PngErrorData>();
 
-    if (SavePngImage(filterRecord, inputFile.get(), inputFileHeader, outputFile.get(), errorData.get()) != noErr)
+    if (SavePngImage(
+        inputFile.get(),
+        inputFileHeader,
+        outputFile.get(),
+        static_cast<uint8*>(inputBuffer.data()),
+        inputRowBytes,
+        maxInputChunkHeight,
+        errorData.get()) != noErr)
     {
         ::std::string errorMessage = errorData->GetErrorMessage();
 
@@ -16,9 +16,13 @@
 #include "GmicPlugin.h"
 #include <boost/filesystem.hpp>
 
+// The host buffer space and tile height limit the size of the image chunks that are read
+// from the input file, they are passed by value because the image may be saved after the
+// FilterRecord is no longer valid.
 void ConvertGmic8bfImageToPng(
-    const FilterRecordPtr filterRecord,
     const boost::filesystem::path& inputFilePath,
-    const boost::filesystem::path& outputFilePath);
+    const boost::filesystem::path& outputFilePath,
+    uint64 hostBufferSpace,
+    int32 hostTileHeight);
 
 #endif // !PNGWRITER_H
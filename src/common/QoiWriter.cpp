@@ -0,0 +1,261 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "QoiWriter.h"
+#include "BufferPool.h"
+#include "FileIO.h"
+#include "Gmic8bfImageHeader.h"
+#include "TilePlanner.h"
+#include <boost/endian.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr uint8 QoiOpIndex = 0x00;
+    constexpr uint8 QoiOpDiff = 0x40;
+    constexpr uint8 QoiOpLuma = 0x80;
+    constexpr uint8 QoiOpRun = 0xc0;
+    constexpr uint8 QoiOpRgb = 0xfe;
+    constexpr uint8 QoiOpRgba = 0xff;
+
+    constexpr int32 QoiMaxRunLength = 62;
+    // The largest encoding of a pixel is the QOI_OP_RGBA tag followed by 4 channel bytes.
+    constexpr size_t QoiMaxBytesPerPixel = 5;
+
+    constexpr uint8 QoiColorSpaceSrgb = 0;
+
+    struct QoiFileHeader
+    {
+        char magic[4];
+        boost::endian::big_uint32_t width;
+        boost::endian::big_uint32_t height;
+        uint8 channels;
+        uint8 colorSpace;
+    };
+
+    static_assert(sizeof(QoiFileHeader) == 14, "The QoiFileHeader structure size is incorrect.");
+
+    struct QoiPixel
+    {
+        uint8 r;
+        uint8 g;
+        uint8 b;
+        uint8 a;
+
+        bool operator==(const QoiPixel& other) const noexcept
+        {
+            return r == other.r && g == other.g && b == other.b && a == other.a;
+        }
+    };
+
+    class QoiEncoder
+    {
+    public:
+
+        QoiEncoder()
+            : index(), previous{ 0, 0, 0, 255 }, runLength(0)
+        {
+        }
+
+        // Encodes a pixel to the output buffer, returns the number of bytes written.
+        size_t EncodePixel(const QoiPixel& pixel, uint8* output) noexcept
+        {
+            size_t bytesWritten = 0;
+
+            if (pixel == previous)
+            {
+                runLength++;
+
+                if (runLength == QoiMaxRunLength)
+                {
+                    bytesWritten = FlushRun(output);
+                }
+
+                return bytesWritten;
+            }
+
+            bytesWritten = FlushRun(output);
+
+            const size_t indexPosition = (static_cast<size_t>(pixel.r) * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+
+            if (index[indexPosition] == pixel)
+            {
+                output[bytesWritten++] = static_cast<uint8>(QoiOpIndex | indexPosition);
+            }
+            else
+            {
+                index[indexPosition] = pixel;
+
+                if (pixel.a == previous.a)
+                {
+                    const int8_t redDiff = static_cast<int8_t>(pixel.r - previous.r);
+                    const int8_t greenDiff = static_cast<int8_t>(pixel.g - previous.g);
+                    const int8_t blueDiff = static_cast<int8_t>(pixel.b - previous.b);
+
+                    const int8_t redGreenDiff = static_cast<int8_t>(redDiff - greenDiff);
+                    const int8_t blueGreenDiff = static_cast<int8_t>(blueDiff - greenDiff);
+
+                    if (redDiff >= -2 && redDiff <= 1 &&
+                        greenDiff >= -2 && greenDiff <= 1 &&
+                        blueDiff >= -2 && blueDiff <= 1)
+                    {
+                        output[bytesWritten++] = static_cast<uint8>(QoiOpDiff | ((redDiff + 2) << 4) | ((greenDiff + 2) << 2) | (blueDiff + 2));
+                    }
+                    else if (redGreenDiff >= -8 && redGreenDiff <= 7 &&
+                             greenDiff >= -32 && greenDiff <= 31 &&
+                             blueGreenDiff >= -8 && blueGreenDiff <= 7)
+                    {
+                        output[bytesWritten++] = static_cast<uint8>(QoiOpLuma | (greenDiff + 32));
+                        output[bytesWritten++] = static_cast<uint8>(((redGreenDiff + 8) << 4) | (blueGreenDiff + 8));
+                    }
+                    else
+                    {
+                        output[bytesWritten++] = QoiOpRgb;
+                        output[bytesWritten++] = pixel.r;
+                        output[bytesWritten++] = pixel.g;
+                        output[bytesWritten++] = pixel.b;
+                    }
+                }
+                else
+                {
+                    output[bytesWritten++] = QoiOpRgba;
+                    output[bytesWritten++] = pixel.r;
+                    output[bytesWritten++] = pixel.g;
+                    output[bytesWritten++] = pixel.b;
+                    output[bytesWritten++] = pixel.a;
+                }
+            }
+
+            previous = pixel;
+
+            return bytesWritten;
+        }
+
+        size_t FlushRun(uint8* output) noexcept
+        {
+            if (runLength == 0)
+            {
+                return 0;
+            }
+
+            output[0] = static_cast<uint8>(QoiOpRun | (runLength - 1));
+            runLength = 0;
+
+            return 1;
+        }
+
+    private:
+
+        QoiPixel index[64];
+        QoiPixel previous;
+        int32 runLength;
+    };
+
+    QoiPixel ReadPixel(const uint8* source, int32 numberOfChannels) noexcept
+    {
+        switch (numberOfChannels)
+        {
+        case 1:
+            return QoiPixel{ source[0], source[0], source[0], 255 };
+        case 2:
+            return QoiPixel{ source[0], source[0], source[0], source[1] };
+        case 3:
+            return QoiPixel{ source[0], source[1], source[2], 255 };
+        case 4:
+        default:
+            return QoiPixel{ source[0], source[1], source[2], source[3] };
+        }
+    }
+}
+
+void ConvertGmic8bfImageToQoi(
+    const boost::filesystem::path& inputFilePath,
+    const boost::filesystem::path& outputFilePath)
+{
+    ::std::unique_ptr<FileHandle> inputFile = OpenFile(inputFilePath, FileOpenMode::Read);
+    const Gmic8bfImageHeader inputFileHeader(inputFile.get());
+
+    const int32 width = inputFileHeader.GetWidth();
+    const int32 height = inputFileHeader.GetHeight();
+    const int32 numberOfChannels = inputFileHeader.GetNumberOfChannels();
+
+    if (inputFileHeader.IsPlanar())
+    {
+        throw ::std::runtime_error("The QOI writer does not support planar Gmic8bfImages.");
+    }
+
+    if (inputFileHeader.GetBitsPerChannel() != 8)
+    {
+        throw ::std::runtime_error("The QOI format only supports 8-bit images.");
+    }
+
+    if (numberOfChannels < 1 || numberOfChannels > 4)
+    {
+        throw ::std::runtime_error("Unsupported Gmic8bfImage channel count.");
+    }
+
+    const TileGeometry stripGeometry = PlanBufferStripGeometry(width, height, numberOfChannels, __FUNCTION__);
+
+    const size_t inputRowBytes = static_cast<size_t>(width) * static_cast<size_t>(numberOfChannels);
+
+    PooledBuffer inputBuffer = AcquirePooledBuffer(inputRowBytes * static_cast<size_t>(stripGeometry.height));
+    // The output buffer holds the worst case encoding of a strip.
+    PooledBuffer outputBuffer = AcquirePooledBuffer(static_cast<size_t>(width) * static_cast<size_t>(stripGeometry.height) * QoiMaxBytesPerPixel);
+
+    const uint8* const inputScan0 = static_cast<const uint8*>(inputBuffer.data());
+    uint8* const outputScan0 = static_cast<uint8*>(outputBuffer.data());
+
+    ::std::unique_ptr<FileHandle> outputFile = OpenFile(outputFilePath, FileOpenMode::Write);
+
+    QoiFileHeader fileHeader{};
+    fileHeader.magic[0] = 'q';
+    fileHeader.magic[1] = 'o';
+    fileHeader.magic[2] = 'i';
+    fileHeader.magic[3] = 'f';
+    fileHeader.width = static_cast<uint32>(width);
+    fileHeader.height = static_cast<uint32>(height);
+    fileHeader.channels = inputFileHeader.HasAlphaChannel() ? 4 : 3;
+    fileHeader.colorSpace = QoiColorSpaceSrgb;
+
+    WriteFile(outputFile.get(), &fileHeader, sizeof(fileHeader));
+
+    QoiEncoder encoder;
+
+    for (int32 y = 0; y < height; y += stripGeometry.height)
+    {
+        const int32 rowCount = ::std::min(stripGeometry.height, height - y);
+        const size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(rowCount);
+
+        ReadFile(inputFile.get(), inputBuffer.data(), inputRowBytes * static_cast<size_t>(rowCount));
+
+        size_t outputLength = 0;
+
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            const QoiPixel pixel = ReadPixel(inputScan0 + (i * static_cast<size_t>(numberOfChannels)), numberOfChannels);
+
+            outputLength += encoder.EncodePixel(pixel, outputScan0 + outputLength);
+        }
+
+        if ((y + rowCount) == height)
+        {
+            outputLength += encoder.FlushRun(outputScan0 + outputLength);
+        }
+
+        WriteFile(outputFile.get(), outputScan0, outputLength);
+    }
+
+    static const uint8 endMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+    WriteFile(outputFile.get(), endMarker, sizeof(endMarker));
+}
@@ -0,0 +1,24 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef QOIWRITER_H
+#define QOIWRITER_H
+
+#include "Common.h"
+#include <boost/filesystem.hpp>
+
+// Writes an 8-bit Gmic8bfImage as a QOI image, the gray images are written as RGB.
+void ConvertGmic8bfImageToQoi(
+    const boost::filesystem::path& inputFilePath,
+    const boost::filesystem::path& outputFilePath);
+
+#endif // !QOIWRITER_H
@@ -12,19 +12,22 @@
 
 #include "stdafx.h"
 #include "GmicPlugin.h"
+#include "BackgroundImageWriter.h"
 #include "GmicIOSettings.h"
 #include "FolderBrowser.h"
 #include "ImageSaveDialog.h"
 #include "Gmic8bfImageReader.h"
 #include "GmicQtParameters.h"
-#include "ExrWriter.h"
-#include "PngWriter.h"
+#include "FileUtil.h"
+#include "ImageResampler.h"
+#include "OutputImageWriter.h"
 #include "resource.h"
 #include "Utilities.h"
 #include <algorithm>
 #include <memory>
 #include <vector>
 #include <wil\result.h>
+#include <wil\resource.h>
 #include <setjmp.h>
 #include <png.h>
 
@@ -84,7 +87,7 @@ namespace
         const GmicIOSettings& settings,
         const boost::filesystem::path& originalFileName,
         boost::filesystem::path& outputFileName,
-        int32 bitsPerChannel)
+        OutputImageFileType fileType)
     {
         bool haveFilePathFromDefaultFolder = false;
 
@@ -114,7 +117,7 @@ namespace
         }
         else
         {
-            return GetNewImageFileName(filterRecord, originalFileName, outputFileName, bitsPerChannel);
+            return GetNewImageFileName(filterRecord, originalFileName, outputFileName, fileType);
         }
     }
 }
@@ -141,19 +144,44 @@ OSErr ReadGmicOutput(
         }
         else
         {
-            const char* const outputFileExtension = hostBitDepth == 32 ? ".exr" : ".png";
+            // The images that are not written back to the document use the bit depth
+            // of the images that were sent to G'MIC-Qt.
+            const int32 gmicBitDepth = GetGmicImageDepth(hostBitDepth, settings);
+            const OutputImageFileType outputFileType = GetOutputImageFileType(settings.GetOutputFileFormat(), gmicBitDepth);
+            const char* const outputFileExtension = GetOutputImageFileExtension(outputFileType);
 
             GmicQtParameters parameters(gmicParametersFilePath);
+            const OutputImageWriterOptions outputWriterOptions = GetOutputImageWriterOptions(filterRecord);
 
             if (filePaths.size() == 1)
             {
                 const boost::filesystem::path& filePath = filePaths[0];
-                const VPoint& documentSize = GetImageSize(filterRecord);
-                bool imageSizeMatchesDocument = ImageSizeMatchesDocument(filePath, documentSize);
+                const VRect regionOfInterest = GetRegionOfInterest(filterRecord, settings);
+
+                VPoint regionSize{};
+                regionSize.h = regionOfInterest.right - regionOfInterest.left;
+                regionSize.v = regionOfInterest.bottom - regionOfInterest.top;
+
+                bool imageSizeMatchesDocument = ImageSizeMatchesDocument(filePath, regionSize);
 
                 if (imageSizeMatchesDocument)
                 {
-                    CopyImageToActiveLayer(filePath, filterRecord, hostBitDepth);
+                    CopyImageToActiveLayer(filePath, filterRecord, hostBitDepth, regionOfInterest);
+                }
+                else if (settings.GetResampleOutputToDocument())
+                {
+                    const boost::filesystem::path resampledImagePath = GetTemporaryFileName(GetInputDirectory(), ".g8i");
+
+                    // The resampled image is only used to update the document.
+                    auto resampledImageCleanup = wil::scope_exit([&]
+                    {
+                        boost::system::error_code ec;
+                        boost::filesystem::remove(resampledImagePath, ec);
+                    });
+
+                    ResampleGmic8bfImage(filePath, resampledImagePath, regionSize.h, regionSize.v);
+
+                    CopyImageToActiveLayer(resampledImagePath, filterRecord, hostBitDepth, regionOfInterest);
                 }
                 else
                 {
@@ -164,16 +192,10 @@ OSErr ReadGmicOutput(
                         settings,
                         parameters.PrependGmicCommandName(filePath.filename()).replace_extension(outputFileExtension),
                         outputFilePath,
-                        hostBitDepth));
+                        outputFileType));
 
-                    if (hostBitDepth == 32)
-                    {
-                        ConvertGmic8bfImageToExr(filterRecord, filePath, outputFilePath);
-                    }
-                    else
-                    {
-                        ConvertGmic8bfImageToPng(filterRecord, filePath, outputFilePath);
-                    }
+                    // The image is saved after the filter returns to the host.
+                    QueueBackgroundImageSave(outputWriterOptions, outputFileType, filePath, outputFilePath);
                 }
             }
             else
@@ -191,14 +213,7 @@ OSErr ReadGmicOutput(
                     boost::filesystem::path outputFilePath = outputFolder;
                     outputFilePath /= parameters.PrependGmicCommandName(inputFilePath.filename()).replace_extension(outputFileExtension);
 
-                    if (hostBitDepth == 32)
-                    {
-                        ConvertGmic8bfImageToExr(filterRecord, inputFilePath, outputFilePath);
-                    }
-                    else
-                    {
-                        ConvertGmic8bfImageToPng(filterRecord, inputFilePath, outputFilePath);
-                    }
+                    QueueBackgroundImageSave(outputWriterOptions, outputFileType, inputFilePath, outputFilePath);
                 }
             }
 
@@ -14,20 +14,23 @@
 #define SCOPEDBUFFERSUITE_H
 
 #include "Common.h"
+#include "MemoryUsage.h"
 
 class ScopedBufferSuiteBuffer
 {
 public:
     explicit ScopedBufferSuiteBuffer(FilterRecordPtr filterRecord, int32 bufferSize)
-        : bufferID(), bufferDataPtr(nullptr), filterRecord(filterRecord), bufferIDValid(false)
+        : bufferID(), bufferDataPtr(nullptr), filterRecord(filterRecord), bufferIDValid(false),
+          bufferSize(bufferSize)
     {
         OSErrException::ThrowIfError(filterRecord->bufferProcs->allocateProc(bufferSize, &bufferID));
         bufferIDValid = true;
+        RecordMemoryAllocation(MemoryUsageCategory::HostBuffer, static_cast<uint64_t>(bufferSize));
     }
 
     ScopedBufferSuiteBuffer(ScopedBufferSuiteBuffer&& other) noexcept
         : bufferID(other.bufferID), filterRecord(other.filterRecord), bufferIDValid(other.bufferIDValid),
-        bufferDataPtr(other.bufferDataPtr)
+        bufferDataPtr(other.bufferDataPtr), bufferSize(other.bufferSize)
     {
         other.bufferDataPtr = nullptr;
         other.bufferIDValid = false;
@@ -39,6 +42,7 @@ public:
         filterRecord = other.filterRecord;
         bufferIDValid = other.bufferIDValid;
         bufferDataPtr = other.bufferDataPtr;
+        bufferSize = other.bufferSize;
 
         other.bufferDataPtr = nullptr;
         other.bufferIDValid = false;
@@ -59,6 +63,7 @@ public:
                 filterRecord->bufferProcs->unlockProc(bufferID);
             }
             filterRecord->bufferProcs->freeProc(bufferID);
+            RecordMemoryFree(MemoryUsageCategory::HostBuffer, static_cast<uint64_t>(bufferSize));
         }
     }
 
@@ -87,6 +92,7 @@ private:
     void* bufferDataPtr;
     FilterRecordPtr filterRecord;
     bool bufferIDValid;
+    int32 bufferSize;
 };
 
 #endif // !SCOPEDBUFFERSUITE_H
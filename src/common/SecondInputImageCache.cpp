@@ -0,0 +1,467 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "SecondInputImageCache.h"
+#include "BufferPool.h"
+#include "FileIO.h"
+#include "FileUtil.h"
+#include "ImageConversion.h"
+#include <boost/endian.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <vector>
+
+namespace
+{
+    // The cached image is a Gmic8bfImage, the version must be changed when the
+    // Gmic8bfImage writer format changes so that the old images are not reused.
+    constexpr int32 CacheEntryFileVersion = 2;
+
+    constexpr size_t HashBufferSize = 1024 * 1024;
+
+    // The number of source images that are kept in the cache.
+    constexpr size_t MaxCacheEntries = 4;
+
+    constexpr uint64 FnvOffsetBasis = 14695981039346656037ULL;
+    constexpr uint64 FnvPrime = 1099511628211ULL;
+
+    struct CacheEntryFileHeader
+    {
+        CacheEntryFileHeader() : version(CacheEntryFileVersion), reserved()
+        {
+            // G8SC = GMIC 8BF second input cache
+            signature[0] = 'G';
+            signature[1] = '8';
+            signature[2] = 'S';
+            signature[3] = 'C';
+        }
+
+        char signature[4];
+        boost::endian::little_int32_t version;
+        char reserved[8];
+    };
+
+    struct CacheEntryImageInfo
+    {
+        boost::endian::little_uint64_t fileSize;
+        boost::endian::little_int64_t lastWriteTime;
+        boost::endian::little_uint64_t contentHash;
+        boost::endian::little_int32_t imageWidth;
+        boost::endian::little_int32_t imageHeight;
+    };
+
+    struct CacheEntry
+    {
+        boost::filesystem::path sourcePath;
+        // The name of the cached image in the cache directory, each update of an entry
+        // uses a new image file so that an entry never refers to another image.
+        boost::filesystem::path imageFileName;
+        uint64 fileSize;
+        int64 lastWriteTime;
+        uint64 contentHash;
+        int32 imageWidth;
+        int32 imageHeight;
+    };
+
+    // Updates a 64-bit FNV-1a hash with the specified data.
+    uint64 HashData(uint64 hash, const uint8* data, size_t size) noexcept
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= data[i];
+            hash *= FnvPrime;
+        }
+
+        return hash;
+    }
+
+    // Gets the entry file for a source image, the name is derived from the source path so
+    // that the processes which cache different images do not write to the same files.
+    boost::filesystem::path GetCacheEntryPath(const boost::filesystem::path& sourcePath)
+    {
+        const boost::filesystem::path::string_type& value = sourcePath.native();
+
+        const uint64 key = HashData(
+            FnvOffsetBasis,
+            reinterpret_cast<const uint8*>(value.c_str()),
+            value.size() * sizeof(boost::filesystem::path::value_type));
+
+        char fileName[64]{};
+
+        ::std::snprintf(fileName, sizeof(fileName), "SecondInput-%016llx.dat", static_cast<unsigned long long>(key));
+
+        boost::filesystem::path path = GetImageCacheDirectory();
+        path /= fileName;
+
+        return path;
+    }
+
+    // Computes the 64-bit FNV-1a hash of the file contents.
+    uint64 ComputeFileHash(const boost::filesystem::path& path, uint64 fileSize)
+    {
+        ::std::unique_ptr<FileHandle> file = OpenFile(path, FileOpenMode::Read);
+
+        const size_t bufferSize = static_cast<size_t>(::std::min(fileSize, static_cast<uint64>(HashBufferSize)));
+
+        PooledBuffer buffer = AcquirePooledBuffer(::std::max(bufferSize, static_cast<size_t>(1)));
+        const uint8* const data = static_cast<const uint8*>(buffer.data());
+
+        uint64 hash = FnvOffsetBasis;
+        uint64 bytesRemaining = fileSize;
+
+        while (bytesRemaining > 0)
+        {
+            const size_t chunkSize = static_cast<size_t>(::std::min(bytesRemaining, static_cast<uint64>(bufferSize)));
+
+            ReadFile(file.get(), buffer.data(), chunkSize);
+
+            hash = HashData(hash, data, chunkSize);
+
+            bytesRemaining -= chunkSize;
+        }
+
+        return hash;
+    }
+
+    void ReadFilePath(FileHandle* fileHandle, boost::filesystem::path& value)
+    {
+        boost::endian::little_uint32_t stringLength = 0;
+
+        ReadFile(fileHandle, &stringLength, sizeof(stringLength));
+
+        if (stringLength == 0)
+        {
+            value = boost::filesystem::path();
+        }
+        else
+        {
+            constexpr size_t pathCharSize = sizeof(boost::filesystem::path::value_type);
+
+            if (stringLength > (::std::numeric_limits<size_t>::max() / pathCharSize))
+            {
+                throw ::std::runtime_error("The string cannot be read from the file because it is too long.");
+            }
+
+            ::std::vector<boost::filesystem::path::value_type> stringChars(stringLength);
+
+            ReadFile(fileHandle, &stringChars[0], stringLength * pathCharSize);
+
+            value.assign(stringChars.begin(), stringChars.end());
+        }
+    }
+
+    void WriteFilePath(FileHandle* fileHandle, const boost::filesystem::path& value)
+    {
+        constexpr size_t pathCharSize = sizeof(boost::filesystem::path::value_type);
+
+        if (value.size() > ::std::numeric_limits<uint32_t>::max())
+        {
+            throw ::std::runtime_error("The string cannot be written to the file because it is too long.");
+        }
+
+        boost::endian::little_uint32_t stringLength = static_cast<uint32_t>(value.size());
+
+        WriteFile(fileHandle, &stringLength, sizeof(stringLength));
+
+        if (value.size() > 0)
+        {
+            WriteFile(fileHandle, value.c_str(), value.size() * pathCharSize);
+        }
+    }
+
+    bool TryReadCacheEntry(const boost::filesystem::path& path, CacheEntry& entry)
+    {
+        boost::system::error_code ec;
+
+        if (!boost::filesystem::is_regular_file(path, ec))
+        {
+            return false;
+        }
+
+        ::std::unique_ptr<FileHandle> file = OpenFile(path, FileOpenMode::Read);
+
+        CacheEntryFileHeader header{};
+
+        ReadFile(file.get(), &header, sizeof(header));
+
+        if (strncmp(header.signature, "G8SC", 4) != 0 || header.version != CacheEntryFileVersion)
+        {
+            return false;
+        }
+
+        ReadFilePath(file.get(), entry.sourcePath);
+        ReadFilePath(file.get(), entry.imageFileName);
+
+        CacheEntryImageInfo info{};
+
+        ReadFile(file.get(), &info, sizeof(info));
+
+        entry.fileSize = info.fileSize;
+        entry.lastWriteTime = info.lastWriteTime;
+        entry.contentHash = info.contentHash;
+        entry.imageWidth = info.imageWidth;
+        entry.imageHeight = info.imageHeight;
+
+        return true;
+    }
+
+    // Writes the entry to a temporary file and renames it, so the entry file always
+    // refers to an image that was completely written.
+    void WriteCacheEntry(const boost::filesystem::path& path, const CacheEntry& entry)
+    {
+        const boost::filesystem::path tempPath = GetTemporaryFileName(path.parent_path(), ".tmp");
+
+        {
+            ::std::unique_ptr<FileHandle> file = OpenFile(tempPath, FileOpenMode::Write);
+
+            CacheEntryFileHeader header;
+
+            WriteFile(file.get(), &header, sizeof(header));
+
+            WriteFilePath(file.get(), entry.sourcePath);
+            WriteFilePath(file.get(), entry.imageFileName);
+
+            CacheEntryImageInfo info{};
+            info.fileSize = entry.fileSize;
+            info.lastWriteTime = entry.lastWriteTime;
+            info.contentHash = entry.contentHash;
+            info.imageWidth = entry.imageWidth;
+            info.imageHeight = entry.imageHeight;
+
+            WriteFile(file.get(), &info, sizeof(info));
+        }
+
+        boost::filesystem::rename(tempPath, path);
+    }
+
+    // Links the existing file to the new path, or copies it if a hard link cannot be
+    // created, e.g. when the paths are on different volumes.
+    void LinkOrCopyFile(const boost::filesystem::path& existing, const boost::filesystem::path& newPath)
+    {
+        boost::system::error_code ec;
+
+        boost::filesystem::create_hard_link(existing, newPath, ec);
+
+        if (ec)
+        {
+            boost::filesystem::copy_file(existing, newPath);
+        }
+    }
+
+    bool TryGetCachedImage(
+        const boost::filesystem::path& input,
+        uint64 fileSize,
+        int64 lastWriteTime,
+        ::std::unique_ptr<InputLayerInfo>& output)
+    {
+        CacheEntry entry{};
+
+        if (!TryReadCacheEntry(GetCacheEntryPath(input), entry) ||
+            entry.sourcePath != input ||
+            entry.imageFileName.empty() ||
+            entry.fileSize != fileSize ||
+            entry.lastWriteTime != lastWriteTime)
+        {
+            return false;
+        }
+
+        const boost::filesystem::path cachedImagePath = GetImageCacheDirectory() / entry.imageFileName.filename();
+
+        boost::system::error_code ec;
+
+        if (!boost::filesystem::is_regular_file(cachedImagePath, ec) ||
+            ComputeFileHash(input, fileSize) != entry.contentHash)
+        {
+            return false;
+        }
+
+        const boost::filesystem::path path = GetTemporaryFileName(GetInputDirectory(), ".g8i");
+
+        LinkOrCopyFile(cachedImagePath, path);
+
+        output.reset(new InputLayerInfo(
+            path,
+            entry.imageWidth,
+            entry.imageHeight,
+            true,
+            "2nd Layer"));
+
+        return true;
+    }
+
+    // Removes an entry and the image that it refers to. Another process that is reading
+    // the entry will fail to link the image and convert the source image again.
+    void RemoveCacheEntry(const boost::filesystem::path& entryPath)
+    {
+        CacheEntry entry{};
+        boost::system::error_code ec;
+
+        try
+        {
+            if (TryReadCacheEntry(entryPath, entry) && !entry.imageFileName.empty())
+            {
+                boost::filesystem::remove(GetImageCacheDirectory() / entry.imageFileName.filename(), ec);
+            }
+        }
+        catch (const ::std::exception&)
+        {
+            // The entry file is removed even if it cannot be read.
+        }
+
+        boost::filesystem::remove(entryPath, ec);
+    }
+
+    // Removes the least recently written entries when the cache has too many entries.
+    void TrimCache(const boost::filesystem::path& currentEntryPath)
+    {
+        struct EntryFile
+        {
+            boost::filesystem::path path;
+            ::std::time_t lastWriteTime;
+        };
+
+        ::std::vector<EntryFile> entryFiles;
+        boost::system::error_code ec;
+
+        for (boost::filesystem::directory_iterator it(GetImageCacheDirectory(), ec), end; !ec && it != end; it.increment(ec))
+        {
+            const boost::filesystem::path& path = it->path();
+
+            if (path.extension() == ".dat" && path != currentEntryPath)
+            {
+                boost::system::error_code timeError;
+                const ::std::time_t lastWriteTime = boost::filesystem::last_write_time(path, timeError);
+
+                entryFiles.push_back(EntryFile{ path, timeError ? 0 : lastWriteTime });
+            }
+        }
+
+        // The current entry is always kept.
+        if (entryFiles.size() < MaxCacheEntries)
+        {
+            return;
+        }
+
+        ::std::sort(entryFiles.begin(), entryFiles.end(), [](const EntryFile& a, const EntryFile& b)
+        {
+            return a.lastWriteTime > b.lastWriteTime;
+        });
+
+        for (size_t i = MaxCacheEntries - 1; i < entryFiles.size(); i++)
+        {
+            RemoveCacheEntry(entryFiles[i].path);
+        }
+    }
+
+    void AddImageToCache(
+        const boost::filesystem::path& input,
+        uint64 fileSize,
+        int64 lastWriteTime,
+        const InputLayerInfo& layer)
+    {
+        const boost::filesystem::path entryPath = GetCacheEntryPath(input);
+        const boost::filesystem::path cachedImagePath = GetTemporaryFileName(GetImageCacheDirectory(), ".g8i");
+
+        CacheEntry oldEntry{};
+        boost::system::error_code ec;
+
+        try
+        {
+            if (!TryReadCacheEntry(entryPath, oldEntry))
+            {
+                oldEntry.imageFileName.clear();
+            }
+        }
+        catch (const ::std::exception&)
+        {
+            // A damaged entry is replaced without removing its image.
+            oldEntry.imageFileName.clear();
+        }
+
+        LinkOrCopyFile(layer.GetImagePath(), cachedImagePath);
+
+        try
+        {
+            CacheEntry entry{};
+            entry.sourcePath = input;
+            entry.imageFileName = cachedImagePath.filename();
+            entry.fileSize = fileSize;
+            entry.lastWriteTime = lastWriteTime;
+            entry.contentHash = ComputeFileHash(input, fileSize);
+            entry.imageWidth = layer.GetWidth();
+            entry.imageHeight = layer.GetHeight();
+
+            WriteCacheEntry(entryPath, entry);
+        }
+        catch (...)
+        {
+            boost::filesystem::remove(cachedImagePath, ec);
+            throw;
+        }
+
+        // The replaced entry referred to its own image file.
+        if (!oldEntry.imageFileName.empty())
+        {
+            boost::filesystem::remove(GetImageCacheDirectory() / oldEntry.imageFileName.filename(), ec);
+        }
+
+        TrimCache(entryPath);
+    }
+}
+
+void ConvertImageToGmicInputFormatCached(
+    const boost::filesystem::path& input,
+    ::std::unique_ptr<InputLayerInfo>& output)
+{
+    boost::system::error_code ec;
+
+    const uint64 fileSize = boost::filesystem::file_size(input, ec);
+    const int64 lastWriteTime = ec ? 0 : static_cast<int64>(boost::filesystem::last_write_time(input, ec));
+
+    if (ec)
+    {
+        // Let the image decoder handle the file not found errors.
+        ConvertImageToGmicInputFormat(input, output, /*ignoreFileNotFound*/true);
+        return;
+    }
+
+    // The cache is an optimization, any errors that occur when reading or updating it
+    // are ignored and the image is converted normally.
+    try
+    {
+        if (TryGetCachedImage(input, fileSize, lastWriteTime, output))
+        {
+            return;
+        }
+    }
+    catch (const ::std::exception&)
+    {
+        output.reset();
+    }
+
+    ConvertImageToGmicInputFormat(input, output, /*ignoreFileNotFound*/true);
+
+    if (output)
+    {
+        try
+        {
+            AddImageToCache(input, fileSize, lastWriteTime, *output.get());
+        }
+        catch (const ::std::exception&)
+        {
+            // The existing cache entry is only replaced after the new image was cached.
+        }
+    }
+}
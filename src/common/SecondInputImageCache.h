@@ -0,0 +1,26 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef SECONDINPUTIMAGECACHE_H
+#define SECONDINPUTIMAGECACHE_H
+
+#include "Common.h"
+#include "InputLayerInfo.h"
+#include <memory>
+
+// Converts the second input image file to a Gmic8bfImage, reusing the previously converted
+// image when the file size, modification time and contents have not changed.
+void ConvertImageToGmicInputFormatCached(
+    const boost::filesystem::path& input,
+    ::std::unique_ptr<InputLayerInfo>& output);
+
+#endif // !SECONDINPUTIMAGECACHE_H
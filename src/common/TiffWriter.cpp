@@ -0,0 +1,387 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "TiffWriter.h"
+#include "BufferPool.h"
+#include "FileIO.h"
+#include "Gmic8bfImageHeader.h"
+#include "Utilities.h"
+#include <boost/endian.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <zlib.h>
+
+namespace
+{
+    // The preferred size of the TIFF strips, the strips are compressed independently.
+    constexpr int32 TargetStripSize = 256 * 1024;
+
+    constexpr uint16 TiffTypeShort = 3;
+    constexpr uint16 TiffTypeLong = 4;
+
+    constexpr uint16 TiffTagImageWidth = 256;
+    constexpr uint16 TiffTagImageLength = 257;
+    constexpr uint16 TiffTagBitsPerSample = 258;
+    constexpr uint16 TiffTagCompression = 259;
+    constexpr uint16 TiffTagPhotometricInterpretation = 262;
+    constexpr uint16 TiffTagStripOffsets = 273;
+    constexpr uint16 TiffTagSamplesPerPixel = 277;
+    constexpr uint16 TiffTagRowsPerStrip = 278;
+    constexpr uint16 TiffTagStripByteCounts = 279;
+    constexpr uint16 TiffTagPlanarConfiguration = 284;
+    constexpr uint16 TiffTagPredictor = 317;
+    constexpr uint16 TiffTagExtraSamples = 338;
+    constexpr uint16 TiffTagSampleFormat = 339;
+
+    constexpr uint16 TiffCompressionNone = 1;
+    constexpr uint16 TiffCompressionDeflate = 8;
+
+    constexpr uint16 TiffPhotometricMinIsBlack = 1;
+    constexpr uint16 TiffPhotometricRgb = 2;
+
+    constexpr uint16 TiffPredictorHorizontal = 2;
+
+    constexpr uint16 TiffExtraSampleUnassociatedAlpha = 2;
+
+    constexpr uint16 TiffSampleFormatUnsignedInteger = 1;
+    constexpr uint16 TiffSampleFormatFloatingPoint = 3;
+
+    struct TiffFileHeader
+    {
+        char byteOrder[2];
+        boost::endian::little_uint16_t magic;
+        boost::endian::little_uint32_t firstIfdOffset;
+    };
+
+    struct TiffIfdEntry
+    {
+        boost::endian::little_uint16_t tag;
+        boost::endian::little_uint16_t type;
+        boost::endian::little_uint32_t count;
+        uint8 valueOrOffset[4];
+    };
+
+    static_assert(sizeof(TiffFileHeader) == 8, "The TiffFileHeader structure size is incorrect.");
+    static_assert(sizeof(TiffIfdEntry) == 12, "The TiffIfdEntry structure size is incorrect.");
+
+    // Builds a TIFF image file directory, the values that do not fit in an entry
+    // are written after the directory.
+    class TiffIfdBuilder
+    {
+    public:
+
+        void AddShorts(uint16 tag, const ::std::vector<uint16>& values)
+        {
+            Field field{ tag, TiffTypeShort, static_cast<uint32>(values.size()), {} };
+
+            for (uint16 value : values)
+            {
+                const boost::endian::little_uint16_t littleEndianValue = value;
+                const uint8* bytes = reinterpret_cast<const uint8*>(&littleEndianValue);
+
+                field.data.insert(field.data.end(), bytes, bytes + sizeof(littleEndianValue));
+            }
+
+            fields.push_back(::std::move(field));
+        }
+
+        void AddShort(uint16 tag, uint16 value)
+        {
+            AddShorts(tag, ::std::vector<uint16>(1, value));
+        }
+
+        void AddLongs(uint16 tag, const ::std::vector<uint32>& values)
+        {
+            Field field{ tag, TiffTypeLong, static_cast<uint32>(values.size()), {} };
+
+            for (uint32 value : values)
+            {
+                const boost::endian::little_uint32_t littleEndianValue = value;
+                const uint8* bytes = reinterpret_cast<const uint8*>(&littleEndianValue);
+
+                field.data.insert(field.data.end(), bytes, bytes + sizeof(littleEndianValue));
+            }
+
+            fields.push_back(::std::move(field));
+        }
+
+        void AddLong(uint16 tag, uint32 value)
+        {
+            AddLongs(tag, ::std::vector<uint32>(1, value));
+        }
+
+        void Write(FileHandle* file, uint32 ifdOffset)
+        {
+            // The TIFF specification requires the entries to be sorted in ascending tag order.
+            ::std::sort(fields.begin(), fields.end(), [](const Field& a, const Field& b) { return a.tag < b.tag; });
+
+            const uint64 ifdSize = sizeof(boost::endian::little_uint16_t) + (fields.size() * sizeof(TiffIfdEntry)) + sizeof(boost::endian::little_uint32_t);
+            uint64 externalDataOffset = static_cast<uint64>(ifdOffset) + ifdSize;
+
+            ::std::vector<TiffIfdEntry> entries;
+            entries.reserve(fields.size());
+
+            for (const Field& field : fields)
+            {
+                TiffIfdEntry entry{};
+                entry.tag = field.tag;
+                entry.type = field.type;
+                entry.count = field.count;
+
+                if (field.data.size() <= sizeof(entry.valueOrOffset))
+                {
+                    ::std::memcpy(entry.valueOrOffset, field.data.data(), field.data.size());
+                }
+                else
+                {
+                    const boost::endian::little_uint32_t offset = CheckedFileOffset(externalDataOffset);
+
+                    ::std::memcpy(entry.valueOrOffset, &offset, sizeof(offset));
+
+                    // The values are aligned on a word boundary.
+                    externalDataOffset += (field.data.size() + 1) & ~static_cast<size_t>(1);
+                }
+
+                entries.push_back(entry);
+            }
+
+            CheckedFileOffset(externalDataOffset);
+
+            const boost::endian::little_uint16_t entryCount = static_cast<uint16>(entries.size());
+            const boost::endian::little_uint32_t nextIfdOffset = 0;
+
+            WriteFile(file, &entryCount, sizeof(entryCount));
+            WriteFile(file, entries.data(), entries.size() * sizeof(TiffIfdEntry));
+            WriteFile(file, &nextIfdOffset, sizeof(nextIfdOffset));
+
+            for (const Field& field : fields)
+            {
+                if (field.data.size() > sizeof(TiffIfdEntry::valueOrOffset))
+                {
+                    WriteFile(file, field.data.data(), field.data.size());
+
+                    if ((field.data.size() & 1) != 0)
+                    {
+                        const uint8 padding = 0;
+
+                        WriteFile(file, &padding, sizeof(padding));
+                    }
+                }
+            }
+        }
+
+        static uint32 CheckedFileOffset(uint64 offset)
+        {
+            if (offset > ::std::numeric_limits<uint32>::max())
+            {
+                throw ::std::runtime_error("The image is too large to be saved as a TIFF file.");
+            }
+
+            return static_cast<uint32>(offset);
+        }
+
+    private:
+
+        struct Field
+        {
+            uint16 tag;
+            uint16 type;
+            uint32 count;
+            ::std::vector<uint8> data;
+        };
+
+        ::std::vector<Field> fields;
+    };
+
+    // Applies the TIFF horizontal differencing predictor to a row of samples.
+    template <typename T>
+    void ApplyHorizontalPredictor(T* row, int32 width, int32 numberOfChannels)
+    {
+        const size_t sampleCount = static_cast<size_t>(width) * static_cast<size_t>(numberOfChannels);
+
+        for (size_t i = sampleCount - 1; i >= static_cast<size_t>(numberOfChannels); i--)
+        {
+            row[i] = static_cast<T>(row[i] - row[i - numberOfChannels]);
+        }
+    }
+}
+
+void ConvertGmic8bfImageToTiff(
+    const boost::filesystem::path& inputFilePath,
+    const boost::filesystem::path& outputFilePath,
+    bool deflateCompression)
+{
+    ::std::unique_ptr<FileHandle> inputFile = OpenFile(inputFilePath, FileOpenMode::Read);
+    const Gmic8bfImageHeader inputFileHeader(inputFile.get());
+
+    const int32 width = inputFileHeader.GetWidth();
+    const int32 height = inputFileHeader.GetHeight();
+    const int32 numberOfChannels = inputFileHeader.GetNumberOfChannels();
+    const int32 bitsPerChannel = inputFileHeader.GetBitsPerChannel();
+    const bool floatingPoint = bitsPerChannel == 32;
+
+    if (inputFileHeader.IsPlanar())
+    {
+        throw ::std::runtime_error("The TIFF writer does not support planar Gmic8bfImages.");
+    }
+
+    if (numberOfChannels < 1 || numberOfChannels > 4)
+    {
+        throw ::std::runtime_error("Unsupported Gmic8bfImage channel count.");
+    }
+
+    if (bitsPerChannel != 8 && bitsPerChannel != 16 && bitsPerChannel != 32)
+    {
+        throw ::std::runtime_error("Unsupported bit depth.");
+    }
+
+    int32 rowBytes = 0;
+
+    if (!TryMultiplyInt32(width, numberOfChannels, rowBytes) ||
+        !TryMultiplyInt32(rowBytes, bitsPerChannel / 8, rowBytes))
+    {
+        // The multiplication would have resulted in an integer overflow / underflow.
+        throw ::std::bad_alloc();
+    }
+
+    const int32 rowsPerStrip = ::std::min(::std::max(TargetStripSize / rowBytes, 1), height);
+    const int32 stripCount = (height + rowsPerStrip - 1) / rowsPerStrip;
+    const size_t stripSize = static_cast<size_t>(rowBytes) * static_cast<size_t>(rowsPerStrip);
+
+    PooledBuffer stripBuffer = AcquirePooledBuffer(stripSize);
+    uint8* const stripScan0 = static_cast<uint8*>(stripBuffer.data());
+
+    PooledBuffer compressedBuffer;
+
+    if (deflateCompression)
+    {
+        compressedBuffer = AcquirePooledBuffer(static_cast<size_t>(compressBound(static_cast<uLong>(stripSize))));
+    }
+
+    ::std::unique_ptr<FileHandle> outputFile = OpenFile(outputFilePath, FileOpenMode::Write);
+
+    TiffFileHeader fileHeader{};
+    fileHeader.byteOrder[0] = 'I';
+    fileHeader.byteOrder[1] = 'I';
+    fileHeader.magic = 42;
+    fileHeader.firstIfdOffset = 0;
+
+    WriteFile(outputFile.get(), &fileHeader, sizeof(fileHeader));
+
+    ::std::vector<uint32> stripOffsets;
+    ::std::vector<uint32> stripByteCounts;
+    stripOffsets.reserve(static_cast<size_t>(stripCount));
+    stripByteCounts.reserve(static_cast<size_t>(stripCount));
+
+    uint64 fileOffset = sizeof(fileHeader);
+
+    for (int32 y = 0; y < height; y += rowsPerStrip)
+    {
+        const int32 rowCount = ::std::min(rowsPerStrip, height - y);
+        const size_t stripDataSize = static_cast<size_t>(rowCount) * static_cast<size_t>(rowBytes);
+
+        ReadFile(inputFile.get(), stripScan0, stripDataSize);
+
+        const uint8* stripData = stripScan0;
+        size_t stripDataLength = stripDataSize;
+
+        if (deflateCompression)
+        {
+            if (!floatingPoint)
+            {
+                for (int32 i = 0; i < rowCount; i++)
+                {
+                    uint8* row = stripScan0 + (static_cast<size_t>(i) * rowBytes);
+
+                    if (bitsPerChannel == 16)
+                    {
+                        ApplyHorizontalPredictor(reinterpret_cast<uint16*>(row), width, numberOfChannels);
+                    }
+                    else
+                    {
+                        ApplyHorizontalPredictor(row, width, numberOfChannels);
+                    }
+                }
+            }
+
+            uLongf compressedLength = static_cast<uLongf>(compressedBuffer.size());
+
+            // The fastest compression level is used because the TIFF formats are intended for high throughput.
+            if (compress2(
+                static_cast<Bytef*>(compressedBuffer.data()),
+                &compressedLength,
+                stripScan0,
+                static_cast<uLong>(stripDataSize),
+                Z_BEST_SPEED) != Z_OK)
+            {
+                throw ::std::runtime_error("Unable to compress the TIFF image data.");
+            }
+
+            stripData = static_cast<const uint8*>(compressedBuffer.data());
+            stripDataLength = static_cast<size_t>(compressedLength);
+        }
+
+        stripOffsets.push_back(TiffIfdBuilder::CheckedFileOffset(fileOffset));
+        stripByteCounts.push_back(static_cast<uint32>(stripDataLength));
+
+        WriteFile(outputFile.get(), stripData, stripDataLength);
+        fileOffset += stripDataLength;
+    }
+
+    if ((fileOffset & 1) != 0)
+    {
+        // The image file directory must start on a word boundary.
+        const uint8 padding = 0;
+
+        WriteFile(outputFile.get(), &padding, sizeof(padding));
+        fileOffset++;
+    }
+
+    const uint32 ifdOffset = TiffIfdBuilder::CheckedFileOffset(fileOffset);
+
+    TiffIfdBuilder ifd;
+
+    ifd.AddLong(TiffTagImageWidth, static_cast<uint32>(width));
+    ifd.AddLong(TiffTagImageLength, static_cast<uint32>(height));
+    ifd.AddShorts(TiffTagBitsPerSample, ::std::vector<uint16>(static_cast<size_t>(numberOfChannels), static_cast<uint16>(bitsPerChannel)));
+    ifd.AddShort(TiffTagCompression, deflateCompression ? TiffCompressionDeflate : TiffCompressionNone);
+    ifd.AddShort(TiffTagPhotometricInterpretation, numberOfChannels >= 3 ? TiffPhotometricRgb : TiffPhotometricMinIsBlack);
+    ifd.AddLongs(TiffTagStripOffsets, stripOffsets);
+    ifd.AddShort(TiffTagSamplesPerPixel, static_cast<uint16>(numberOfChannels));
+    ifd.AddLong(TiffTagRowsPerStrip, static_cast<uint32>(rowsPerStrip));
+    ifd.AddLongs(TiffTagStripByteCounts, stripByteCounts);
+    ifd.AddShort(TiffTagPlanarConfiguration, 1);
+
+    if (deflateCompression && !floatingPoint)
+    {
+        ifd.AddShort(TiffTagPredictor, TiffPredictorHorizontal);
+    }
+
+    if (inputFileHeader.HasAlphaChannel())
+    {
+        ifd.AddShort(TiffTagExtraSamples, TiffExtraSampleUnassociatedAlpha);
+    }
+
+    ifd.AddShorts(
+        TiffTagSampleFormat,
+        ::std::vector<uint16>(static_cast<size_t>(numberOfChannels), floatingPoint ? TiffSampleFormatFloatingPoint : TiffSampleFormatUnsignedInteger));
+
+    ifd.Write(outputFile.get(), ifdOffset);
+
+    // Update the file header with the location of the image file directory.
+    fileHeader.firstIfdOffset = ifdOffset;
+
+    SetFilePosition(outputFile.get(), 0);
+    WriteFile(outputFile.get(), &fileHeader, sizeof(fileHeader));
+}
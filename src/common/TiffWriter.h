@@ -0,0 +1,26 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef TIFFWRITER_H
+#define TIFFWRITER_H
+
+#include "Common.h"
+#include <boost/filesystem.hpp>
+
+// Writes a Gmic8bfImage as a baseline TIFF image, the 8-bit and 16-bit images
+// use a horizontal predictor when Deflate compression is enabled.
+void ConvertGmic8bfImageToTiff(
+    const boost::filesystem::path& inputFilePath,
+    const boost::filesystem::path& outputFilePath,
+    bool deflateCompression);
+
+#endif // !TIFFWRITER_H
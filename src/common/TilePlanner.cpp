@@ -0,0 +1,287 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "TilePlanner.h"
+#include "MemoryUsage.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+namespace
+{
+    // The tile size that is used when the host callback cost is low, this
+    // keeps the data that the copy loops are working on in the processor cache.
+    constexpr int64 DefaultTileBytes = 1024 * 1024;
+    constexpr int64 MaximumTileBytes = 16 * 1024 * 1024;
+    // The largest host request window, this collapses the requests for most images into
+    // one call per plane while limiting the memory that the host must page in.
+    constexpr int64 MaximumWindowBytes = 256 * 1024 * 1024;
+
+    // The approximate number of bytes that the tile copy loops process per microsecond.
+    constexpr double CopyBytesPerMicrosecond = 1000.0;
+    // The tiles are sized so that the host callback takes at most 1/10th of the copy time.
+    constexpr double CallbackOverheadRatio = 10.0;
+
+    // The tile width alignment used when the host does not provide a tile size.
+    constexpr int32 DefaultTileAlignment = 64;
+
+    // The statistics are only updated on the host thread, but the tile planner is also
+    // used by the worker threads that decode and encode images.
+    struct HostCallbackStatistics
+    {
+        ::std::atomic<double> averageMicroseconds;
+        ::std::atomic<uint64> sampleCount;
+    };
+
+    HostCallbackStatistics& GetHostCallbackStatistics() noexcept
+    {
+        // The statistics are kept for the lifetime of the plug-in so that
+        // later filter invocations can use the measurements from earlier ones.
+        static HostCallbackStatistics statistics{ {0.0}, {0} };
+
+        return statistics;
+    }
+
+    void RecordHostCallbackDuration(::std::chrono::steady_clock::duration duration) noexcept
+    {
+        HostCallbackStatistics& statistics = GetHostCallbackStatistics();
+
+        const double microseconds = ::std::chrono::duration<double, ::std::micro>(duration).count();
+        const uint64 sampleCount = statistics.sampleCount.load(::std::memory_order_relaxed);
+
+        if (sampleCount == 0)
+        {
+            statistics.averageMicroseconds.store(microseconds, ::std::memory_order_relaxed);
+        }
+        else
+        {
+            // Use an exponential moving average so that the estimate follows changes
+            // in the host behavior, e.g. when it starts paging to the scratch disk.
+            const double average = statistics.averageMicroseconds.load(::std::memory_order_relaxed);
+
+            statistics.averageMicroseconds.store(average + ((microseconds - average) * 0.125), ::std::memory_order_relaxed);
+        }
+
+        statistics.sampleCount.store(sampleCount + 1, ::std::memory_order_release);
+    }
+
+    int64 GetHostCallbackTileBytes() noexcept
+    {
+        const HostCallbackStatistics& statistics = GetHostCallbackStatistics();
+
+        if (statistics.sampleCount.load(::std::memory_order_acquire) == 0)
+        {
+            return DefaultTileBytes;
+        }
+
+        const double tileBytes = statistics.averageMicroseconds.load(::std::memory_order_relaxed) * CopyBytesPerMicrosecond * CallbackOverheadRatio;
+
+        return ::std::clamp(static_cast<int64>(tileBytes), DefaultTileBytes, MaximumTileBytes);
+    }
+
+    int32 RoundDownToMultiple(int64 value, int32 multiple) noexcept
+    {
+        const int64 result = (value / multiple) * multiple;
+
+        return static_cast<int32>(::std::clamp(result, static_cast<int64>(multiple), static_cast<int64>(::std::numeric_limits<int32>::max())));
+    }
+
+    TileGeometry PlanTileGeometryCore(
+        int32 imageWidth,
+        int32 imageHeight,
+        int32 bytesPerPixel,
+        int32 gridWidth,
+        int32 gridHeight,
+        int64 targetTileBytes)
+    {
+        const int64 rowBytes = static_cast<int64>(imageWidth) * bytesPerPixel;
+        const int64 minimumRowCount = ::std::min(gridHeight, imageHeight);
+
+        TileGeometry geometry{};
+
+        // Prefer tiles that span the full image width, the Gmic8bfImage and the host
+        // buffers are both stored in row order so this minimizes the number of writes.
+        if ((rowBytes * minimumRowCount) <= targetTileBytes)
+        {
+            geometry.width = imageWidth;
+        }
+        else
+        {
+            const int64 maxColumns = targetTileBytes / (minimumRowCount * bytesPerPixel);
+
+            geometry.width = ::std::min(RoundDownToMultiple(maxColumns, gridWidth), imageWidth);
+        }
+
+        const int64 tileRowBytes = static_cast<int64>(geometry.width) * bytesPerPixel;
+
+        geometry.height = ::std::min(RoundDownToMultiple(targetTileBytes / tileRowBytes, gridHeight), imageHeight);
+
+        geometry.width = ::std::max(geometry.width, 1);
+        geometry.height = ::std::max(geometry.height, 1);
+
+        return geometry;
+    }
+
+    void TraceTileGeometry(
+        const char* context,
+        const TileGeometry& geometry,
+        int32 gridWidth,
+        int32 gridHeight,
+        int32 bytesPerPixel)
+    {
+#if DEBUG_BUILD
+        const HostCallbackStatistics& statistics = GetHostCallbackStatistics();
+
+        DebugOut("%s tile geometry: %dx%d, grid=%dx%d bytesPerPixel=%d callbackCost=%.1fus (%llu samples)",
+                 context,
+                 geometry.width,
+                 geometry.height,
+                 gridWidth,
+                 gridHeight,
+                 bytesPerPixel,
+                 statistics.averageMicroseconds.load(::std::memory_order_relaxed),
+                 static_cast<unsigned long long>(statistics.sampleCount.load(::std::memory_order_acquire)));
+#else
+        (void)context;
+        (void)geometry;
+        (void)gridWidth;
+        (void)gridHeight;
+        (void)bytesPerPixel;
+#endif // DEBUG_BUILD
+    }
+}
+
+TileGeometry PlanHostTileGeometry(
+    const FilterRecord* filterRecord,
+    int32 imageWidth,
+    int32 imageHeight,
+    int32 bitsPerChannel,
+    int32 planesPerRequest,
+    int32 hostTileWidth,
+    int32 hostTileHeight,
+    const char* context)
+{
+    // Some hosts may use an unsigned value for the tile size
+    // so we have to check if it is a positive number.
+    const int32 gridWidth = hostTileWidth > 0 ? hostTileWidth : DefaultTileAlignment;
+    const int32 gridHeight = hostTileHeight > 0 ? hostTileHeight : DefaultTileAlignment;
+    const int32 bytesPerPixel = (bitsPerChannel / 8) * planesPerRequest;
+
+    int64 targetTileBytes = GetHostCallbackTileBytes();
+
+    // Leave room for the host to cache the surrounding tiles.
+    if (filterRecord->maxSpace > 0)
+    {
+        targetTileBytes = ::std::min(targetTileBytes, static_cast<int64>(filterRecord->maxSpace / 2));
+    }
+
+    targetTileBytes = static_cast<int64>(::std::min(static_cast<uint64_t>(targetTileBytes), GetRemainingMemoryBudget()));
+
+    const TileGeometry geometry = PlanTileGeometryCore(
+        imageWidth,
+        imageHeight,
+        bytesPerPixel,
+        gridWidth,
+        gridHeight,
+        targetTileBytes);
+
+    TraceTileGeometry(context, geometry, gridWidth, gridHeight, bytesPerPixel);
+
+    return geometry;
+}
+
+TileGeometry PlanHostWindowGeometry(
+    const FilterRecord* filterRecord,
+    int32 imageWidth,
+    int32 imageHeight,
+    int32 tileWidth,
+    int32 tileHeight,
+    int32 hostBytesPerPixel,
+    int32 bufferBytesPerPixel,
+    const char* context)
+{
+    int64 hostWindowBytes = MaximumWindowBytes;
+
+    // Leave room for the host to cache the surrounding tiles.
+    if (filterRecord->maxSpace > 0)
+    {
+        hostWindowBytes = ::std::min(hostWindowBytes, static_cast<int64>(filterRecord->maxSpace / 2));
+    }
+
+    const int64 bufferWindowBytes = static_cast<int64>(::std::min(static_cast<uint64_t>(MaximumWindowBytes), GetRemainingMemoryBudget()));
+
+    // The number of pixels that fit in both the host request and the plug-in buffers.
+    const int64 maxPixels = ::std::min(
+        hostWindowBytes / ::std::max(hostBytesPerPixel, 1),
+        bufferWindowBytes / ::std::max(bufferBytesPerPixel, 1));
+
+    const int64 tilePixels = static_cast<int64>(tileWidth) * tileHeight;
+    const int64 tileRowPixels = static_cast<int64>(imageWidth) * tileHeight;
+
+    TileGeometry geometry{};
+
+    if (tileRowPixels <= maxPixels)
+    {
+        // Prefer windows that span the full image width, so that each request covers
+        // complete rows of tiles.
+        const int64 tileRows = maxPixels / tileRowPixels;
+
+        geometry.width = imageWidth;
+        geometry.height = static_cast<int32>(::std::min(tileRows * tileHeight, static_cast<int64>(imageHeight)));
+    }
+    else
+    {
+        const int64 tileColumns = ::std::max(maxPixels / tilePixels, static_cast<int64>(1));
+
+        geometry.width = static_cast<int32>(::std::min(tileColumns * tileWidth, static_cast<int64>(imageWidth)));
+        geometry.height = ::std::min(tileHeight, imageHeight);
+    }
+
+    TraceTileGeometry(context, geometry, tileWidth, tileHeight, hostBytesPerPixel);
+
+    return geometry;
+}
+
+TileGeometry PlanBufferStripGeometry(
+    int32 imageWidth,
+    int32 imageHeight,
+    int32 bytesPerPixel,
+    const char* context)
+{
+    const int64 targetTileBytes = static_cast<int64>(::std::min(static_cast<uint64_t>(DefaultTileBytes), GetRemainingMemoryBudget()));
+    const int64 rowBytes = ::std::max(static_cast<int64>(imageWidth) * bytesPerPixel, static_cast<int64>(1));
+
+    TileGeometry geometry{};
+    geometry.width = imageWidth;
+    geometry.height = static_cast<int32>(::std::clamp(targetTileBytes / rowBytes, static_cast<int64>(1), static_cast<int64>(imageHeight)));
+
+    TraceTileGeometry(context, geometry, imageWidth, 1, bytesPerPixel);
+
+    return geometry;
+}
+
+OSErr TimedAdvanceState(FilterRecordPtr filterRecord)
+{
+    ScopedHostCallbackTimer timer;
+
+    return filterRecord->advanceState();
+}
+
+ScopedHostCallbackTimer::ScopedHostCallbackTimer() noexcept
+    : start(::std::chrono::steady_clock::now())
+{
+}
+
+ScopedHostCallbackTimer::~ScopedHostCallbackTimer()
+{
+    RecordHostCallbackDuration(::std::chrono::steady_clock::now() - start);
+}
@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef TILEPLANNER_H
+#define TILEPLANNER_H
+
+#include "Common.h"
+#include <boost/core/noncopyable.hpp>
+#include <chrono>
+
+struct TileGeometry
+{
+    int32 width;
+    int32 height;
+};
+
+// Plans the tile size for a loop that requests image data from the host.
+// The tile size is a multiple of the host tile size, and is sized to
+// amortize the measured cost of the host callbacks.
+TileGeometry PlanHostTileGeometry(
+    const FilterRecord* filterRecord,
+    int32 imageWidth,
+    int32 imageHeight,
+    int32 bitsPerChannel,
+    int32 planesPerRequest,
+    int32 hostTileWidth,
+    int32 hostTileHeight,
+    const char* context);
+
+// Plans a host request window that covers several image tiles, the window is a multiple of
+// the tile size and is limited by the host memory and the plug-in memory budget.
+// The window is a single tile when the host does not have room for a larger request.
+// hostBytesPerPixel is the size of the host data and bufferBytesPerPixel is the size
+// of the plug-in buffers that are used for each pixel in the window.
+TileGeometry PlanHostWindowGeometry(
+    const FilterRecord* filterRecord,
+    int32 imageWidth,
+    int32 imageHeight,
+    int32 tileWidth,
+    int32 tileHeight,
+    int32 hostBytesPerPixel,
+    int32 bufferBytesPerPixel,
+    const char* context);
+
+// Plans the height of the full-width strips that are used when streaming
+// image data from a decoder that produces rows in top to bottom order.
+TileGeometry PlanBufferStripGeometry(
+    int32 imageWidth,
+    int32 imageHeight,
+    int32 bytesPerPixel,
+    const char* context);
+
+// Calls advanceState and records the time that the host took to process the request.
+OSErr TimedAdvanceState(FilterRecordPtr filterRecord);
+
+// Records the time taken by a host callback for the lifetime of the object.
+class ScopedHostCallbackTimer : private boost::noncopyable
+{
+public:
+    ScopedHostCallbackTimer() noexcept;
+
+    ~ScopedHostCallbackTimer();
+
+private:
+    const ::std::chrono::steady_clock::time_point start;
+};
+
+#endif // !TILEPLANNER_H
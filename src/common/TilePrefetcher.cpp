@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "TilePrefetcher.h"
+
+TilePrefetcher::TilePrefetcher(FileHandle* fileHandle, const Gmic8bfImageTileTable& tileTable)
+    : fileHandle(fileHandle),
+      tileTable(tileTable),
+      mutex(),
+      requestsAvailable(),
+      requestsFinished(),
+      pendingRequests(),
+      error(),
+      busy(false),
+      stopping(false),
+      thread()
+{
+    try
+    {
+        thread = ::std::thread(&TilePrefetcher::ThreadProc, this);
+    }
+    catch (...)
+    {
+        // The tiles are read on the calling thread if the prefetch thread could not be started.
+    }
+}
+
+TilePrefetcher::~TilePrefetcher()
+{
+    if (thread.joinable())
+    {
+        {
+            ::std::lock_guard<::std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        requestsAvailable.notify_one();
+
+        thread.join();
+    }
+}
+
+void TilePrefetcher::Start(::std::vector<TilePrefetchRequest>&& requests)
+{
+    if (!thread.joinable())
+    {
+        for (const TilePrefetchRequest& request : requests)
+        {
+            tileTable.ReadTile(fileHandle, request.tileIndex, request.buffer, request.sampleCount);
+        }
+
+        return;
+    }
+
+    {
+        ::std::lock_guard<::std::mutex> lock(mutex);
+
+        pendingRequests = ::std::move(requests);
+        error = nullptr;
+        busy = true;
+    }
+
+    requestsAvailable.notify_one();
+}
+
+void TilePrefetcher::Wait()
+{
+    if (!thread.joinable())
+    {
+        return;
+    }
+
+    ::std::unique_lock<::std::mutex> lock(mutex);
+
+    requestsFinished.wait(lock, [this] { return !busy; });
+
+    if (error)
+    {
+        ::std::exception_ptr readError = error;
+        error = nullptr;
+
+        ::std::rethrow_exception(readError);
+    }
+}
+
+void TilePrefetcher::ThreadProc() noexcept
+{
+    while (true)
+    {
+        ::std::vector<TilePrefetchRequest> requests;
+
+        {
+            ::std::unique_lock<::std::mutex> lock(mutex);
+
+            // The pending reads are finished before the thread stops, the buffers
+            // are owned by the caller and must not be released while they are in use.
+            requestsAvailable.wait(lock, [this] { return busy || stopping; });
+
+            if (!busy)
+            {
+                return;
+            }
+
+            requests.swap(pendingRequests);
+        }
+
+        ::std::exception_ptr readError;
+
+        try
+        {
+            for (const TilePrefetchRequest& request : requests)
+            {
+                tileTable.ReadTile(fileHandle, request.tileIndex, request.buffer, request.sampleCount);
+            }
+        }
+        catch (...)
+        {
+            readError = ::std::current_exception();
+        }
+
+        {
+            ::std::lock_guard<::std::mutex> lock(mutex);
+
+            error = readError;
+            busy = false;
+        }
+
+        requestsFinished.notify_one();
+    }
+}
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef TILEPREFETCHER_H
+#define TILEPREFETCHER_H
+
+#include "Gmic8bfImageTileTable.h"
+#include <boost/core/noncopyable.hpp>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct TilePrefetchRequest
+{
+    int32 tileIndex;
+    void* buffer;
+    size_t sampleCount;
+};
+
+// Reads image tiles on a background thread, this allows the next tiles to be read
+// from the file while the current tiles are copied to the host.
+// The file handle must not be used by other threads while a read is in progress.
+class TilePrefetcher : private boost::noncopyable
+{
+public:
+    TilePrefetcher(FileHandle* fileHandle, const Gmic8bfImageTileTable& tileTable);
+
+    // Waits for the current read to finish before the thread is stopped.
+    ~TilePrefetcher();
+
+    // Starts reading the tiles in order, the buffers must remain valid until Wait returns.
+    void Start(::std::vector<TilePrefetchRequest>&& requests);
+
+    // Waits for the tiles from the last Start call, an exception thrown by the read is rethrown.
+    void Wait();
+
+private:
+    void ThreadProc() noexcept;
+
+    FileHandle* const fileHandle;
+    const Gmic8bfImageTileTable& tileTable;
+    ::std::mutex mutex;
+    ::std::condition_variable requestsAvailable;
+    ::std::condition_variable requestsFinished;
+    ::std::vector<TilePrefetchRequest> pendingRequests;
+    ::std::exception_ptr error;
+    bool busy;
+    bool stopping;
+    ::std::thread thread;
+};
+
+#endif // !TILEPREFETCHER_H
@@ -13,6 +13,7 @@
 #include "Utilities.h"
 #include "ScopedHandleSuite.h"
 #include <SafeInt.hpp>
+#include <algorithm>
 #include <codecvt>
 #include <locale>
 #include <string>
@@ -569,6 +570,20 @@ int32 GetImageDepth(const FilterRecord* filterRecord) noexcept
     return depth;
 }
 
+int32 GetGmicImageDepth(int32 hostBitDepth, const GmicIOSettings& settings) noexcept
+{
+    // The reduced precision mode sends 16-bit and 32-bit images to G'MIC-Qt as 8-bit
+    // images, the G'MIC-Qt output is converted back to the host bit depth when it is read.
+    // G'MIC-Qt uses the same images for the preview and the final result, so the precision
+    // that is lost here is also lost in the applied result.
+    if (settings.GetReducedPrecisionExport() && hostBitDepth > 8)
+    {
+        return 8;
+    }
+
+    return hostBitDepth;
+}
+
 int32 GetImagePlaneCount(int16 imageMode, int32 layerPlanes, int32 transparencyPlanes)
 {
     int32 imagePlanes;
@@ -614,6 +629,58 @@ VPoint GetImageSize(const FilterRecordPtr filterRecord)
     return imageSize;
 }
 
+VRect GetFilterRect(const FilterRecordPtr filterRecord)
+{
+    VRect filterRect;
+
+    if (filterRecord->bigDocumentData != nullptr && filterRecord->bigDocumentData->PluginUsing32BitCoordinates)
+    {
+        filterRect = filterRecord->bigDocumentData->filterRect32;
+    }
+    else
+    {
+        filterRect.top = filterRecord->filterRect.top;
+        filterRect.left = filterRecord->filterRect.left;
+        filterRect.bottom = filterRecord->filterRect.bottom;
+        filterRect.right = filterRecord->filterRect.right;
+    }
+
+    return filterRect;
+}
+
+VRect GetRegionOfInterest(const FilterRecordPtr filterRecord, const GmicIOSettings& settings)
+{
+    const VPoint imageSize = GetImageSize(filterRecord);
+
+    VRect documentBounds{};
+    documentBounds.right = imageSize.h;
+    documentBounds.bottom = imageSize.v;
+
+    if (!settings.GetExportSelectionOnly())
+    {
+        return documentBounds;
+    }
+
+    // The filter rectangle is the bounding box of the selection, it is expanded by the
+    // user-specified margin so that filters which sample neighboring pixels have the
+    // surrounding image data available.
+    const VRect filterRect = GetFilterRect(filterRecord);
+    const int32 margin = settings.GetSelectionMargin();
+
+    VRect regionOfInterest{};
+    regionOfInterest.top = ::std::max(filterRect.top - margin, documentBounds.top);
+    regionOfInterest.left = ::std::max(filterRect.left - margin, documentBounds.left);
+    regionOfInterest.bottom = ::std::min(filterRect.bottom + margin, documentBounds.bottom);
+    regionOfInterest.right = ::std::min(filterRect.right + margin, documentBounds.right);
+
+    if (regionOfInterest.top >= regionOfInterest.bottom || regionOfInterest.left >= regionOfInterest.right)
+    {
+        return documentBounds;
+    }
+
+    return regionOfInterest;
+}
+
 int32 GetTileHeight(int16 suggestedTileHeight)
 {
     // Some hosts may use an unsigned value for the tile height
@@ -15,6 +15,7 @@
 
 #include "Common.h"
 #include "PIProperties.h"
+#include "GmicIOSettings.h"
 
 // Support compiling with the 7.0 and earlier SDKs.
 #if defined(kCurrentMaxVersReadLayerDesc) && defined(propNumberOfLayers) && defined(propTargetLayerIndex)
@@ -28,8 +29,11 @@ bool SPBasicSuiteIsAvailable(const FilterRecord* filterRecord);
 bool TryGetActiveLayerNameAsUTF8String(const FilterRecord* filterRecord, ::std::string& utf8LayerName);
 bool HostMeetsRequirements(const FilterRecord* filterRecord) noexcept;
 int32 GetImageDepth(const FilterRecord* filterRecord) noexcept;
+int32 GetGmicImageDepth(int32 hostBitDepth, const GmicIOSettings& settings) noexcept;
 int32 GetImagePlaneCount(int16 imageMode, int32 layerPlanes, int32 transparencyPlanes);
 VPoint GetImageSize(const FilterRecordPtr filterRecord);
+VRect GetFilterRect(const FilterRecordPtr filterRecord);
+VRect GetRegionOfInterest(const FilterRecordPtr filterRecord, const GmicIOSettings& settings);
 int32 GetTileHeight(int16 suggestedTileHeight);
 int32 GetTileWidth(int16 suggestedTileWidth);
 void SetInputRect(FilterRecordPtr filterRecord, int32 top, int32 left, int32 bottom, int32 right);
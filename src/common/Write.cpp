@@ -15,12 +15,13 @@
 #include "FileUtil.h"
 #include "ClipboardUtil.h"
 #include "ColorManagement.h"
-#include "ImageConversion.h"
+#include "SecondInputImageCache.h"
 #include "InputLayerIndex.h"
 #include "Gmic8bfImageWriter.h"
 #include "GmicQtParameters.h"
 #include "resource.h"
 #include "Utilities.h"
+#include <future>
 #include <string>
 #include <wil\result.h>
 
@@ -28,46 +29,69 @@ namespace
 {
     void WriteGmicParametersFile(
         const boost::filesystem::path& gmicParametersFilePath,
-        FilterRecord* filterRecord)
+        const GmicQtParameters& parameters)
     {
-        GmicQtParameters parameters(filterRecord);
-
         if (parameters.IsValid())
         {
             parameters.SaveToFile(gmicParametersFilePath);
         }
     }
 
-    void WriteAlternateInputImageData(
-        const GmicIOSettings& settings,
-        InputLayerIndex* layerIndex)
+    ::std::unique_ptr<InputLayerInfo> ConvertAlternateInputImage(
+        SecondInputImageSource source,
+        const boost::filesystem::path& secondInputImagePath)
+    {
+        ::std::unique_ptr<InputLayerInfo> layer;
+
+        if (source == SecondInputImageSource::Clipboard)
+        {
+            ConvertClipboardImageToGmicInput(layer);
+        }
+        else if (source == SecondInputImageSource::File)
+        {
+            // File not found errors are ignored when reading the second input
+            // image from a file. this makes G'MIC get a single input image
+            // instead of failing to launch the plugin with an exception.
+            // As seen in https://github.com/0xC0000054/gmic-8bf/issues/23,
+            // users had been getting confused by that behavior.
+            //
+            // The behavior now matches the image from clipboard case when
+            // there is no image on the clipboard.
+
+            ConvertImageToGmicInputFormatCached(
+                secondInputImagePath,
+                layer);
+        }
+
+        return layer;
+    }
+
+    // The second input image conversion does not call into the host, so it is
+    // started on a background thread and overlapped with reading the active layer.
+    ::std::future<::std::unique_ptr<InputLayerInfo>> StartAlternateInputImageConversion(const GmicIOSettings& settings)
     {
         const SecondInputImageSource source = settings.GetSecondInputImageSource();
 
-        if (source != SecondInputImageSource::None)
+        if (source == SecondInputImageSource::None)
         {
-            ::std::unique_ptr<InputLayerInfo> layer;
+            return ::std::future<::std::unique_ptr<InputLayerInfo>>();
+        }
 
-            if (source == SecondInputImageSource::Clipboard)
-            {
-                ConvertClipboardImageToGmicInput(layer);
-            }
-            else if (source == SecondInputImageSource::File)
-            {
-                // File not found errors are ignored when reading the second input
-                // image from a file. this makes G'MIC get a single input image
-                // instead of failing to launch the plugin with an exception.
-                // As seen in https://github.com/0xC0000054/gmic-8bf/issues/23,
-                // users had been getting confused by that behavior.
-                //
-                // The behavior now matches the image from clipboard case when
-                // there is no image on the clipboard.
-
-                ConvertImageToGmicInputFormat(
-                    settings.GetSecondInputImagePath(),
-                    layer,
-                    /*ignoreFileNotFound*/true);
-            }
+        return ::std::async(
+            ::std::launch::async,
+            &ConvertAlternateInputImage,
+            source,
+            settings.GetSecondInputImagePath());
+    }
+
+    void WriteAlternateInputImageData(
+        ::std::future<::std::unique_ptr<InputLayerInfo>>& alternateInputImage,
+        InputLayerIndex* layerIndex)
+    {
+        if (alternateInputImage.valid())
+        {
+            // Rethrows any exception that occurred during the conversion.
+            ::std::unique_ptr<InputLayerInfo> layer = alternateInputImage.get();
 
             if (layer)
             {
@@ -76,6 +100,26 @@ namespace
         }
     }
 
+    GmicQtInputMode GetRequiredInputMode(const GmicQtParameters& parameters, bool showFullUI)
+    {
+        // The user can change the input mode when the full UI is shown, so all of the
+        // layers must be exported in that case.
+        // When a filter is being reapplied G'MIC-Qt will use the input mode that was
+        // saved with the filter parameters.
+
+        if (showFullUI || !parameters.IsValid())
+        {
+            return GmicQtInputMode::Unknown;
+        }
+
+        return parameters.GetInputMode();
+    }
+
+    bool InputModeUsesSecondImage(GmicQtInputMode inputMode)
+    {
+        return inputMode != GmicQtInputMode::NoInput && inputMode != GmicQtInputMode::ActiveLayer;
+    }
+
     bool IsGrayScale(const FilterRecord* filterRecord)
     {
         switch (filterRecord->imageMode)
@@ -98,10 +142,28 @@ namespace
         const boost::filesystem::path& indexFilePath,
         FilterRecord* filterRecord,
         const int32& bitsPerChannel,
-        const GmicIOSettings& settings)
+        const GmicIOSettings& settings,
+        GmicQtInputMode inputMode)
     {
         const bool grayScale = IsGrayScale(filterRecord);
 
+        bool saveAllLayers = false;
+
+#if PSSDK_HAS_LAYER_SUPPORT
+        int32 targetLayerIndex = 0;
+
+        saveAllLayers = DocumentHasMultipleLayers(filterRecord) &&
+                        HostSupportsReadingFromMultipleLayers(filterRecord) &&
+                        TryGetTargetLayerIndex(filterRecord, targetLayerIndex);
+#endif
+
+        ::std::future<::std::unique_ptr<InputLayerInfo>> alternateInputImage;
+
+        if (!saveAllLayers && InputModeUsesSecondImage(inputMode))
+        {
+            alternateInputImage = StartAlternateInputImageConversion(settings);
+        }
+
         ::std::unique_ptr<InputLayerIndex> inputLayerIndex = ::std::make_unique<InputLayerIndex>(static_cast<uint8>(bitsPerChannel), grayScale);
 
         const boost::filesystem::path imageProfilePath = WriteImageColorProfile(filterRecord, inputDir);
@@ -115,21 +177,27 @@ namespace
 
         inputLayerIndex->SetColorProfiles(imageProfilePath, displayProfilePath);
 
-#if PSSDK_HAS_LAYER_SUPPORT
-        int32 targetLayerIndex = 0;
+        const VRect regionOfInterest = GetRegionOfInterest(filterRecord, settings);
 
-        if (DocumentHasMultipleLayers(filterRecord) &&
-            HostSupportsReadingFromMultipleLayers(filterRecord) &&
-            TryGetTargetLayerIndex(filterRecord, targetLayerIndex))
+#if PSSDK_HAS_LAYER_SUPPORT
+        if (saveAllLayers)
         {
-            SaveAllLayers(inputDir, bitsPerChannel, grayScale, inputLayerIndex.get(), targetLayerIndex, filterRecord);
+            SaveAllLayers(
+                inputDir,
+                bitsPerChannel,
+                grayScale,
+                inputLayerIndex.get(),
+                targetLayerIndex,
+                regionOfInterest,
+                inputMode,
+                filterRecord);
         }
         else
 #endif
         {
-            SaveActiveLayer(inputDir, bitsPerChannel, grayScale, inputLayerIndex.get(), filterRecord);
+            SaveActiveLayer(inputDir, bitsPerChannel, grayScale, inputLayerIndex.get(), regionOfInterest, filterRecord);
 
-            WriteAlternateInputImageData(settings, inputLayerIndex.get());
+            WriteAlternateInputImageData(alternateInputImage, inputLayerIndex.get());
         }
 
         inputLayerIndex->Write(indexFilePath);
@@ -142,7 +210,8 @@ OSErr WriteGmicFiles(
     boost::filesystem::path& gmicParametersFilePath,
     FilterRecord* filterRecord,
     const int32& hostBitDepth,
-    const GmicIOSettings& settings)
+    const GmicIOSettings& settings,
+    bool showFullUI)
 {
     PrintFunctionName();
 
@@ -150,13 +219,21 @@ OSErr WriteGmicFiles(
 
     try
     {
+        const GmicQtParameters parameters(filterRecord);
+
         indexFilePath = GetTemporaryFileName(inputDir, ".idx");
 
-        WriteLayerIndexFile(inputDir, indexFilePath, filterRecord, hostBitDepth, settings);
+        WriteLayerIndexFile(
+            inputDir,
+            indexFilePath,
+            filterRecord,
+            GetGmicImageDepth(hostBitDepth, settings),
+            settings,
+            GetRequiredInputMode(parameters, showFullUI));
 
         gmicParametersFilePath = GetTemporaryFileName(inputDir, ".g8p");
 
-        WriteGmicParametersFile(gmicParametersFilePath, filterRecord);
+        WriteGmicParametersFile(gmicParametersFilePath, parameters);
     }
     catch (const ::std::bad_alloc&)
     {
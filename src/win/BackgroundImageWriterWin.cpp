@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include "BackgroundImageWriterWin.h"
+#include <memory>
+#include <wil/resource.h>
+
+namespace
+{
+    struct BackgroundThreadStartInfo
+    {
+        void (*threadProc)();
+        HMODULE module;
+    };
+
+    DWORD WINAPI BackgroundThreadProc(LPVOID lpParameter)
+    {
+        ::std::unique_ptr<BackgroundThreadStartInfo> startInfo(static_cast<BackgroundThreadStartInfo*>(lpParameter));
+
+        const HMODULE module = startInfo->module;
+        void (*threadProc)() = startInfo->threadProc;
+
+        startInfo.reset();
+
+        threadProc();
+
+        // Release the module reference that was taken when the thread was started, this allows the
+        // host to unload the plug-in while an image is being saved without the thread code being unmapped.
+        FreeLibraryAndExitThread(module, 0);
+    }
+}
+
+void StartBackgroundImageWriterThreadNative(void (*threadProc)())
+{
+    try
+    {
+        ::std::unique_ptr<BackgroundThreadStartInfo> startInfo = ::std::make_unique<BackgroundThreadStartInfo>();
+        startInfo->threadProc = threadProc;
+
+        THROW_IF_WIN32_BOOL_FALSE(GetModuleHandleExW(
+            GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+            reinterpret_cast<LPCWSTR>(&BackgroundThreadProc),
+            &startInfo->module));
+
+        wil::unique_handle thread(CreateThread(nullptr, 0, BackgroundThreadProc, startInfo.get(), 0, nullptr));
+
+        if (!thread)
+        {
+            const DWORD lastError = GetLastError();
+
+            FreeLibrary(startInfo->module);
+            THROW_WIN32(lastError);
+        }
+
+        // The thread owns the start info and the module reference.
+        startInfo.release();
+    }
+    catch (const wil::ResultException& e)
+    {
+        if (e.GetErrorCode() == E_OUTOFMEMORY)
+        {
+            throw ::std::bad_alloc();
+        }
+        else
+        {
+            throw ::std::runtime_error(e.what());
+        }
+    }
+}
@@ -0,0 +1,21 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of gmic-8bf, a filter plug-in module that
+// interfaces with G'MIC-Qt.
+//
+// Copyright (c) 2020-2026 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef BACKGROUNDIMAGEWRITERWIN_H
+#define BACKGROUNDIMAGEWRITERWIN_H
+
+#include "BackgroundImageWriter.h"
+
+// Starts a detached thread that keeps the plug-in module loaded until threadProc returns.
+void StartBackgroundImageWriterThreadNative(void (*threadProc)());
+
+#endif // !BACKGROUNDIMAGEWRITERWIN_H
@@ -12,8 +12,10 @@
 
 #include "stdafx.h"
 #include "ClipboardUtilWin.h"
+#include "DibReader.h"
 #include "FileUtil.h"
 #include "ImageConversionWin.h"
+#include "MemoryUsage.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/core/noncopyable.hpp>
 #include <shellapi.h>
@@ -146,6 +148,13 @@ namespace
             throw ::std::runtime_error("Unable to lock the clipboard data handle.");
         }
 
+        // Uncompressed 24-bit and 32-bit bitmaps are converted directly from the clipboard memory,
+        // other formats are copied into a bitmap file and decoded using WIC.
+        if (TryConvertDibToGmicInputFormat(lockedData.get(), handleSize, layer))
+        {
+            return;
+        }
+
         const PBITMAPINFOHEADER pbih = static_cast<PBITMAPINFOHEADER>(lockedData.get());
 
         uint64_t imageDataSize = static_cast<uint64_t>(pbih->biSizeImage);
@@ -184,6 +193,10 @@ namespace
             }
             else
             {
+                // The copy is only recorded, the clipboard image must be converted even when it
+                // is larger than the memory budget.
+                ScopedMemoryUsageRecord memoryBmpUsage(MemoryUsageCategory::ImageDecoder, fileSize);
+
                 ::std::vector<BYTE> memoryBmp(static_cast<size_t>(fileSize));
 
                 BITMAPFILEHEADER* bfh = reinterpret_cast<BITMAPFILEHEADER*>(memoryBmp.data());
@@ -11,6 +11,7 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "FileIOWin.h"
+#include <limits>
 #include <vector>
 #include <wil/resource.h>
 
@@ -210,6 +211,60 @@ private:
     wil::unique_hfile hFile;
 };
 
+class FileMappingWin : public FileMapping
+{
+public:
+    FileMappingWin(const boost::filesystem::path& path)
+        : hFile(), hMapping(), view(), size(0)
+    {
+        hFile.reset(CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+
+        THROW_LAST_ERROR_IF(!hFile);
+
+        LARGE_INTEGER fileSize;
+
+        THROW_IF_WIN32_BOOL_FALSE(GetFileSizeEx(hFile.get(), &fileSize));
+
+        if (fileSize.QuadPart <= 0 || static_cast<uint64>(fileSize.QuadPart) > ::std::numeric_limits<size_t>::max())
+        {
+            // An empty file cannot be mapped, and a 32-bit process cannot map a file that is larger than its address space.
+            THROW_WIN32(ERROR_FILE_INVALID);
+        }
+
+        size = static_cast<uint64>(fileSize.QuadPart);
+
+        hMapping.reset(CreateFileMappingW(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+
+        THROW_LAST_ERROR_IF(!hMapping);
+
+        view.reset(MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0));
+
+        THROW_LAST_ERROR_IF(!view);
+    }
+
+    FileMappingWin(const FileMappingWin&) = delete;
+    FileMappingWin& operator=(const FileMappingWin&) = delete;
+
+    FileMappingWin(FileMappingWin&&) = delete;
+    FileMappingWin& operator=(FileMappingWin&&) = delete;
+
+    const void* GetData() const noexcept override
+    {
+        return view.get();
+    }
+
+    uint64 GetSize() const noexcept override
+    {
+        return size;
+    }
+
+private:
+    wil::unique_hfile hFile;
+    wil::unique_handle hMapping;
+    wil::unique_mapview_ptr<void> view;
+    uint64 size;
+};
+
 ::std::unique_ptr<FileHandle> OpenFileNative(
     const boost::filesystem::path& path,
     FileOpenMode mode,
@@ -452,3 +507,22 @@ void WriteFileNative(FileHandle* fileHandle, const void* data, size_t dataSize)
         buffer->writeOffset = inputLength;
     }
 }
+
+::std::unique_ptr<FileMapping> MapFileForReadingNative(const boost::filesystem::path& path)
+{
+    try
+    {
+        return ::std::make_unique<FileMappingWin>(path);
+    }
+    catch (const wil::ResultException& e)
+    {
+        if (e.GetErrorCode() == E_OUTOFMEMORY)
+        {
+            throw ::std::bad_alloc();
+        }
+        else
+        {
+            throw ::std::runtime_error(e.what());
+        }
+    }
+}
@@ -28,4 +28,6 @@ void SetFilePositionNative(FileHandle* fileHandle, int64 posOffset);
 
 void WriteFileNative(FileHandle* fileHandle, const void* data, size_t dataSize);
 
+::std::unique_ptr<FileMapping> MapFileForReadingNative(const boost::filesystem::path& path);
+
 #endif // !FILEIOWIN_H
@@ -89,6 +89,35 @@ boost::filesystem::path GetPluginSettingsDirectoryNative()
     return path;
 }
 
+boost::filesystem::path GetPluginCacheDirectoryNative()
+{
+    boost::filesystem::path path;
+
+    try
+    {
+        wil::unique_cotaskmem_string appDataPath;
+
+        THROW_IF_FAILED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &appDataPath));
+
+        path = appDataPath.get();
+        path /= L"Gmic8bfPlugin";
+        path /= L"cache";
+    }
+    catch (const wil::ResultException& e)
+    {
+        if (e.GetErrorCode() == E_OUTOFMEMORY)
+        {
+            throw ::std::bad_alloc();
+        }
+        else
+        {
+            throw ::std::runtime_error(e.what());
+        }
+    }
+
+    return path;
+}
+
 boost::filesystem::path GetSessionDirectoriesRootNative()
 {
     boost::filesystem::path path;
@@ -19,6 +19,8 @@ boost::filesystem::path GetGmicQtPathNative();
 
 boost::filesystem::path GetPluginSettingsDirectoryNative();
 
+boost::filesystem::path GetPluginCacheDirectoryNative();
+
 boost::filesystem::path GetSessionDirectoriesRootNative();
 
 #endif // !FILEUTILWIN_H
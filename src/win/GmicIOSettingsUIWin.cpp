@@ -21,6 +21,7 @@
 #include <wil/result.h>
 #include <wil/win32_helpers.h>
 #include <windowsx.h>
+#include <algorithm>
 #include <vector>
 
 namespace
@@ -30,6 +31,11 @@ namespace
         boost::filesystem::path defaultOutputFolder;
         SecondInputImageSource secondImageSource;
         boost::filesystem::path secondImageFilePath;
+        bool exportSelectionOnly;
+        int32 selectionMargin;
+        bool resampleOutputToDocument;
+        bool reducedPrecisionExport;
+        OutputFileFormat outputFileFormat;
 
         OSErr GetDialogError() const
         {
@@ -48,6 +54,11 @@ namespace
             : defaultOutputFolder(settings.GetDefaultOutputPath()),
               secondImageSource(settings.GetSecondInputImageSource()),
               secondImageFilePath(settings.GetSecondInputImagePath()),
+              exportSelectionOnly(settings.GetExportSelectionOnly()),
+              selectionMargin(settings.GetSelectionMargin()),
+              resampleOutputToDocument(settings.GetResampleOutputToDocument()),
+              reducedPrecisionExport(settings.GetReducedPrecisionExport()),
+              outputFileFormat(settings.GetOutputFileFormat()),
               dialogError(noErr)
         {
         }
@@ -56,6 +67,30 @@ namespace
         OSErr dialogError;
     };
 
+    // The combo box items are listed in the order of the OutputFileFormat values.
+    const UINT OutputFormatNameResourceIds[] =
+    {
+        OUTPUT_FORMAT_DEFAULT_NAME,
+        OUTPUT_FORMAT_TIFF_UNCOMPRESSED_NAME,
+        OUTPUT_FORMAT_TIFF_DEFLATE_NAME,
+        OUTPUT_FORMAT_QOI_NAME
+    };
+
+    void InitOutputFormatComboBox(HWND comboBox, OutputFileFormat format)
+    {
+        for (UINT resourceId : OutputFormatNameResourceIds)
+        {
+            wchar_t nameBuffer[256] = {};
+
+            if (LoadStringW(wil::GetModuleInstanceHandle(), resourceId, nameBuffer, _countof(nameBuffer)) > 0)
+            {
+                ComboBox_AddString(comboBox, nameBuffer);
+            }
+        }
+
+        ComboBox_SetCurSel(comboBox, static_cast<int>(format));
+    }
+
     void InitIOSettingsDialog(HWND hDlg, const DialogData* const data)
     {
         const HWND defaultOutputFolderCheckBox = GetDlgItem(hDlg, IDC_DEFAULTOUTDIRCB);
@@ -92,6 +127,9 @@ namespace
             SetWindowTextW(outputFolderEditBox, data->defaultOutputFolder.c_str());
         }
 
+        Button_SetCheck(GetDlgItem(hDlg, IDC_RESAMPLEOUTPUTCB), data->resampleOutputToDocument ? BST_CHECKED : BST_UNCHECKED);
+        InitOutputFormatComboBox(GetDlgItem(hDlg, IDC_OUTPUTFORMATCOMBO), data->outputFileFormat);
+
         int checkedRadioButtonId;
 
         switch (data->secondImageSource)
@@ -122,6 +160,13 @@ namespace
             IDC_SECONDIMAGESOURCE_NONE_RADIO,
             IDC_SECONDIMAGESOURCE_FILE_RADIO,
             checkedRadioButtonId);
+
+        Button_SetCheck(GetDlgItem(hDlg, IDC_EXPORTSELECTIONCB), data->exportSelectionOnly ? BST_CHECKED : BST_UNCHECKED);
+        SetDlgItemInt(hDlg, IDC_SELECTIONMARGINEDIT, static_cast<UINT>(data->selectionMargin), FALSE);
+        EnableWindow(GetDlgItem(hDlg, IDC_SELECTIONMARGINLABEL), data->exportSelectionOnly);
+        EnableWindow(GetDlgItem(hDlg, IDC_SELECTIONMARGINEDIT), data->exportSelectionOnly);
+
+        Button_SetCheck(GetDlgItem(hDlg, IDC_REDUCEDPRECISIONCB), data->reducedPrecisionExport ? BST_CHECKED : BST_UNCHECKED);
     }
 
     OSErr GetPathFromTextBox(const HWND editBoxHWnd, boost::filesystem::path& path)
@@ -172,7 +217,7 @@ namespace
         return err;
     }
 
-    void WriteOutputFolderSettings(HWND hDlg, DialogData* data)
+    void WriteOutputSettings(HWND hDlg, DialogData* data)
     {
         bool defaultFolderChecked = Button_GetCheck(GetDlgItem(hDlg, IDC_DEFAULTOUTDIRCB)) == BST_CHECKED;
 
@@ -182,6 +227,41 @@ namespace
 
             data->SetDialogError(GetPathFromTextBox(editBoxHWnd, data->defaultOutputFolder));
         }
+
+        data->resampleOutputToDocument = Button_GetCheck(GetDlgItem(hDlg, IDC_RESAMPLEOUTPUTCB)) == BST_CHECKED;
+
+        const int selectedFormat = ComboBox_GetCurSel(GetDlgItem(hDlg, IDC_OUTPUTFORMATCOMBO));
+
+        if (selectedFormat >= 0 && selectedFormat < static_cast<int>(_countof(OutputFormatNameResourceIds)))
+        {
+            data->outputFileFormat = static_cast<OutputFileFormat>(selectedFormat);
+        }
+    }
+
+    void WriteSelectionSettings(HWND hDlg, DialogData* data)
+    {
+        data->exportSelectionOnly = Button_GetCheck(GetDlgItem(hDlg, IDC_EXPORTSELECTIONCB)) == BST_CHECKED;
+
+        if (data->exportSelectionOnly)
+        {
+            BOOL translated = FALSE;
+
+            const UINT margin = GetDlgItemInt(hDlg, IDC_SELECTIONMARGINEDIT, &translated, FALSE);
+
+            // The settings class will clamp the value to the supported range.
+            data->selectionMargin = translated ? static_cast<int32>(::std::min(margin, static_cast<UINT>(::std::numeric_limits<int32>::max()))) : 0;
+        }
+    }
+
+    void WritePerformanceSettings(HWND hDlg, DialogData* data)
+    {
+        data->reducedPrecisionExport = Button_GetCheck(GetDlgItem(hDlg, IDC_REDUCEDPRECISIONCB)) == BST_CHECKED;
+    }
+
+    void EnableSelectionMarginItems(HWND hDlg, bool enable)
+    {
+        EnableWindow(GetDlgItem(hDlg, IDC_SELECTIONMARGINLABEL), enable);
+        EnableWindow(GetDlgItem(hDlg, IDC_SELECTIONMARGINEDIT), enable);
     }
 
     void EnableOuputDirItems(HWND hDlg, bool enable)
@@ -223,7 +303,9 @@ namespace
                 switch (item)
                 {
                 case IDOK:
-                    WriteOutputFolderSettings(hDlg, dialogParams);
+                    WriteOutputSettings(hDlg, dialogParams);
+                    WriteSelectionSettings(hDlg, dialogParams);
+                    WritePerformanceSettings(hDlg, dialogParams);
                     EndDialog(hDlg, item);
                     break;
                 case IDCANCEL:
@@ -232,6 +314,9 @@ namespace
                 case IDC_DEFAULTOUTDIRCB:
                     EnableOuputDirItems(hDlg, Button_GetCheck(GetDlgItem(hDlg, IDC_DEFAULTOUTDIRCB)) == BST_CHECKED);
                     break;
+                case IDC_EXPORTSELECTIONCB:
+                    EnableSelectionMarginItems(hDlg, Button_GetCheck(GetDlgItem(hDlg, IDC_EXPORTSELECTIONCB)) == BST_CHECKED);
+                    break;
                 case IDC_DEFAULTOUTFOLDERBROWSE:
 
                     if (GetDefaultGmicOutputFolder(reinterpret_cast<intptr_t>(hDlg), newPath) == noErr)
@@ -349,6 +434,11 @@ OSErr DoIOSettingsUI(const FilterRecordPtr filterRecord, GmicIOSettings& setting
                 settings.SetDefaultOutputPath(dialogData.defaultOutputFolder);
                 settings.SetSecondInputImageSource(dialogData.secondImageSource);
                 settings.SetSecondInputImagePath(dialogData.secondImageFilePath);
+                settings.SetExportSelectionOnly(dialogData.exportSelectionOnly);
+                settings.SetSelectionMargin(dialogData.selectionMargin);
+                settings.SetResampleOutputToDocument(dialogData.resampleOutputToDocument);
+                settings.SetReducedPrecisionExport(dialogData.reducedPrecisionExport);
+                settings.SetOutputFileFormat(dialogData.outputFileFormat);
             }
             else
             {
@@ -17,10 +17,12 @@
 #endif // _WIN32_WINNT == _WIN32_WINNT_WIN7
 
 #include "ImageConversionWin.h"
+#include "BufferPool.h"
 #include "FileUtil.h"
 #include "FileIO.h"
 #include "Gmic8bfImageWriter.h"
 #include "ReadOnlyMemoryStream.h"
+#include "TilePlanner.h"
 #include <boost/filesystem.hpp>
 #include <wincodec.h>
 #include <wil/com.h>
@@ -80,12 +82,11 @@ namespace
     struct GmicOutputWriter
     {
         GmicOutputWriter(
-            IWICBitmap* source,
-            int32 width,
-            int32 height)
+            IWICBitmapSource* source,
+            const TileGeometry& stripGeometry)
             : image(source),
-              tileWidth(::std::min(width, 1024)),
-              tileHeight(::std::min(height, 1024))
+              tileWidth(stripGeometry.width),
+              tileHeight(stripGeometry.height)
         {
         }
 
@@ -126,59 +127,45 @@ namespace
             int32 numberOfChannels,
             int32 bitsPerChannel)
         {
-            const int32 bytesPerChannel = bitsPerChannel / 8;
-
-            WICRect lockRect{};
-
-            for (int32 y = 0; y < imageHeight; y += tileHeight)
+            // The image is copied in full-width strips, this allows the decoder and format
+            // converter to produce the rows in order without caching the entire image.
+            if (tileWidth != imageWidth)
             {
-                lockRect.Y = y;
-                lockRect.Height = ::std::min(tileHeight, imageHeight - y);
-
-                INT rowCount = lockRect.Height;
-
-                for (int32 x = 0; x < imageWidth; x += tileWidth)
-                {
-                    lockRect.X = x;
-                    lockRect.Width = ::std::min(tileWidth, imageWidth - x);
-
-                    wil::com_ptr<IWICBitmapLock> bitmapLock;
-
-                    THROW_IF_FAILED(image->Lock(&lockRect, WICBitmapLockRead, &bitmapLock));
+                throw ::std::runtime_error("The strip width must match the image width.");
+            }
 
-                    UINT wicStride;
-                    THROW_IF_FAILED(bitmapLock->GetStride(&wicStride));
+            const size_t outputStride = static_cast<size_t>(imageWidth) * numberOfChannels * (bitsPerChannel / 8);
 
-                    UINT wicBufferSize;
-                    BYTE* bufferStart;
+            if (outputStride > ::std::numeric_limits<UINT>::max() ||
+                (outputStride * tileHeight) > ::std::numeric_limits<UINT>::max())
+            {
+                throw ::std::bad_alloc();
+            }
 
-                    THROW_IF_FAILED(bitmapLock->GetDataPointer(&wicBufferSize, &bufferStart));
+            PooledBuffer stripBuffer = AcquirePooledBuffer(outputStride * tileHeight);
 
-                    INT columnCount = lockRect.Width;
+            WICRect copyRect{};
+            copyRect.X = 0;
+            copyRect.Width = imageWidth;
 
-                    const size_t outputStride = static_cast<size_t>(columnCount) * numberOfChannels * bytesPerChannel;
+            for (int32 y = 0; y < imageHeight; y += tileHeight)
+            {
+                copyRect.Y = y;
+                copyRect.Height = ::std::min(tileHeight, imageHeight - y);
 
-                    if (wicStride == outputStride)
-                    {
-                        // If the WIC image stride matches the output image stride
-                        // we can write the buffer directly.
+                const size_t stripSize = outputStride * static_cast<size_t>(copyRect.Height);
 
-                        WriteFile(file, bufferStart, static_cast<size_t>(wicBufferSize));
-                    }
-                    else
-                    {
-                        for (INT i = 0; i < rowCount; i++)
-                        {
-                            BYTE* row = bufferStart + (static_cast<size_t>(i) * wicStride);
+                THROW_IF_FAILED(image->CopyPixels(
+                    &copyRect,
+                    static_cast<UINT>(outputStride),
+                    static_cast<UINT>(stripSize),
+                    static_cast<BYTE*>(stripBuffer.data())));
 
-                            WriteFile(file, row, outputStride);
-                        }
-                    }
-                }
+                WriteFile(file, stripBuffer.data(), stripSize);
             }
         }
 
-        IWICBitmap* image;
+        IWICBitmapSource* image;
         const int32 tileHeight;
         const int32 tileWidth;
     };
@@ -214,11 +201,15 @@ namespace
                                             format,
                                             bitsPerChannel,
                                             numberOfChannels);
-        wil::com_ptr<IWICBitmap> bitmap;
+
+        // The pixels are read directly from the decoder, or the format converter, in strips.
+        // This avoids the full-size copy of the decoded image that would be created by
+        // CreateBitmapFromSource with the WICBitmapCacheOnLoad option.
+        wil::com_ptr<IWICBitmapSource> source;
 
         if (IsEqualGUID(format, targetFormat))
         {
-            THROW_IF_FAILED(factory->CreateBitmapFromSource(decoderFrame.get(), WICBitmapCacheOnLoad, &bitmap));
+            source = decoderFrame;
         }
         else
         {
@@ -232,13 +223,17 @@ namespace
                 nullptr,
                 0.f,
                 WICBitmapPaletteTypeCustom));
-            THROW_IF_FAILED(factory->CreateBitmapFromSource(formatConverter.get(), WICBitmapCacheOnLoad, &bitmap));
+
+            source = formatConverter;
         }
 
-        GmicOutputWriter writer(
-            bitmap.get(),
+        const TileGeometry stripGeometry = PlanBufferStripGeometry(
             static_cast<int32>(uiWidth),
-            static_cast<int32>(uiHeight));
+            static_cast<int32>(uiHeight),
+            numberOfChannels * (bitsPerChannel / 8),
+            __FUNCTION__);
+
+        GmicOutputWriter writer(source.get(), stripGeometry);
 
         const boost::filesystem::path path = GetTemporaryFileName(GetInputDirectory(), ".g8i");
 
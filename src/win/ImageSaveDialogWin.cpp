@@ -23,6 +23,31 @@
 
 namespace
 {
+    struct SaveDialogFileType
+    {
+        UINT filterResourceId;
+        // The default extension, without the leading period.
+        const wchar_t* extension;
+        const wchar_t* filterPattern;
+    };
+
+    SaveDialogFileType GetSaveDialogFileType(OutputImageFileType fileType)
+    {
+        switch (fileType)
+        {
+        case OutputImageFileType::Exr:
+            return SaveDialogFileType{ EXR_FILTER_NAME, L"exr", L"*.exr" };
+        case OutputImageFileType::TiffUncompressed:
+        case OutputImageFileType::TiffDeflate:
+            return SaveDialogFileType{ TIFF_FILTER_NAME, L"tif", L"*.tif;*.tiff" };
+        case OutputImageFileType::Qoi:
+            return SaveDialogFileType{ QOI_FILTER_NAME, L"qoi", L"*.qoi" };
+        case OutputImageFileType::Png:
+        default:
+            return SaveDialogFileType{ PNG_FILTER_NAME, L"png", L"*.png" };
+        }
+    }
+
     bool UseVistaStyleDialogs()
     {
         DWORD resultFlags = GetThemeAppProperties();
@@ -40,7 +65,7 @@ namespace
         HWND owner,
         const boost::filesystem::path& defaultFileName,
         boost::filesystem::path& saveFilePath,
-        int32 imageBitDepth)
+        OutputImageFileType fileType)
     {
         // The client GUID is used to allow this dialog to persist its state independently of the other file dialogs in
         // the host application.
@@ -59,10 +84,10 @@ namespace
                                                 titleBuffer,
                                                 _countof(titleBuffer));
 
-            const UINT filterResourceId = imageBitDepth == 32 ? EXR_FILTER_NAME : PNG_FILTER_NAME;
+            const SaveDialogFileType saveFileType = GetSaveDialogFileType(fileType);
 
             const int filterNameLength = LoadStringW(wil::GetModuleInstanceHandle(),
-                                                     filterResourceId,
+                                                     saveFileType.filterResourceId,
                                                      filterNameBuffer,
                                                      _countof(filterNameBuffer));
 
@@ -83,22 +108,11 @@ namespace
                     THROW_IF_FAILED(pfd->SetFileName(defaultFileName.c_str()));
                 }
 
-                if (imageBitDepth == 32)
-                {
-                    THROW_IF_FAILED(pfd->SetDefaultExtension(L"exr"));
+                THROW_IF_FAILED(pfd->SetDefaultExtension(saveFileType.extension));
 
-                    COMDLG_FILTERSPEC filter = { filterNameBuffer, L"*.exr" };
+                COMDLG_FILTERSPEC filter = { filterNameBuffer, saveFileType.filterPattern };
 
-                    THROW_IF_FAILED(pfd->SetFileTypes(1, &filter));
-                }
-                else
-                {
-                    THROW_IF_FAILED(pfd->SetDefaultExtension(L"png"));
-
-                    COMDLG_FILTERSPEC filter = { filterNameBuffer, L"*.png" };
-
-                    THROW_IF_FAILED(pfd->SetFileTypes(1, &filter));
-                }
+                THROW_IF_FAILED(pfd->SetFileTypes(1, &filter));
 
                 THROW_IF_FAILED(pfd->Show(owner));
 
@@ -146,9 +160,8 @@ namespace
     wil::unique_cotaskmem_ptr<wchar_t[]> BulidClassicSaveDialogFilterString(
         LPCWSTR filterName,
         size_t filterNameLength,
-        int32 imageBitDepth)
+        LPCWSTR fileExtensionFilter)
     {
-        static const wchar_t* fileExtensionFilter = imageBitDepth == 32 ? L"*.exr" : L"*.png";
         const size_t fileExtensionFilterLength = ::std::char_traits<wchar_t>::length(fileExtensionFilter);
 
         // The filter uses embedded NUL characters as a separator, with double termination for the last item.
@@ -182,7 +195,7 @@ namespace
         HWND owner,
         const boost::filesystem::path& defaultFileName,
         boost::filesystem::path& outputFilePath,
-        int32 imageBitDepth)
+        OutputImageFileType fileType)
     {
         OSErr err = noErr;
 
@@ -196,10 +209,10 @@ namespace
                                                 titleBuffer,
                                                 _countof(titleBuffer));
 
-            const UINT filterResourceId = imageBitDepth == 32 ? EXR_FILTER_NAME : PNG_FILTER_NAME;
+            const SaveDialogFileType saveFileType = GetSaveDialogFileType(fileType);
 
             const int filterNameLength = LoadStringW(wil::GetModuleInstanceHandle(),
-                                                     filterResourceId,
+                                                     saveFileType.filterResourceId,
                                                      filterNameBuffer,
                                                      _countof(filterNameBuffer));
 
@@ -207,7 +220,7 @@ namespace
             {
                 auto comCleanup = wil::CoInitializeEx(COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
 
-                auto filterStr = BulidClassicSaveDialogFilterString(filterNameBuffer, filterNameLength, imageBitDepth);
+                auto filterStr = BulidClassicSaveDialogFilterString(filterNameBuffer, filterNameLength, saveFileType.filterPattern);
 
                 constexpr int fileNameBufferLength = 8192;
 
@@ -223,7 +236,7 @@ namespace
                 OPENFILENAMEW ofn = {};
                 ofn.lStructSize = sizeof(ofn);
                 ofn.hwndOwner = owner;
-                ofn.lpstrDefExt = imageBitDepth == 32 ? L"exr" : L"png";
+                ofn.lpstrDefExt = saveFileType.extension;
                 ofn.lpstrTitle = titleBuffer;
                 ofn.lpstrFilter = filterStr.get();
                 ofn.nFilterIndex = 1;
@@ -266,7 +279,7 @@ OSErr GetNewImageFileNameNative(
     const FilterRecordPtr filterRecord,
     const boost::filesystem::path& defaultFileName,
     boost::filesystem::path& outputFileName,
-    int32 imageBitDepth)
+    OutputImageFileType fileType)
 {
     PlatformData* platformData = static_cast<PlatformData*>(filterRecord->platformData);
 
@@ -274,10 +287,10 @@ OSErr GetNewImageFileNameNative(
 
     if (UseVistaStyleDialogs())
     {
-        return GetSaveFileNameVista(owner, defaultFileName, outputFileName, imageBitDepth);
+        return GetSaveFileNameVista(owner, defaultFileName, outputFileName, fileType);
     }
     else
     {
-        return GetSaveFileNameClassic(owner, defaultFileName, outputFileName, imageBitDepth);
+        return GetSaveFileNameClassic(owner, defaultFileName, outputFileName, fileType);
     }
 }
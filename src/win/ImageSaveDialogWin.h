@@ -14,11 +14,12 @@
 #define IMAGESAVEDIALOGWIN_H
 
 #include "GmicPlugin.h"
+#include "OutputImageWriter.h"
 
 OSErr GetNewImageFileNameNative(
     const FilterRecordPtr filterRecord,
     const boost::filesystem::path& defaultFileName,
     boost::filesystem::path& outputFileName,
-    int32 imageBitDepth);
+    OutputImageFileType fileType);
 
 #endif // !IMAGESAVEDIALOGWIN_H
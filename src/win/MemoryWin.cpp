@@ -13,6 +13,7 @@
 #include "MemoryWin.h"
 #include <Windows.h>
 #include <windowsx.h>
+#include <atomic>
 
 // The following methods were adapted from WinUtilities.cpp in the PS6 SDK:
 
@@ -63,3 +64,41 @@ void DisposeHandle(Handle handle)
 
 #pragma warning(default: 6387)
 #pragma warning(default: 28183)
+
+void* AllocateLargePageMemory(size_t size, size_t& allocationSize) noexcept
+{
+    // Large pages require the SeLockMemoryPrivilege to be enabled for the host process.
+    // We stop trying after the first failure to avoid repeating a system call that
+    // will not succeed.
+    static ::std::atomic<bool> largePagesUnavailable(false);
+    static const SIZE_T largePageMinimum = GetLargePageMinimum();
+
+    allocationSize = 0;
+
+    if (largePagesUnavailable || largePageMinimum == 0 || size < largePageMinimum)
+    {
+        return nullptr;
+    }
+
+    const SIZE_T roundedSize = ((size + largePageMinimum - 1) / largePageMinimum) * largePageMinimum;
+
+    void* memory = VirtualAlloc(nullptr, roundedSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+    if (memory == nullptr)
+    {
+        largePagesUnavailable = true;
+        return nullptr;
+    }
+
+    allocationSize = roundedSize;
+
+    return memory;
+}
+
+void FreeLargePageMemory(void* memory) noexcept
+{
+    if (memory != nullptr)
+    {
+        VirtualFree(memory, 0, MEM_RELEASE);
+    }
+}
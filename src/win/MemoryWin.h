@@ -18,4 +18,8 @@
 Handle	NewHandle(int32 size);
 void	DisposeHandle(Handle handle);
 
+// Allocates memory that is backed by large pages, returns NULL if large pages are not available.
+void*	AllocateLargePageMemory(size_t size, size_t& allocationSize) noexcept;
+void	FreeLargePageMemory(void* memory) noexcept;
+
 #endif // MEMORYWIN_H
@@ -31,6 +31,12 @@
 #define EXR_FILTER_NAME                 122
 #define GMICDIALOG_FULLUI_TEXT          123
 #define GMICDIALOG_REPEATFILTER_TEXT    124
+#define TIFF_FILTER_NAME                125
+#define QOI_FILTER_NAME                 126
+#define OUTPUT_FORMAT_DEFAULT_NAME      127
+#define OUTPUT_FORMAT_TIFF_UNCOMPRESSED_NAME 128
+#define OUTPUT_FORMAT_TIFF_DEFLATE_NAME 129
+#define OUTPUT_FORMAT_QOI_NAME          130
 #define IDC_LIBPNGCOPYRIGHTFORMAT       1000
 #define ABOUTFORMAT                     1001
 #define IDC_GMICQT                      1002
@@ -50,14 +56,23 @@
 #define IDC_SECONDIMAGESOURCE_CLIPBOARD_RADIO 1016
 #define IDC_SECONDIMAGESOURCE_FILE_RADIO 1017
 #define IDC_GMICINFO                    1018
+#define IDC_SELECTIONGB                 1019
+#define IDC_EXPORTSELECTIONCB           1020
+#define IDC_SELECTIONMARGINLABEL        1021
+#define IDC_SELECTIONMARGINEDIT         1022
+#define IDC_RESAMPLEOUTPUTCB            1023
+#define IDC_PERFORMANCEGB               1024
+#define IDC_REDUCEDPRECISIONCB          1025
+#define IDC_OUTPUTFORMATLABEL           1026
+#define IDC_OUTPUTFORMATCOMBO           1027
 
 // Next default values for new objects
 //
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        125
+#define _APS_NEXT_RESOURCE_VALUE        131
 #define _APS_NEXT_COMMAND_VALUE         40001
-#define _APS_NEXT_CONTROL_VALUE         1019
+#define _APS_NEXT_CONTROL_VALUE         1028
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif